@@ -29,9 +29,14 @@ public:
 
     void setType(ts::Type type) { m_resultType = type; }
 
+    // only meaningful for "[]": false if the index is proven to be in range
+    bool isBoundsChecked() const { return m_boundsChecked; }
+    void setBoundsChecked(bool checked) { m_boundsChecked = checked; }
+
 private:
-    std::string m_literal;    // string with operator
-    ts::Type    m_resultType; // unknown_t if auto detection needed, else type of result
+    std::string m_literal;              // string with operator
+    ts::Type    m_resultType;           // unknown_t if auto detection needed, else type of result
+    bool        m_boundsChecked = true; // runtime index check for "[]"
 };
 
 // unused
@@ -55,13 +60,47 @@ private:
 class Declaration
 {
 public:
-    Declaration(ts::Type t) : m_type(t) {}
+    Declaration(ts::Type t, std::uint32_t length = 0, std::string_view typeName = "")
+    : m_type(t),
+      m_length(length),
+      m_typeName(typeName)
+    {
+    }
     ~Declaration() {}
 
-    ts::Type getType() const { return m_type; }
+    ts::Type      getType() const { return m_type; }
+    std::uint32_t getLength() const { return m_length; }
+    bool          isArray() const { return m_length != 0; }
+
+    // name of struct for struct_t declarations
+    const std::string& getTypeName() const { return m_typeName; }
 
 private:
-    ts::Type m_type;
+    ts::Type      m_type;
+    std::uint32_t m_length;   // number of elements for arrays, 0 for scalars
+    std::string   m_typeName; // struct name
+};
+
+// struct type definition
+class StructDecl
+{
+public:
+    // field type and name in declaration order
+    using Field = std::pair<ts::Type, std::string>;
+
+    StructDecl(std::string_view name, bool soa) : m_name(name), m_soa(soa) {}
+    ~StructDecl() {}
+
+    const std::string&        getName() const { return m_name; }
+    bool                      isSoA() const { return m_soa; }
+    const std::vector<Field>& getFields() const { return m_fields; }
+
+    void addField(ts::Type type, const std::string& name) { m_fields.emplace_back(type, name); }
+
+private:
+    std::string        m_name;
+    bool               m_soa; // [[soa]] attribute
+    std::vector<Field> m_fields;
 };
 
 // variable, function, class name
@@ -76,9 +115,14 @@ public:
     ts::Type getType() const { return m_type; }
     void     setType(ts::Type type) { m_type = type; }
 
+    // symbol this identifier refers to, set by the semantic analyzer
+    const std::shared_ptr<Symbol>& getSymbol() const { return m_symbol; }
+    void                           setSymbol(const std::shared_ptr<Symbol>& symbol) { m_symbol = symbol; }
+
 private:
-    ts::Type    m_type;
-    std::string m_name;
+    ts::Type                m_type;
+    std::string             m_name;
+    std::shared_ptr<Symbol> m_symbol;
 };
 
 class Float
@@ -95,18 +139,19 @@ private:
     const ts::Type m_type = ts::Type::float_t;
 };
 
+// char_t constants come from folded casts, their value is sign-extended
 class Integer
 {
 public:
-    Integer(int value) : m_value(value) {}
+    Integer(int value, ts::Type type = ts::Type::int_t) : m_value(value), m_type(type) {}
     ~Integer() {}
 
     int      getValue() const { return m_value; }
     ts::Type getType() const { return m_type; }
 
 private:
-    int            m_value;
-    const ts::Type m_type = ts::Type::int_t;
+    int      m_value;
+    ts::Type m_type;
 };
 
 class Boolean
@@ -181,7 +226,8 @@ public:
 class BlockStart
 {
 public:
-    BlockStart() : m_id(++ID) {}
+    // ids are numbered by the parser from 1, 0 is the global scope
+    explicit BlockStart(std::size_t scopeId) : m_scopeId(scopeId) {}
     ~BlockStart() {}
 
     std::size_t getScopeId() const { return m_scopeId; }
@@ -189,15 +235,23 @@ public:
     bool isInFunction() const { return m_inFunction; }
     void setInFunction(bool inFunction) { m_inFunction = inFunction; }
 
-    static std::size_t ID;
-
 private:
     std::size_t m_scopeId;
-    std::size_t m_id;
     bool        m_inFunction = false;
 };
 
-inline std::size_t BlockStart::ID = 0;
+// counting loop of form
+//     i = start; while (i < bound) { ...; i = i + step; }
+// recognized by LoopAnalyzer
+struct CountedLoop
+{
+    std::int32_t start = 0;
+    std::int32_t bound = 0;
+    std::int32_t step  = 0;
+
+    bool vectorizable = false; // body is element-wise arithmetic over arrays indexed by i
+    bool unrollable   = false; // body is small and has no loops
+};
 
 // while loop statement
 // first child - condition
@@ -207,6 +261,18 @@ class WhileLoop
 public:
     WhileLoop() {}
     ~WhileLoop() {}
+
+    bool               isCounted() const { return m_counted; }
+    const CountedLoop& getCounted() const { return m_countedLoop; }
+    void               setCounted(const CountedLoop& loop)
+    {
+        m_counted     = true;
+        m_countedLoop = loop;
+    }
+
+private:
+    bool        m_counted = false;
+    CountedLoop m_countedLoop;
 };
 
 class BlockEnd
@@ -234,7 +300,7 @@ private:
 class ASTNode;
 
 using ASTNodeData = std::
-    variant<BinaryExpr, UnaryExpr, Float, Integer, Boolean, Root, Declaration, Identifier, Branch, Condition, BodyThen, BodyElse, BodyFunction, Return, BlockStart, BlockEnd, WhileLoop, ImplicitTypeCast>;
+    variant<BinaryExpr, UnaryExpr, Float, Integer, Boolean, Root, Declaration, StructDecl, Identifier, Branch, Condition, BodyThen, BodyElse, BodyFunction, Return, BlockStart, BlockEnd, WhileLoop, ImplicitTypeCast>;
 using ASTNodePtr  = std::shared_ptr<ASTNode>;
 using ASTNodeWPtr = std::weak_ptr<ASTNode>;
 
@@ -262,6 +328,7 @@ public:
     }
     [[maybe_unused]] void replaceChild(ASTNodePtr& old, ASTNodePtr& nw) noexcept
     {
+        nw->setParent(ptr());
         std::ranges::replace_if(m_children, [&old](const auto& n) { return n == old; }, nw);
     }
 
@@ -288,6 +355,105 @@ inline T getValue(const ast::ASTNodePtr& node)
     throw SemanticError("SemanticAnalyzer::getValue() unknown type");
 }
 
+// type of expression value
+inline ts::Type getType(const ast::ASTNodePtr& node)
+{
+    return std::visit(
+        [](auto&& arg) -> ts::Type
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::is_same_v<T, ast::Identifier>) {
+                return arg.getSymbol() ? arg.getSymbol()->type : ts::Type::unknown_t;
+            }
+            else if constexpr (std::disjunction_v<std::is_same<T, ast::Integer>,
+                                                  std::is_same<T, ast::Float>,
+                                                  std::is_same<T, ast::Boolean>,
+                                                  std::is_same<T, ast::BinaryExpr>,
+                                                  std::is_same<T, ast::UnaryExpr>>) {
+                return arg.getType();
+            }
+            else if constexpr (std::is_same_v<T, ast::ImplicitTypeCast>) {
+                return arg.getToCast();
+            }
+
+            return ts::Type::unknown_t;
+        },
+        node->getData());
+}
+
+// && or ||
+inline bool isLogical(const ASTNodePtr& node)
+{
+    const BinaryExpr* be = std::get_if<BinaryExpr>(&node->getData());
+
+    return be && (be->getLiteral() == "&&" || be->getLiteral() == "||");
+}
+
+// subscript node of array element or of struct array member access, nullptr otherwise
+inline const ASTNodePtr* subscriptOf(const ASTNodePtr& node)
+{
+    const BinaryExpr* be = std::get_if<BinaryExpr>(&node->getData());
+
+    if (!be) {
+        return nullptr;
+    }
+    if (be->getLiteral() == "[]") {
+        return &node;
+    }
+    if (be->getLiteral() == ".") {
+        return subscriptOf(node->getChildren().front());
+    }
+    return nullptr;
+}
+
+// index of a subscript that is known to be in range, nullptr if it is checked at runtime
+inline const Integer* constantIndex(const ASTNodePtr& subscript)
+{
+    if (std::get<BinaryExpr>(subscript->getData()).isBoundsChecked()) {
+        return nullptr;
+    }
+    return std::get_if<Integer>(&subscript->getChildren().back()->getData());
+}
+
+// array element or struct member is at address of variable + disp + index * stride
+struct ElementLocation
+{
+    const Identifier* variable;
+    const ASTNodePtr* subscript; // nullptr for member of scalar struct
+    std::int64_t      disp   = 0;
+    std::int64_t      stride = 0;
+};
+
+inline ElementLocation elementLocation(const ASTNodePtr& node)
+{
+    const ASTNodePtr* subscript = subscriptOf(node);
+    const ASTNodePtr& base      = subscript ? (*subscript)->getChildren().front() : node->getChildren().front();
+
+    ElementLocation loc{&std::get<Identifier>(base->getData()), subscript};
+
+    const Symbol& sym = *loc.variable->getSymbol();
+
+    loc.stride = sym.type == ts::Type::struct_t ? sym.structType->size : ts::TypeSize[sym.type];
+
+    if (std::get<BinaryExpr>(node->getData()).getLiteral() == ".") {
+        const Symbol& field = *std::get<Identifier>(node->getChildren().back()->getData()).getSymbol();
+
+        // SoA arrays store each field as a separate array
+        if (subscript && sym.structType->soa) {
+            loc.disp   = sym.structType->soaOffset(field, sym.length, SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_VECTOR));
+            loc.stride = field.size;
+        }
+        else {
+            loc.disp = field.offset;
+        }
+    }
+
+    if (!subscript) {
+        loc.stride = 0;
+    }
+    return loc;
+}
 
 #ifdef DEBUG
 [[maybe_unused]] inline std::string ASTTypeToString(const ast::ASTNodePtr& node)
@@ -317,6 +483,9 @@ inline T getValue(const ast::ASTNodePtr& node)
             else if constexpr (std::is_same_v<T, ast::Declaration>) {
                 return "Declaration";
             }
+            else if constexpr (std::is_same_v<T, ast::StructDecl>) {
+                return std::string("StructDecl: ") + arg.getName() + (arg.isSoA() ? " [[soa]]" : "");
+            }
             else if constexpr (std::is_same_v<T, ast::Identifier>) {
                 return std::string("Identifier: ") + arg.getName();
             }
@@ -0,0 +1,121 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationTracker.h"
+
+std::int64_t AllocationTracker::resetPeak()
+{
+    std::int64_t peak = s_stats.peak;
+    s_stats.peak      = s_stats.live;
+    return peak;
+}
+
+void AllocationTracker::restorePeak(std::int64_t peak)
+{
+    s_stats.peak = std::max(s_stats.peak, peak);
+}
+
+void AllocationTracker::allocated(std::uint64_t size)
+{
+    s_stats.count++;
+    s_stats.bytes += size;
+    s_stats.live += size;
+    s_stats.peak = std::max(s_stats.peak, s_stats.live);
+}
+
+void AllocationTracker::freed(std::uint64_t size)
+{
+    s_stats.live -= size;
+}
+
+// allocates with malloc, or aligned_alloc if alignment is given, calling the new handler
+// until it succeeds like the default operator new; throws bad_alloc if there is no handler
+static void* allocate(std::size_t size, std::size_t alignment)
+{
+    size = size ? size : 1;
+    // aligned_alloc wants a multiple of alignment
+    if (alignment) {
+        size = (size + alignment - 1) / alignment * alignment;
+    }
+
+    void* p;
+    while (!(p = alignment ? std::aligned_alloc(alignment, size) : std::malloc(size))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+
+    if (AllocationTracker::enabled()) {
+        AllocationTracker::allocated(malloc_usable_size(p));
+    }
+    return p;
+}
+
+// replacements of global allocation functions
+// the array forms call the single ones, aligned blocks are freed with free as well
+// sizes come from malloc_usable_size, blocks have no header and tracking can be enabled at any time
+void* operator new(std::size_t size)
+{
+    return allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return allocate(size, 0);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try {
+        return allocate(size, static_cast<std::size_t>(alignment));
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p && AllocationTracker::enabled()) {
+        AllocationTracker::freed(malloc_usable_size(p));
+    }
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    operator delete(p);
+}
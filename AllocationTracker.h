@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// counters of heap allocations, sizes are usable sizes of malloc blocks
+struct AllocationStats
+{
+    std::uint64_t count = 0; // allocations
+    std::uint64_t bytes = 0; // allocated bytes
+    std::int64_t  live  = 0; // allocated minus freed bytes
+    std::int64_t  peak  = 0; // highest live since the last resetPeak
+};
+
+// counts allocations made through global operator new, which is replaced in AllocationTracker.cpp
+// disabled by default, then operator new only checks a flag; counters are per thread,
+// the flag is shared, so threads that allocate while it is toggled see it atomically
+class AllocationTracker
+{
+public:
+    AllocationTracker()  = delete;
+    ~AllocationTracker() = delete;
+
+    static void enable(bool on) { s_enabled.store(on, std::memory_order_relaxed); }
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    static const AllocationStats& stats() { return s_stats; }
+
+    // starts a new peak at the current live size, returns the previous peak
+    static std::int64_t resetPeak();
+    // peak of an enclosing measurement includes the inner one
+    static void restorePeak(std::int64_t peak);
+
+    static void allocated(std::uint64_t size);
+    static void freed(std::uint64_t size);
+
+private:
+    static inline std::atomic<bool>            s_enabled = false;
+    static inline thread_local AllocationStats s_stats;
+};
@@ -0,0 +1,87 @@
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+#include "AsmWriter.h"
+#include "Common.h"
+
+AsmWriter::~AsmWriter()
+{
+    if (m_fd >= 0) {
+        writeAll({});
+    }
+}
+
+void AsmWriter::flush()
+{
+    if (m_fd >= 0) {
+        writeAll({});
+    }
+    if (m_error) {
+        throw InterpretError(std::format("write failed: {}", std::strerror(m_error)));
+    }
+}
+
+void AsmWriter::spill(std::string_view s)
+{
+    if (m_fd < 0) {
+        m_buffer.resize(std::max(m_buffer.size() * 2, m_size + s.size() + 20));
+        std::copy(s.begin(), s.end(), m_buffer.data() + m_size);
+        m_size += s.size();
+        return;
+    }
+
+    // long text is written from its place instead of being copied
+    if (s.size() > m_buffer.size() / 2) {
+        writeAll(s);
+        return;
+    }
+
+    writeAll({});
+    std::copy(s.begin(), s.end(), m_buffer.data());
+    m_size = s.size();
+}
+
+void AsmWriter::writeAll(std::string_view s)
+{
+    iovec iov[2] = {
+        {m_buffer.data(),             m_size  },
+        {const_cast<char*>(s.data()), s.size()},
+    };
+
+    iovec* next  = iov;
+    int    count = s.empty() ? 1 : 2;
+
+    m_size = 0;
+
+    // text is dropped after the first error
+    if (m_error) {
+        return;
+    }
+
+    while (count > 0) {
+        ssize_t written = writev(m_fd, next, count);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_error = errno;
+            return;
+        }
+
+        // partial write, skips what is written
+        while (count > 0 && static_cast<std::size_t>(written) >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0) {
+            next->iov_base = static_cast<char*>(next->iov_base) + written;
+            next->iov_len -= written;
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// text template with {} placeholders, checked when the program is compiled
+template <std::size_t N>
+struct Template
+{
+    char text[N];
+
+    consteval Template(const char (&s)[N])
+    {
+        std::copy_n(s, N, text);
+
+        for (std::size_t i = 0; i + 1 < N; i++) {
+            if (text[i] == '{' && text[i + 1] != '}') {
+                throw "'{' must be followed by '}'";
+            }
+            if (text[i] == '}' && (i == 0 || text[i - 1] != '{')) {
+                throw "unmatched '}'";
+            }
+        }
+    }
+
+    consteval std::size_t placeholders() const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i + 1 < N; i++) {
+            count += text[i] == '{';
+        }
+        return count;
+    }
+
+    // positions of placeholders
+    template <std::size_t Count>
+    consteval std::array<std::size_t, Count> positions() const
+    {
+        std::array<std::size_t, Count> result{};
+        std::size_t                     n = 0;
+
+        for (std::size_t i = 0; i + 1 < N; i++) {
+            if (text[i] == '{') {
+                result[n++] = i;
+            }
+        }
+        return result;
+    }
+
+    constexpr std::string_view view() const { return {text, N - 1}; }
+};
+
+// buffered text output to file descriptor, flushed with write(2) and writev(2)
+// values are formatted directly into the buffer
+class AsmWriter
+{
+public:
+    // fd < 0 keeps text in memory
+    explicit AsmWriter(int fd = -1, std::size_t capacity = 1 << 16) : m_fd(fd), m_buffer(capacity) {}
+    // remaining text is written, errors are ignored
+    ~AsmWriter();
+
+    AsmWriter(const AsmWriter&)            = delete;
+    AsmWriter(AsmWriter&&)                 = delete;
+    AsmWriter& operator=(const AsmWriter&) = delete;
+    AsmWriter& operator=(AsmWriter&&)      = delete;
+
+    template <Template Fmt, typename... Args>
+    void print(const Args&... args)
+    {
+        static_assert(Fmt.placeholders() == sizeof...(Args), "number of arguments doesn't match the template");
+
+        static constexpr auto        positions = Fmt.template positions<sizeof...(Args)>();
+        static constexpr std::string_view text = Fmt.view();
+
+        std::size_t start = 0;
+        std::size_t i     = 0;
+
+        (
+            [&]
+            {
+                write(text.substr(start, positions[i] - start));
+                write(args);
+                start = positions[i++] + 2;
+            }(),
+            ...);
+
+        write(text.substr(start));
+    }
+
+    void write(std::string_view s)
+    {
+        if (m_size + s.size() > m_buffer.size()) {
+            spill(s);
+            return;
+        }
+        std::copy(s.begin(), s.end(), m_buffer.data() + m_size);
+        m_size += s.size();
+    }
+
+    void write(char c)
+    {
+        if (m_size == m_buffer.size()) {
+            spill({});
+        }
+        m_buffer[m_size++] = c;
+    }
+
+    template <std::integral T>
+        requires(!std::same_as<T, char> && !std::same_as<T, bool>)
+    void write(T value)
+    {
+        // longest 64-bit value with sign
+        if (m_buffer.size() - m_size < 20) {
+            spill({});
+        }
+        m_size = std::to_chars(m_buffer.data() + m_size, m_buffer.data() + m_buffer.size(), value).ptr - m_buffer.data();
+    }
+
+    // writes buffered text, throws InterpretError on failure
+    void flush();
+
+    // text not written yet
+    std::string_view view() const { return {m_buffer.data(), m_size}; }
+
+    // drops text not written yet, the buffer keeps its capacity
+    void clear() { m_size = 0; }
+
+private:
+    // makes room when text doesn't fit, long text is written together with the buffer
+    void spill(std::string_view s);
+
+    // writes buffer followed by s, first error is kept in m_error
+    void writeAll(std::string_view s);
+
+private:
+    int               m_fd;
+    std::vector<char> m_buffer;
+    std::size_t       m_size  = 0;
+    int               m_error = 0; // errno of failed write
+};
@@ -0,0 +1,345 @@
+#include <array>
+#include <tuple>
+
+#include "Assembly.h"
+#include "Profiler.h"
+
+namespace x86
+{
+std::uint8_t Register::size() const
+{
+    switch (cls) {
+        case RegClass::GP8:
+            return 1;
+        case RegClass::GP32:
+            return 4;
+        case RegClass::GP64:
+            return 8;
+        case RegClass::XMM:
+            return 16;
+        case RegClass::YMM:
+            return 32;
+    }
+    return 0;
+}
+
+Memory mem(std::uint8_t size, Register base, std::int32_t disp)
+{
+    Memory m;
+    m.size    = size;
+    m.hasBase = true;
+    m.base    = base;
+    m.disp    = disp;
+    return m;
+}
+
+Memory mem(std::uint8_t size, Register base, Register index, std::uint8_t scale, std::int32_t disp)
+{
+    Memory m   = mem(size, base, disp);
+    m.hasIndex = true;
+    m.index    = index;
+    m.scale    = scale;
+    return m;
+}
+
+Memory mem(std::uint8_t size, const std::string& symbol, std::int32_t disp)
+{
+    Memory m;
+    m.size   = size;
+    m.symbol = symbol;
+    m.disp   = disp;
+    return m;
+}
+
+// indexed by Opcode
+static constexpr std::array<std::string_view, 62> Mnemonics = {
+    "",
+    "mov",
+    "movzx",
+    "movsx",
+    "movsxd",
+    "lea",
+    "add",
+    "sub",
+    "imul",
+    "cdq",
+    "idiv",
+    "neg",
+    "shl",
+    "shr",
+    "sar",
+    "cmp",
+    "test",
+    "and",
+    "or",
+    "xor",
+    "push",
+    "pop",
+    "set",
+    "jmp",
+    "j",
+    "ret",
+    "syscall",
+    "movss",
+    "movd",
+    "addss",
+    "subss",
+    "mulss",
+    "divss",
+    "ucomiss",
+    "xorps",
+    "cvtsi2ss",
+    "cvttss2si",
+    "shufps",
+    "pshufd",
+    "movups",
+    "movdqu",
+    "addps",
+    "subps",
+    "mulps",
+    "divps",
+    "paddd",
+    "psubd",
+    "pmuludq",
+    "punpckldq",
+    "vmovd",
+    "vpbroadcastd",
+    "vbroadcastss",
+    "vmovups",
+    "vmovdqu",
+    "vaddps",
+    "vsubps",
+    "vmulps",
+    "vdivps",
+    "vpaddd",
+    "vpsubd",
+    "vpmulld",
+    "vzeroupper",
+};
+
+static_assert(Mnemonics.size() == static_cast<std::size_t>(Opcode::VZEROUPPER) + 1);
+
+static std::string_view condName(Cond cond)
+{
+    switch (cond) {
+        case Cond::B:
+            return "b";
+        case Cond::AE:
+            return "ae";
+        case Cond::E:
+            return "e";
+        case Cond::NE:
+            return "ne";
+        case Cond::BE:
+            return "be";
+        case Cond::A:
+            return "a";
+        case Cond::P:
+            return "p";
+        case Cond::NP:
+            return "np";
+        case Cond::L:
+            return "l";
+        case Cond::GE:
+            return "ge";
+        case Cond::LE:
+            return "le";
+        case Cond::G:
+            return "g";
+    }
+    return "";
+}
+
+static std::string_view sizeName(std::uint8_t size)
+{
+    switch (size) {
+        case 1:
+            return "byte ";
+        case 2:
+            return "word ";
+        case 4:
+            return "dword ";
+        case 8:
+            return "qword ";
+        default:
+            return "";
+    }
+}
+
+static std::string_view registerName(const Register& reg)
+{
+    static constexpr std::array<std::string_view, 16> gp64 = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+    static constexpr std::array<std::string_view, 16> gp32 = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                                              "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+    static constexpr std::array<std::string_view, 4>  gp8  = {"al", "cl", "dl", "bl"};
+    static constexpr std::array<std::string_view, 16> xmm  = {"xmm0", "xmm1", "xmm2",  "xmm3",  "xmm4",  "xmm5",
+                                                              "xmm6", "xmm7", "xmm8",  "xmm9",  "xmm10", "xmm11",
+                                                              "xmm12", "xmm13", "xmm14", "xmm15"};
+    static constexpr std::array<std::string_view, 16> ymm  = {"ymm0", "ymm1", "ymm2",  "ymm3",  "ymm4",  "ymm5",
+                                                              "ymm6", "ymm7", "ymm8",  "ymm9",  "ymm10", "ymm11",
+                                                              "ymm12", "ymm13", "ymm14", "ymm15"};
+
+    switch (reg.cls) {
+        case RegClass::GP8:
+            return gp8[reg.num];
+        case RegClass::GP32:
+            return gp32[reg.num];
+        case RegClass::GP64:
+            return gp64[reg.num];
+        case RegClass::XMM:
+            return xmm[reg.num];
+        case RegClass::YMM:
+            return ymm[reg.num];
+    }
+    return "";
+}
+
+static void write(AsmWriter& out, const Operand& op)
+{
+    std::visit(
+        [&out](auto&& arg) -> void
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::is_same_v<T, Register>) {
+                out.write(registerName(arg));
+            }
+            else if constexpr (std::is_same_v<T, Immediate>) {
+                out.write(arg.value);
+            }
+            else if constexpr (std::is_same_v<T, Label>) {
+                out.write(arg.name);
+            }
+            else if constexpr (std::is_same_v<T, Memory>) {
+                out.print<"{}[{}">(sizeName(arg.size), arg.hasBase ? registerName(arg.base) : arg.symbol);
+
+                if (arg.hasIndex) {
+                    out.print<" + {} * {}">(registerName(arg.index), arg.scale);
+                }
+                if (arg.disp > 0) {
+                    out.print<" + {}">(arg.disp);
+                }
+                else if (arg.disp < 0) {
+                    out.print<" - {}">(-static_cast<std::int64_t>(arg.disp));
+                }
+                out.write(']');
+            }
+        },
+        op);
+}
+
+static void write(AsmWriter& out, const Instruction& instr)
+{
+    if (instr.op == Opcode::LABEL) {
+        write(out, instr.operands.front());
+        out.write(':');
+        return;
+    }
+
+    out.write(Mnemonics[static_cast<std::size_t>(instr.op)]);
+
+    if (instr.op == Opcode::SETCC || instr.op == Opcode::JCC) {
+        out.write(condName(instr.cond));
+    }
+
+    for (std::size_t i = 0; i < instr.operands.size(); i++) {
+        out.write(i == 0 ? " " : ", ");
+        write(out, instr.operands[i]);
+    }
+}
+
+std::string toString(const Register& reg)
+{
+    return std::string(registerName(reg));
+}
+
+std::string toString(const Operand& op)
+{
+    AsmWriter out;
+    write(out, op);
+    return std::string(out.view());
+}
+
+std::string toString(const Instruction& instr)
+{
+    AsmWriter out;
+    write(out, instr);
+    return std::string(out.view());
+}
+
+static void printVariables(const std::vector<Variable>& vars, bool reserve, AsmWriter& out)
+{
+    for (const Variable& v : vars) {
+        if (v.align > 1) {
+            out.print<"\t{} {}\n">(reserve ? "alignb" : "align", v.align);
+        }
+
+        if (reserve) {
+            out.print<"\t{} {} {}\n">(v.name, v.unit == 4 ? "resd" : "resb", v.count);
+        }
+        else {
+            out.print<"\t{} {} {}\n">(v.name, v.unit == 4 ? "dd" : "db", v.value);
+        }
+    }
+}
+
+void printNASM(const Program& program, AsmWriter& out)
+{
+    TimeScope scope("emit nasm");
+
+    if (!program.data.empty()) {
+        out.write("section .data\n");
+        printVariables(program.data, false, out);
+    }
+    if (!program.bss.empty()) {
+        out.write("\nsection .bss\n");
+        printVariables(program.bss, true, out);
+    }
+
+    out.write('\n');
+    printTextHeader(program, out);
+    printText(program, out);
+
+    if (!program.rodata.empty()) {
+        out.write("\nsection .rodata\n");
+        printVariables(program.rodata, false, out);
+    }
+}
+
+void printTextHeader(const Program& program, AsmWriter& out)
+{
+    out.print<"default rel\n\nsection .text\n\tglobal {}\n\n{}:\n">(program.entry, program.entry);
+}
+
+void printText(const Program& program, AsmWriter& out)
+{
+    std::uint32_t line = 0;
+
+    for (const Instruction& instr : program.text) {
+        // following lines of the listing are attributed to the source line
+        if (!program.source.empty() && instr.line && instr.line != line) {
+            line = instr.line;
+            out.print<"%line {}+0 {}\n">(line, program.source);
+        }
+
+        if (instr.op != Opcode::LABEL) {
+            out.write('\t');
+        }
+        write(out, instr);
+        out.write('\n');
+    }
+}
+
+void printGlobals(const Program& program, AsmWriter& out)
+{
+    for (const auto& [name, vars, reserve] : {std::tuple{"data", &program.data, false},
+                                              std::tuple{"bss", &program.bss, true},
+                                              std::tuple{"rodata", &program.rodata, false}}) {
+        if (!vars->empty()) {
+            out.print<"\nsection .{}\n">(name);
+            printVariables(*vars, reserve, out);
+        }
+    }
+}
+} // namespace x86
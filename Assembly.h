@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "AsmWriter.h"
+
+// x86-64 instructions generated by the interpreter
+// printed as NASM text or encoded to machine code
+namespace x86
+{
+enum class RegClass : std::uint8_t
+{
+    GP8,
+    GP32,
+    GP64,
+    XMM,
+    YMM,
+};
+
+struct Register
+{
+    RegClass     cls;
+    std::uint8_t num; // hardware encoding, 0 - 15
+
+    bool operator==(const Register&) const = default;
+
+    // size of value in bytes
+    std::uint8_t size() const;
+    bool         isVector() const { return cls == RegClass::XMM || cls == RegClass::YMM; }
+};
+
+constexpr Register AL{RegClass::GP8, 0};
+constexpr Register CL{RegClass::GP8, 1};
+constexpr Register EAX{RegClass::GP32, 0};
+constexpr Register ECX{RegClass::GP32, 1};
+constexpr Register EDX{RegClass::GP32, 2};
+constexpr Register ESI{RegClass::GP32, 6};
+constexpr Register EDI{RegClass::GP32, 7};
+constexpr Register RAX{RegClass::GP64, 0};
+constexpr Register RCX{RegClass::GP64, 1};
+constexpr Register RDX{RegClass::GP64, 2};
+constexpr Register RBX{RegClass::GP64, 3};
+constexpr Register RSP{RegClass::GP64, 4};
+constexpr Register RBP{RegClass::GP64, 5};
+constexpr Register RSI{RegClass::GP64, 6};
+constexpr Register RDI{RegClass::GP64, 7};
+
+constexpr Register xmm(std::uint8_t n) { return {RegClass::XMM, n}; }
+constexpr Register ymm(std::uint8_t n) { return {RegClass::YMM, n}; }
+
+// [base + index * scale + disp] or rip-relative [symbol + disp]
+struct Memory
+{
+    std::uint8_t size = 0; // operand size in bytes, 0 if implied by the other operand
+
+    bool         hasBase  = false;
+    Register     base     = RBP;
+    bool         hasIndex = false;
+    Register     index    = RCX;
+    std::uint8_t scale    = 1;
+
+    std::int32_t disp = 0;
+    std::string  symbol; // rip-relative if not empty
+};
+
+// memory at fixed offset from base register
+Memory mem(std::uint8_t size, Register base, std::int32_t disp = 0);
+// memory with index register
+Memory mem(std::uint8_t size, Register base, Register index, std::uint8_t scale, std::int32_t disp = 0);
+// global variable
+Memory mem(std::uint8_t size, const std::string& symbol, std::int32_t disp = 0);
+
+struct Immediate
+{
+    std::int64_t value;
+};
+
+struct Label
+{
+    std::string name;
+};
+
+using Operand = std::variant<Register, Memory, Immediate, Label>;
+
+inline Immediate imm(std::int64_t value) { return {value}; }
+inline Label     label(const std::string& name) { return {name}; }
+
+enum class Opcode : std::uint8_t
+{
+    LABEL, // pseudo instruction, defines label
+
+    MOV,
+    MOVZX,
+    MOVSX,
+    MOVSXD,
+    LEA,
+    ADD,
+    SUB,
+    IMUL,
+    CDQ,
+    IDIV,
+    NEG,
+    SHL,
+    SHR,
+    SAR,
+    CMP,
+    TEST,
+    AND,
+    OR,
+    XOR,
+    PUSH,
+    POP,
+    SETCC,
+    JMP,
+    JCC,
+    RET,
+    SYSCALL,
+
+    MOVSS,
+    MOVD,
+    ADDSS,
+    SUBSS,
+    MULSS,
+    DIVSS,
+    UCOMISS,
+    XORPS,
+    CVTSI2SS,
+    CVTTSS2SI,
+    SHUFPS,
+    PSHUFD,
+    MOVUPS,
+    MOVDQU,
+    ADDPS,
+    SUBPS,
+    MULPS,
+    DIVPS,
+    PADDD,
+    PSUBD,
+    PMULUDQ,
+    PUNPCKLDQ,
+
+    VMOVD,
+    VPBROADCASTD,
+    VBROADCASTSS,
+    VMOVUPS,
+    VMOVDQU,
+    VADDPS,
+    VSUBPS,
+    VMULPS,
+    VDIVPS,
+    VPADDD,
+    VPSUBD,
+    VPMULLD,
+    VZEROUPPER,
+};
+
+// condition codes of setcc and jcc, values are the hardware encoding
+enum class Cond : std::uint8_t
+{
+    B  = 0x2,
+    AE = 0x3,
+    E  = 0x4,
+    NE = 0x5,
+    BE = 0x6,
+    A  = 0x7,
+    P  = 0xA,
+    NP = 0xB,
+    L  = 0xC,
+    GE = 0xD,
+    LE = 0xE,
+    G  = 0xF,
+};
+
+// condition that holds when cond doesn't, encodings of opposite conditions differ in the lowest bit
+inline Cond negate(Cond cond) { return static_cast<Cond>(static_cast<std::uint8_t>(cond) ^ 1); }
+
+struct Instruction
+{
+    Opcode               op;
+    Cond                 cond = Cond::E; // for SETCC and JCC
+    std::uint32_t        line = 0;       // source line the instruction came from, 0 if unknown
+    std::vector<Operand> operands;
+};
+
+// global variable or constant
+struct Variable
+{
+    std::string   name;
+    std::uint32_t align = 1;
+    std::uint32_t unit  = 1; // element size: 1 (db, resb) or 4 (dd, resd)
+    std::uint32_t count = 1;
+    std::uint32_t value = 0; // initial value of .data and .rodata variables
+};
+
+struct Program
+{
+    std::vector<Variable>    data;
+    std::vector<Variable>    bss;
+    std::vector<Variable>    rodata;
+    std::vector<Instruction> text;
+
+    std::string entry = "_start";
+    // source file of line info, empty if lines of instructions aren't emitted
+    std::string source;
+};
+
+std::string toString(const Register& reg);
+std::string toString(const Operand& op);
+std::string toString(const Instruction& instr);
+
+// writes program as NASM source, with %line directives if it has line info
+void printNASM(const Program& program, AsmWriter& out);
+
+// parts of NASM source of a program printed while it is generated,
+// text sections of all parts come first, then globals of the last part
+void printTextHeader(const Program& program, AsmWriter& out);
+void printText(const Program& program, AsmWriter& out);
+void printGlobals(const Program& program, AsmWriter& out);
+} // namespace x86
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+#include "BatchCompiler.h"
+#include "WorkStealingPool.h"
+
+using Clock = std::chrono::steady_clock;
+
+void BatchCompiler::addManifest(const std::string& path)
+{
+    std::ifstream manifest(path);
+
+    if (!manifest.is_open()) {
+        throw InterpretError("can't open manifest " + path);
+    }
+
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line.front() != '#') {
+            addInput(line);
+        }
+    }
+}
+
+std::size_t BatchCompiler::run(const char* outputDir, std::ostream& diagnostics)
+{
+    WorkStealingPool pool(m_jobs);
+
+    // contexts and source buffers are reused by the tasks of a worker
+    std::vector<std::unique_ptr<CompilerContext>> contexts;
+    std::vector<std::string>                      sources(pool.threads());
+    for (std::size_t i = 0; i < pool.threads(); i++) {
+        contexts.push_back(std::make_unique<CompilerContext>());
+    }
+
+    // diagnostics of failed inputs, written in order of inputs when all are done
+    std::vector<std::string> messages(m_inputs.size());
+
+    pool.run(m_inputs.size(),
+             [&](std::size_t task, std::size_t worker)
+             {
+                 const std::string& input   = m_inputs[task];
+                 std::string&       source  = sources[worker];
+                 CompilerContext&   context = *contexts[worker];
+
+                 if (!read(input, source)) {
+                     messages[task] = input + ": can't open\n";
+                     return;
+                 }
+
+                 if (!context.compile(source, m_options)) {
+                     for (const Diagnostic& d : context.diagnostics()) {
+                         messages[task] += input + ": ";
+                         CompilerContext::render(d, messages[task]);
+                     }
+                     return;
+                 }
+
+                 std::filesystem::path output(input);
+                 output.replace_extension(m_options.output == OutputKind::ASSEMBLY ? ".s" : ".o");
+                 if (outputDir) {
+                     output = std::filesystem::path(outputDir) / output.filename();
+                 }
+
+                 std::ofstream ofile(output, std::ios::binary);
+                 std::string_view text = context.output();
+
+                 if (!ofile.write(text.data(), text.size()) || !ofile.flush()) {
+                     messages[task] = input + ": can't write " + output.string() + '\n';
+                 }
+             });
+
+    std::size_t failed = 0;
+    for (const std::string& m : messages) {
+        diagnostics << m;
+        failed += !m.empty();
+    }
+    return failed;
+}
+
+void BatchCompiler::benchmark(std::size_t runs, std::ostream& out)
+{
+    std::vector<std::string> sources(m_inputs.size());
+    std::size_t              bytes = 0;
+
+    for (std::size_t i = 0; i < m_inputs.size(); i++) {
+        if (!read(m_inputs[i], sources[i])) {
+            throw InterpretError("can't open " + m_inputs[i]);
+        }
+        bytes += sources[i].size();
+    }
+
+    std::size_t jobs = WorkStealingPool(m_jobs).threads();
+
+    std::vector<std::size_t> counts;
+    for (std::size_t t = 1; t < jobs; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(jobs);
+
+    out << std::fixed << "{\n  \"inputs\": " << m_inputs.size() << ",\n  \"bytes\": " << bytes << ",\n  \"runs\": " << runs
+        << ",\n  \"scaling\": [";
+
+    double single = 0.0;
+
+    for (std::size_t c = 0; c < counts.size(); c++) {
+        WorkStealingPool pool(counts[c]);
+
+        std::vector<std::unique_ptr<CompilerContext>> contexts;
+        for (std::size_t i = 0; i < pool.threads(); i++) {
+            contexts.push_back(std::make_unique<CompilerContext>());
+        }
+
+        // the first run warms up contexts
+        double best = 0.0;
+        for (std::size_t r = 0; r <= runs; r++) {
+            Clock::time_point start = Clock::now();
+            pool.run(sources.size(), [&](std::size_t task, std::size_t worker) { contexts[worker]->compile(sources[task], m_options); });
+            double time = std::chrono::duration<double>(Clock::now() - start).count();
+
+            best = r == 1 ? time : std::min(best, time);
+        }
+
+        if (c == 0) {
+            single = best;
+        }
+
+        out << (c ? "," : "") << "\n    {\"threads\": " << counts[c] << ", \"best_ms\": " << std::setprecision(3)
+            << best * 1e3 << ", \"inputs_per_s\": " << std::setprecision(1) << sources.size() / best
+            << ", \"speedup\": " << std::setprecision(2) << single / best << '}';
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+bool BatchCompiler::read(const std::string& path, std::string& source)
+{
+    std::ifstream ifile(path, std::ios::binary);
+
+    if (!ifile.is_open()) {
+        return false;
+    }
+
+    ifile.seekg(0, std::ios::end);
+    source.resize(ifile.tellg());
+    ifile.seekg(0);
+
+    return static_cast<bool>(ifile.read(source.data(), source.size()));
+}
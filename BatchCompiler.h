@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "CompilerContext.h"
+
+// compiles many files on a work-stealing pool, every worker has its own compiler context
+// outputs and diagnostics don't depend on which worker compiled an input or when
+class BatchCompiler
+{
+public:
+    // jobs == 0 uses one thread per CPU
+    BatchCompiler(const CompilerOptions& options, std::size_t jobs = 0) : m_options(options), m_jobs(jobs) {}
+    ~BatchCompiler() {}
+
+    BatchCompiler(const BatchCompiler&)            = delete;
+    BatchCompiler(BatchCompiler&&)                 = delete;
+    BatchCompiler& operator=(const BatchCompiler&) = delete;
+    BatchCompiler& operator=(BatchCompiler&&)      = delete;
+
+    void addInput(std::string path) { m_inputs.push_back(std::move(path)); }
+
+    // one input per line, empty lines and lines starting with # are skipped
+    // throws InterpretError if the manifest can't be read
+    void addManifest(const std::string& path);
+
+    // writes output of input.src to input.s or input.o, in outputDir if it isn't nullptr
+    // diagnostics are written in order of inputs, returns number of failed inputs
+    std::size_t run(const char* outputDir, std::ostream& diagnostics);
+
+    // compiles inputs in memory with 1, 2, 4, ... threads up to jobs, JSON to out
+    // throws InterpretError if an input can't be read
+    void benchmark(std::size_t runs, std::ostream& out);
+
+private:
+    // source of input, false if it can't be read
+    static bool read(const std::string& path, std::string& source);
+
+private:
+    CompilerOptions          m_options;
+    std::size_t              m_jobs;
+    std::vector<std::string> m_inputs;
+};
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <list>
+#include <memory>
+
+#include "AllocationTracker.h"
+#include "Benchmark.h"
+#include "DataLayout.h"
+#include "FrameAllocator.h"
+#include "Interpreter.h"
+#include "Lexer.h"
+#include "LoopAnalyzer.h"
+#include "Parser.h"
+#include "SemanticAnalyzer.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void Benchmark::addCases(std::string_view spec)
+{
+    while (!spec.empty()) {
+        std::string_view item = spec.substr(0, spec.find(','));
+        spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+
+        std::size_t      colon = item.find(':');
+        std::string_view name  = item.substr(0, colon);
+        std::size_t      size  = 0;
+
+        if (colon == std::string_view::npos ||
+            std::from_chars(item.data() + colon + 1, item.data() + item.size(), size).ec != std::errc() || size == 0) {
+            throw InterpretError("benchmark case must be shape:size, got " + std::string(item));
+        }
+
+        if (name == "wide") {
+            addCase(ProgramGenerator::Shape::WIDE, size);
+        }
+        else if (name == "deep") {
+            addCase(ProgramGenerator::Shape::DEEP, size);
+        }
+        else if (name == "expr") {
+            addCase(ProgramGenerator::Shape::EXPR, size);
+        }
+        else {
+            throw InterpretError("unknown benchmark shape " + std::string(name));
+        }
+    }
+}
+
+template <typename Measure>
+void Benchmark::compile(const std::string& source, Counts& counts, Measure&& measure)
+{
+    Lexer            lexer;
+    Parser           parser;
+    SemanticAnalyzer sa;
+
+    std::list<Token> ts;
+    ast::ASTNodePtr  tree;
+
+    measure(LEXER, [&] { ts = lexer.tokenize(source); });
+    measure(PARSER, [&] { tree = parser.parse(ts); });
+    counts.nodes = countNodes(tree);
+
+    measure(SEMANTIC, [&] { sa.analyze(tree); });
+    counts.analyzed = countNodes(tree);
+
+    // passes between analysis and code generation aren't measured
+    LoopAnalyzer la;
+    la.analyze(tree);
+    FrameAllocator fa(sa.getSymbolTable());
+    fa.allocate(tree);
+    DataLayout dl(sa.getSymbolTable());
+    dl.layout(tree);
+
+    Interpreter interpreter(std::move(sa.getSymbolTable()));
+    measure(INTERPRETER, [&] { counts.instructions = interpreter.interpret(tree).text.size(); });
+
+    counts.tokens = ts.size();
+}
+
+void Benchmark::run(std::ostream& out)
+{
+    std::unique_ptr<PerfCounters> perf = m_perf ? std::make_unique<PerfCounters>() : nullptr;
+
+    out << std::fixed << "{\n  \"seed\": " << m_seed << ",\n  \"runs\": " << m_runs << ",\n";
+
+    // phases are written without counters
+    if (perf && !perf->available()) {
+        out << "  \"perf_error\": \"" << perf->error() << "\",\n";
+        perf.reset();
+    }
+
+    out << "  \"cases\": [";
+
+    for (std::size_t c = 0; c < m_cases.size(); c++) {
+        auto [shape, size] = m_cases[c];
+
+        // every case has its own generator, so a case doesn't depend on the others
+        ProgramGenerator generator(m_seed);
+        std::string      source = generator.generate(shape, size);
+
+        std::vector<double> times[PHASES];
+        AllocationStats     allocations[PHASES];
+        Counts              counts;
+
+        for (std::size_t r = 0; r < m_runs; r++) {
+            compile(source,
+                    counts,
+                    [&times](Phase i, auto&& fn)
+                    {
+                        Clock::time_point start = Clock::now();
+                        fn();
+                        times[i].push_back(seconds(start, Clock::now()));
+                    });
+        }
+
+        // one more run with tracking enabled, it would slow down the timed runs
+        bool tracking = AllocationTracker::enabled();
+        AllocationTracker::enable(true);
+        compile(source,
+                counts,
+                [&allocations](Phase i, auto&& fn)
+                {
+                    AllocationStats start = AllocationTracker::stats();
+                    AllocationTracker::resetPeak();
+                    fn();
+
+                    const AllocationStats& now = AllocationTracker::stats();
+                    allocations[i] = {now.count - start.count, now.bytes - start.bytes, now.live - start.live,
+                                      now.peak - start.live};
+                });
+        AllocationTracker::enable(tracking);
+
+        // and one with hardware counters, reading them costs system calls
+        PerfCounters::Values counters[PHASES] = {};
+        if (perf) {
+            compile(source,
+                    counts,
+                    [&counters, &perf](Phase i, auto&& fn)
+                    {
+                        PerfCounters::Values start = perf->read();
+                        fn();
+                        counters[i] = PerfCounters::difference(perf->read(), start);
+                    });
+        }
+
+        Timing timing[PHASES];
+        for (std::size_t i = 0; i < PHASES; i++) {
+            timing[i].best = *std::ranges::min_element(times[i]);
+            for (double t : times[i]) {
+                timing[i].mean += t / times[i].size();
+            }
+        }
+
+        out << (c ? "," : "") << "\n    {\n"
+            << "      \"shape\": \"" << ProgramGenerator::shapeName(shape) << "\",\n"
+            << "      \"size\": " << size << ",\n"
+            << "      \"bytes\": " << source.size() << ",\n"
+            << "      \"tokens\": " << counts.tokens << ",\n"
+            << "      \"nodes\": " << counts.nodes << ",\n"
+            << "      \"analyzed_nodes\": " << counts.analyzed << ",\n"
+            << "      \"instructions\": " << counts.instructions << ",\n"
+            << "      \"phases\": {\n";
+
+        const char* names[PHASES] = {"lexer", "parser", "semantic", "interpreter"};
+        std::size_t items[PHASES] = {counts.tokens, counts.nodes, counts.nodes, counts.analyzed};
+
+        for (std::size_t i = 0; i < PHASES; i++) {
+            writePhase(out,
+                       names[i],
+                       timing[i],
+                       allocations[i],
+                       perf.get(),
+                       counters[i],
+                       items[i],
+                       i == LEXER ? "tokens" : "nodes",
+                       i + 1 == PHASES);
+        }
+
+        out << "      }\n    }";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+std::size_t Benchmark::countNodes(const ast::ASTNodePtr& node)
+{
+    std::size_t count = 1;
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        count += countNodes(c);
+    }
+    return count;
+}
+
+void Benchmark::writePhase(std::ostream&               out,
+                           std::string_view            name,
+                           const Timing&               timing,
+                           const AllocationStats&      allocations,
+                           const PerfCounters*         perf,
+                           const PerfCounters::Values& counters,
+                           std::size_t                 items,
+                           std::string_view            unit,
+                           bool                        last)
+{
+    out << "        \"" << name << "\": {\"best_ms\": " << std::setprecision(3) << timing.best * 1e3
+        << ", \"mean_ms\": " << timing.mean * 1e3 << ", \"" << unit << "_per_s\": " << std::setprecision(0)
+        << items / timing.best << ", \"allocs\": " << allocations.count << ", \"alloc_bytes\": " << allocations.bytes
+        << ", \"peak_bytes\": " << allocations.peak;
+
+    if (perf) {
+        perf->writeFields(out, counters);
+    }
+    out << '}' << (last ? "\n" : ",\n");
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+#include "AllocationTracker.h"
+#include "PerfCounters.h"
+#include "ProgramGenerator.h"
+
+// times compiler phases on generated programs, counts their allocations and optionally
+// hardware events, results are written as JSON
+class Benchmark
+{
+public:
+    // perf adds hardware counters of phases when the kernel allows them
+    Benchmark(std::uint64_t seed, std::size_t runs, bool perf = false) : m_seed(seed), m_runs(runs), m_perf(perf) {}
+    ~Benchmark() {}
+
+    Benchmark(const Benchmark&)            = delete;
+    Benchmark(Benchmark&&)                 = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+    Benchmark& operator=(Benchmark&&)      = delete;
+
+    // parses comma separated list of shape:size, throws InterpretError on bad input
+    void addCases(std::string_view spec);
+    void addCase(ProgramGenerator::Shape shape, std::size_t size) { m_cases.emplace_back(shape, size); }
+
+    void run(std::ostream& out);
+
+    static constexpr std::string_view DEFAULT_CASES = "wide:20000,deep:200,expr:2000";
+
+private:
+    enum Phase
+    {
+        LEXER,
+        PARSER,
+        SEMANTIC,
+        INTERPRETER,
+        PHASES,
+    };
+
+    // best and mean time of one phase in seconds
+    struct Timing
+    {
+        double best = 0.0;
+        double mean = 0.0;
+    };
+
+    struct Counts
+    {
+        std::size_t tokens       = 0;
+        std::size_t nodes        = 0; // after parsing
+        std::size_t analyzed     = 0; // after semantic analysis
+        std::size_t instructions = 0;
+    };
+
+    // runs all phases on source, each phase is run by measure(Phase, fn)
+    template <typename Measure>
+    void compile(const std::string& source, Counts& counts, Measure&& measure);
+
+    static std::size_t countNodes(const ast::ASTNodePtr& node);
+
+    // counters are written if perf is not nullptr
+    static void writePhase(std::ostream&               out,
+                           std::string_view            name,
+                           const Timing&               timing,
+                           const AllocationStats&      allocations,
+                           const PerfCounters*         perf,
+                           const PerfCounters::Values& counters,
+                           std::size_t                 items,
+                           std::string_view            unit,
+                           bool                        last);
+
+private:
+    std::uint64_t m_seed;
+    std::size_t   m_runs;
+    bool          m_perf;
+
+    std::vector<std::pair<ProgramGenerator::Shape, std::size_t>> m_cases;
+};
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <array>
+#include <format>
+
+#include "Bytecode.h"
+
+namespace bc
+{
+struct OpcodeInfo
+{
+    const char* name;
+    Format      format;
+};
+
+// indexed by Opcode
+static constexpr std::array<OpcodeInfo, 48> Opcodes = {
+    {
+     {"mov", Format::AB},
+     {"add.i", Format::ABC},
+     {"sub.i", Format::ABC},
+     {"mul.i", Format::ABC},
+     {"div.i", Format::ABC},
+     {"add.f", Format::ABC},
+     {"sub.f", Format::ABC},
+     {"mul.f", Format::ABC},
+     {"div.f", Format::ABC},
+     {"neg.i", Format::AB},
+     {"neg.f", Format::AB},
+     {"lt.i", Format::ABC},
+     {"le.i", Format::ABC},
+     {"eq.i", Format::ABC},
+     {"ne.i", Format::ABC},
+     {"lt.f", Format::ABC},
+     {"le.f", Format::ABC},
+     {"eq.f", Format::ABC},
+     {"ne.f", Format::ABC},
+     {"i2f", Format::AB},
+     {"f2i", Format::AB},
+     {"f2b", Format::AB},
+     {"f2c", Format::AB},
+     {"i2b", Format::AB},
+     {"i2c", Format::AB},
+     {"load.int", Format::MEMORY},
+     {"load.float", Format::MEMORY},
+     {"load.bool", Format::MEMORY},
+     {"load.char", Format::MEMORY},
+     {"store.int", Format::MEMORY},
+     {"store.float", Format::MEMORY},
+     {"store.bool", Format::MEMORY},
+     {"store.char", Format::MEMORY},
+     {"check", Format::CHECK},
+     {"jmp", Format::J},
+     {"jz", Format::AJ},
+     {"jnz", Format::AJ},
+     {"jlt.i", Format::ABJ},
+     {"jle.i", Format::ABJ},
+     {"jeq.i", Format::ABJ},
+     {"jne.i", Format::ABJ},
+     {"jlt.f", Format::ABJ},
+     {"jle.f", Format::ABJ},
+     {"jeq.f", Format::ABJ},
+     {"jne.f", Format::ABJ},
+     {"jnlt.f", Format::ABJ},
+     {"jnle.f", Format::ABJ},
+     {"halt", Format::K},
+     }
+};
+
+static_assert(Opcodes.size() == static_cast<std::size_t>(Opcode::HALT) + 1);
+
+std::uint8_t sizeOf(Opcode op)
+{
+    switch (op) {
+        case Opcode::LOAD_INT:
+        case Opcode::LOAD_FLOAT:
+        case Opcode::STORE_INT:
+        case Opcode::STORE_FLOAT:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+Format formatOf(Opcode op)
+{
+    return Opcodes[static_cast<std::size_t>(op)].format;
+}
+
+std::string toString(const Instruction& instr)
+{
+    const OpcodeInfo& info = Opcodes[static_cast<std::size_t>(instr.op)];
+
+    switch (info.format) {
+        case Format::ABC:
+            return std::format("{:<12}r{}, r{}, r{}", info.name, instr.a, instr.b, instr.c);
+        case Format::AB:
+            return std::format("{:<12}r{}, r{}", info.name, instr.a, instr.b);
+        case Format::MEMORY:
+            if (instr.b == ZERO) {
+                return std::format("{:<12}r{}, [{}]", info.name, instr.a, instr.c);
+            }
+            return std::format("{:<12}r{}, [{} + r{} * {}]", info.name, instr.a, instr.c, instr.b, +sizeOf(instr.op));
+        case Format::CHECK:
+            return std::format("{:<12}r{}, {}", info.name, instr.a, instr.c);
+        case Format::AJ:
+            return std::format("{:<12}r{}, @{}", info.name, instr.a, instr.c);
+        case Format::ABJ:
+            return std::format("{:<12}r{}, r{}, @{}", info.name, instr.a, instr.b, instr.c);
+        case Format::J:
+            return std::format("{:<12}@{}", info.name, instr.c);
+        case Format::K:
+            return std::format("{:<12}{}", info.name, instr.c);
+    }
+    return "";
+}
+
+void printBytecode(const Program& program, std::ostream& out)
+{
+    out << std::format("; {} registers, {} bytes of memory\n", program.registers.size(), program.memory.size());
+
+    for (std::size_t r = 0; r < program.names.size(); r++) {
+        if (!program.names[r].empty()) {
+            out << std::format(";   {:<8}{}\n", std::format("r{}", r), program.names[r]);
+        }
+    }
+
+    std::vector<std::pair<std::uint32_t, std::string>> globals;
+    for (const auto& [name, address] : program.globals) {
+        globals.emplace_back(address, name);
+    }
+    std::ranges::sort(globals);
+
+    for (const auto& [address, name] : globals) {
+        out << std::format(";   {:<8}{}\n", std::format("[{}]", address), name);
+    }
+
+    out << '\n';
+    for (std::size_t i = 0; i < program.code.size(); i++) {
+        out << std::format("{:>6}  {}\n", i, toString(program.code[i]));
+    }
+}
+} // namespace bc
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common.h"
+
+// register-based bytecode executed by VM
+// scalar variables, constants and temporaries live in registers,
+// arrays and structs live in memory
+namespace bc
+{
+// bool and char values are kept extended to int
+union Value
+{
+    std::int32_t  i;
+    float         f;
+    std::uint32_t bits;
+};
+
+// _I opcodes work on int, bool and char values, _F opcodes on float values
+enum class Opcode : std::uint8_t
+{
+    MOV, // a = b
+
+    ADD_I, // a = b op c
+    SUB_I,
+    MUL_I,
+    DIV_I, // exits with code 1 if c == 0, INT_MIN / -1 wraps
+    ADD_F,
+    SUB_F,
+    MUL_F,
+    DIV_F,
+    NEG_I, // a = -b
+    NEG_F,
+
+    LT_I, // a = b op c, result is bool
+    LE_I,
+    EQ_I,
+    NE_I,
+    LT_F,
+    LE_F,
+    EQ_F,
+    NE_F,
+
+    I2F, // a = conversion of b
+    F2I,
+    F2B,
+    F2C,
+    I2B,
+    I2C,
+
+    LOAD_INT, // a = memory[c + b * size]
+    LOAD_FLOAT,
+    LOAD_BOOL,
+    LOAD_CHAR,
+    STORE_INT, // memory[c + b * size] = a
+    STORE_FLOAT,
+    STORE_BOOL,
+    STORE_CHAR,
+
+    CHECK, // exits with code 1 if a is not in [0, c)
+
+    JMP, // jump to c
+    JZ,  // jump to c if a == 0
+    JNZ,
+
+    JLT_I, // jump to c if a op b
+    JLE_I,
+    JEQ_I,
+    JNE_I,
+    JLT_F,
+    JLE_F,
+    JEQ_F,
+    JNE_F,
+    JNLT_F, // jump to c if !(a < b), taken for unordered operands
+    JNLE_F,
+
+    HALT, // exits with code c
+};
+
+// operands used by an opcode
+enum class Format : std::uint8_t
+{
+    ABC,    // registers
+    AB,     // registers
+    MEMORY, // register, index register, address
+    CHECK,  // register, length
+    AJ,     // register, target
+    ABJ,    // registers, target
+    J,      // target
+    K,      // immediate
+};
+
+struct Instruction
+{
+    Opcode        op;
+    std::uint16_t a = 0;
+    std::uint16_t b = 0;
+    std::int32_t  c = 0; // register, address, immediate or jump target
+};
+
+// scalar global kept in register, written to memory at exit
+struct Writeback
+{
+    std::uint16_t reg;
+    std::uint32_t address;
+    ts::Type      type;
+};
+
+struct Program
+{
+    std::vector<Instruction>  code;
+    std::vector<Value>        registers; // initial values: zero, variables, temporaries, constants
+    std::vector<std::string>  names;     // register names for disassembly, empty for temporaries
+    std::vector<std::uint8_t> memory;    // initial memory: globals, then stack frame
+
+    std::unordered_map<std::string, std::uint32_t> globals; // name -> address in memory
+    std::vector<Writeback>                         writeback;
+};
+
+constexpr std::uint16_t ZERO = 0; // register that is always 0
+
+// two's complement wrap around as in generated code
+inline std::int32_t wrap(std::int64_t value)
+{
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+}
+
+// cvttss2si result, out of range and NaN give INT32_MIN
+inline std::int32_t truncate(float value)
+{
+    if (!(value >= -2147483648.0f && value < 2147483648.0f)) {
+        return std::numeric_limits<std::int32_t>::min();
+    }
+    return static_cast<std::int32_t>(value);
+}
+
+Format       formatOf(Opcode op);
+std::uint8_t sizeOf(Opcode op); // element size of loads and stores
+std::string  toString(const Instruction& instr);
+
+// writes register table and instructions
+void printBytecode(const Program& program, std::ostream& out);
+} // namespace bc
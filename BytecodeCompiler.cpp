@@ -0,0 +1,608 @@
+#include <algorithm>
+#include <format>
+
+#include "BytecodeCompiler.h"
+#include "Profiler.h"
+
+// constant operands are marked until constants get their registers
+static constexpr std::uint16_t CONSTANT = 0x8000;
+
+// result of +, -, * or / or of negation can be out of the range of its type
+static bool isArithmetic(const ast::ASTNodePtr& node)
+{
+    if (std::holds_alternative<ast::UnaryExpr>(node->getData())) {
+        return true;
+    }
+    const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&node->getData());
+
+    return be && (be->getLiteral() == "+" || be->getLiteral() == "-" || be->getLiteral() == "*" ||
+                  be->getLiteral() == "/");
+}
+
+const bc::Program& BytecodeCompiler::compile(const ast::ASTNodePtr& ast)
+{
+    TimeScope scope("bytecode compile");
+
+    m_program = {};
+    m_registers.clear();
+    m_addresses.clear();
+    m_constants.clear();
+    m_constantValues.clear();
+    m_temporaries    = 0;
+    m_maxTemporaries = 0;
+
+    layoutSymbols();
+    compileNode(ast);
+    emit(bc::Opcode::HALT, 0, 0, 0);
+    relocateConstants();
+
+    return m_program;
+}
+
+void BytecodeCompiler::layoutSymbols()
+{
+    using STEntry = std::tuple<std::size_t, std::string, std::shared_ptr<Symbol>>;
+
+    // sorted, so that layout doesn't depend on hash table order
+    std::vector<STEntry> symbols;
+    for (const auto& [id, scope] : m_symbolTable) {
+        for (const auto& [name, sym] : *scope) {
+            symbols.emplace_back(id, name, sym);
+        }
+    }
+    std::ranges::sort(symbols, {}, [](const STEntry& e) { return std::tie(std::get<0>(e), std::get<1>(e)); });
+
+    m_program.registers.push_back({0});
+    m_program.names.push_back("zero");
+
+    std::uint32_t address = 0;
+
+    for (const auto& [id, name, sym] : symbols) {
+        bool global = SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_GLOBAL);
+        bool scalar = sym->type != ts::Type::struct_t && !SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_ARRAY);
+
+        if (scalar) {
+            std::uint16_t reg = m_program.registers.size();
+
+            bc::Value value;
+            value.bits = global && SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_COMPILETIME) ? sym->value : 0;
+
+            m_registers[sym.get()] = reg;
+            m_program.registers.push_back(value);
+            m_program.names.push_back(name);
+        }
+
+        // globals are in memory too, so their final values can be read
+        if (global) {
+            address = alignTo(address, sym->align);
+
+            m_program.globals[name] = address;
+            if (scalar) {
+                m_program.writeback.push_back({m_registers[sym.get()], address, sym->type});
+            }
+            else {
+                m_addresses[sym.get()] = address;
+            }
+            address += sym->size;
+        }
+    }
+
+    // locals are below the frame base as in the stack frame
+    std::uint32_t frameBase = alignTo(address, 32) + alignTo(m_symbolTable.getFrameSize(), 32);
+
+    for (const auto& [id, name, sym] : symbols) {
+        if (!SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_GLOBAL) && !m_registers.contains(sym.get())) {
+            m_addresses[sym.get()] = frameBase - sym->offset;
+        }
+    }
+
+    m_program.memory.resize(frameBase);
+
+    if (m_program.registers.size() >= CONSTANT) {
+        error("too many variables for bytecode");
+    }
+    m_firstTemporary = m_program.registers.size();
+}
+
+void BytecodeCompiler::compileNode(const ast::ASTNodePtr& node)
+{
+    // temporaries don't live across statements
+    m_temporaries = 0;
+
+    std::visit(
+        [&node, this](auto&& arg) -> void
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::disjunction_v<std::is_same<T, ast::Root>,
+                                             std::is_same<T, ast::BodyThen>,
+                                             std::is_same<T, ast::BodyElse>>) {
+                for (const ast::ASTNodePtr& c : node->getChildren()) {
+                    compileNode(c);
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::Declaration>) {
+                if (node->getChildren().size() != 2) {
+                    return;
+                }
+
+                const ast::ASTNodePtr& id  = node->getChildren().front();
+                const Symbol&          sym = *std::get<ast::Identifier>(id->getData()).getSymbol();
+
+                // value is already in register
+                if (SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_GLOBAL) && SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_COMPILETIME)) {
+                    return;
+                }
+
+                compileStore(id, node->getChildren().back());
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                if (arg.getLiteral() != "=") {
+                    error("expression statement is not an assignment");
+                }
+
+                compileStore(node->getChildren().front(), node->getChildren().back());
+            }
+            else if constexpr (std::is_same_v<T, ast::Branch>) {
+                compileBranch(node);
+            }
+            else if constexpr (std::is_same_v<T, ast::WhileLoop>) {
+                compileLoop(node);
+            }
+        },
+        node->getData());
+}
+
+std::uint16_t BytecodeCompiler::compileExpr(const ast::ASTNodePtr& node, std::optional<std::uint16_t> target)
+{
+    return std::visit(
+        [&node, &target, this](auto&& arg) -> std::uint16_t
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::is_same_v<T, ast::Integer>) {
+                return constant({arg.getValue()}, std::to_string(arg.getValue()));
+            }
+            else if constexpr (std::is_same_v<T, ast::Boolean>) {
+                return constant({arg.getValue() ? 1 : 0}, arg.getValue() ? "true" : "false");
+            }
+            else if constexpr (std::is_same_v<T, ast::Float>) {
+                bc::Value value;
+                value.f = arg.getValue();
+                return constant(value, std::format("{}f", arg.getValue()));
+            }
+            else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                if (!m_registers.contains(arg.getSymbol().get())) {
+                    error("array cannot be used as a value");
+                }
+                return m_registers[arg.getSymbol().get()];
+            }
+            else if constexpr (std::is_same_v<T, ast::UnaryExpr>) {
+                std::uint16_t src  = compileExpr(node->getChildren().front());
+                std::uint16_t dest = target ? *target : temporary();
+
+                emit(arg.getType() == ts::Type::float_t ? bc::Opcode::NEG_F : bc::Opcode::NEG_I, dest, src);
+                return dest;
+            }
+            else if constexpr (std::is_same_v<T, ast::ImplicitTypeCast>) {
+                std::uint16_t src = compileExpr(node->getChildren().front());
+
+                return compileCast(src, arg.getFromCast(), arg.getToCast(), target);
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                return compileBinary(node, target);
+            }
+            else {
+                error("node is not an expression");
+            }
+        },
+        node->getData());
+}
+
+std::uint16_t BytecodeCompiler::compileBinary(const ast::ASTNodePtr& node, std::optional<std::uint16_t> target)
+{
+    const ast::BinaryExpr& be = std::get<ast::BinaryExpr>(node->getData());
+    std::string            op = be.getLiteral();
+
+    if (op == "[]" || op == ".") {
+        static const std::unordered_map<ts::Type, bc::Opcode> loads = {
+            {ts::Type::int_t,   bc::Opcode::LOAD_INT  },
+            {ts::Type::float_t, bc::Opcode::LOAD_FLOAT},
+            {ts::Type::bool_t,  bc::Opcode::LOAD_BOOL },
+            {ts::Type::char_t,  bc::Opcode::LOAD_CHAR },
+        };
+
+        auto [index, address] = compileElement(node);
+        std::uint16_t dest    = target ? *target : temporary();
+
+        emit(loads.at(be.getType()), dest, index, address);
+        return dest;
+    }
+
+    if (ast::isLogical(node)) {
+        // result is written after all operands are read, target may be one of them
+        std::uint16_t            mark = m_temporaries;
+        std::vector<std::size_t> jumpFalse;
+
+        compileJump(node, false, jumpFalse);
+
+        m_temporaries      = mark;
+        std::uint16_t dest = target ? *target : temporary();
+
+        emit(bc::Opcode::MOV, dest, constant({1}, "true"));
+        std::size_t jumpEnd = emit(bc::Opcode::JMP);
+        patch(jumpFalse, m_program.code.size());
+        emit(bc::Opcode::MOV, dest, constant({0}, "false"));
+        patch(jumpEnd, m_program.code.size());
+
+        return dest;
+    }
+
+    const ast::ASTNodePtr& left  = node->getChildren().front();
+    const ast::ASTNodePtr& right = node->getChildren().back();
+
+    // both operands have the same type after semantic analysis
+    bool isFlt = ast::getType(left) == ts::Type::float_t;
+
+    std::uint16_t mark = m_temporaries;
+    std::uint16_t lhs  = compileExpr(left);
+    std::uint16_t rhs  = compileExpr(right);
+
+    // operands are read before the result is written, so their temporaries can be reused
+    m_temporaries      = mark;
+    std::uint16_t dest = target ? *target : temporary();
+
+    using OpcodePair = std::pair<bc::Opcode, bc::Opcode>;
+
+    // int and float forms, > and >= swap operands
+    static const std::unordered_map<std::string, OpcodePair> opcodes = {
+        {"+",  {bc::Opcode::ADD_I, bc::Opcode::ADD_F}},
+        {"-",  {bc::Opcode::SUB_I, bc::Opcode::SUB_F}},
+        {"*",  {bc::Opcode::MUL_I, bc::Opcode::MUL_F}},
+        {"/",  {bc::Opcode::DIV_I, bc::Opcode::DIV_F}},
+        {"<",  {bc::Opcode::LT_I, bc::Opcode::LT_F}  },
+        {"<=", {bc::Opcode::LE_I, bc::Opcode::LE_F}  },
+        {">",  {bc::Opcode::LT_I, bc::Opcode::LT_F}  },
+        {">=", {bc::Opcode::LE_I, bc::Opcode::LE_F}  },
+        {"==", {bc::Opcode::EQ_I, bc::Opcode::EQ_F}  },
+        {"!=", {bc::Opcode::NE_I, bc::Opcode::NE_F}  },
+    };
+
+    if (!opcodes.contains(op)) {
+        error(std::format("unknown operator {}", op));
+    }
+
+    auto [intOp, fltOp] = opcodes.at(op);
+
+    if (op == ">" || op == ">=") {
+        std::swap(lhs, rhs);
+    }
+
+    emit(isFlt ? fltOp : intOp, dest, lhs, rhs);
+    return dest;
+}
+
+std::uint16_t BytecodeCompiler::compileCast(std::uint16_t                src,
+                                            ts::Type                     from,
+                                            ts::Type                     to,
+                                            std::optional<std::uint16_t> target)
+{
+    bc::Opcode op;
+
+    if (from == to) {
+        return src;
+    }
+
+    if (to == ts::Type::float_t) {
+        op = bc::Opcode::I2F;
+    }
+    else if (from == ts::Type::float_t) {
+        op = to == ts::Type::bool_t ? bc::Opcode::F2B : (to == ts::Type::char_t ? bc::Opcode::F2C : bc::Opcode::F2I);
+    }
+    else if (to == ts::Type::bool_t) {
+        op = bc::Opcode::I2B;
+    }
+    else if (to == ts::Type::char_t) {
+        op = bc::Opcode::I2C;
+    }
+    else {
+        return src; // bool and char values are already extended to int
+    }
+
+    std::uint16_t dest = target ? *target : temporary();
+    emit(op, dest, src);
+    return dest;
+}
+
+void BytecodeCompiler::compileStore(const ast::ASTNodePtr& target, const ast::ASTNodePtr& value)
+{
+    if (const ast::Identifier* id = std::get_if<ast::Identifier>(&target->getData())) {
+        if (!m_registers.contains(id->getSymbol().get())) {
+            error("array cannot be assigned");
+        }
+
+        std::uint16_t reg = m_registers[id->getSymbol().get()];
+        std::uint16_t src = compileExpr(value, reg);
+
+        // char arithmetic is done in int, memory of the other backends keeps the low byte
+        if (id->getSymbol()->type == ts::Type::char_t && isArithmetic(value)) {
+            src = compileCast(src, ts::Type::int_t, ts::Type::char_t, reg);
+        }
+
+        if (src != reg) {
+            emit(bc::Opcode::MOV, reg, src);
+        }
+        return;
+    }
+
+    static const std::unordered_map<ts::Type, bc::Opcode> stores = {
+        {ts::Type::int_t,   bc::Opcode::STORE_INT  },
+        {ts::Type::float_t, bc::Opcode::STORE_FLOAT},
+        {ts::Type::bool_t,  bc::Opcode::STORE_BOOL },
+        {ts::Type::char_t,  bc::Opcode::STORE_CHAR },
+    };
+
+    std::uint16_t src      = compileExpr(value);
+    auto [index, address] = compileElement(target);
+
+    emit(stores.at(ast::getType(target)), src, index, address);
+}
+
+std::pair<std::uint16_t, std::int32_t> BytecodeCompiler::compileElement(const ast::ASTNodePtr& node)
+{
+    ast::ElementLocation loc = ast::elementLocation(node);
+    const Symbol&        sym = *loc.variable->getSymbol();
+
+    std::int64_t address = m_addresses.at(&sym) + loc.disp;
+
+    // member of scalar struct
+    if (!loc.subscript) {
+        return {bc::ZERO, address};
+    }
+
+    if (const ast::Integer* i = ast::constantIndex(*loc.subscript)) {
+        return {bc::ZERO, address + i->getValue() * loc.stride};
+    }
+
+    std::uint16_t reg = compileExpr((*loc.subscript)->getChildren().back());
+
+    if (std::get<ast::BinaryExpr>((*loc.subscript)->getData()).isBoundsChecked()) {
+        emit(bc::Opcode::CHECK, reg, 0, sym.length);
+    }
+
+    // index is scaled by element size in the VM, stride is a multiple of it
+    std::int64_t size = ts::TypeSize[ast::getType(node)];
+
+    if (loc.stride != size) {
+        std::uint16_t scaled = temporary();
+        std::int32_t factor = loc.stride / size;
+        emit(bc::Opcode::MUL_I, scaled, reg, constant({factor}, std::to_string(factor)));
+        reg = scaled;
+    }
+
+    return {reg, address};
+}
+
+std::vector<std::size_t> BytecodeCompiler::compileCondition(const ast::ASTNodePtr& cond, bool jumpIf)
+{
+    m_temporaries = 0;
+
+    std::vector<std::size_t> jumps;
+    compileJump(cond->getChildren().front(), jumpIf, jumps);
+
+    return jumps;
+}
+
+void BytecodeCompiler::compileJump(const ast::ASTNodePtr& expr, bool jumpIf, std::vector<std::size_t>& jumps)
+{
+    if (ast::isLogical(expr)) {
+        bool                   isAnd = std::get<ast::BinaryExpr>(expr->getData()).getLiteral() == "&&";
+        const ast::ASTNodePtr& left  = expr->getChildren().front();
+        const ast::ASTNodePtr& right = expr->getChildren().back();
+
+        // false left operand of && and true left operand of || already give the outcome looked for
+        if (isAnd != jumpIf) {
+            compileJump(left, jumpIf, jumps);
+            compileJump(right, jumpIf, jumps);
+            return;
+        }
+
+        // otherwise the left operand can only decide the opposite outcome, which skips the right one
+        std::vector<std::size_t> skip;
+
+        compileJump(left, !jumpIf, skip);
+        compileJump(right, jumpIf, jumps);
+        patch(skip, m_program.code.size());
+        return;
+    }
+
+    // temporaries of the operands are free once the jump has read them
+    std::uint16_t          mark = m_temporaries;
+    const ast::BinaryExpr* be   = std::get_if<ast::BinaryExpr>(&expr->getData());
+
+    using OpcodePair = std::pair<bc::Opcode, bc::Opcode>;
+
+    // jump if true and jump if false, the second operand goes first when the flag is set
+    struct FusedJump
+    {
+        OpcodePair ints;
+        bool       swapInts[2];
+        OpcodePair floats;
+        bool       swapFloats[2];
+    };
+
+    static const std::unordered_map<std::string, FusedJump> branches = {
+        {"<",
+         {{bc::Opcode::JLT_I, bc::Opcode::JLE_I}, {false, true}, {bc::Opcode::JLT_F, bc::Opcode::JNLT_F}, {false, false}}},
+        {"<=",
+         {{bc::Opcode::JLE_I, bc::Opcode::JLT_I}, {false, true}, {bc::Opcode::JLE_F, bc::Opcode::JNLE_F}, {false, false}}},
+        {">",
+         {{bc::Opcode::JLT_I, bc::Opcode::JLE_I}, {true, false}, {bc::Opcode::JLT_F, bc::Opcode::JNLT_F}, {true, true}}},
+        {">=",
+         {{bc::Opcode::JLE_I, bc::Opcode::JLT_I}, {true, false}, {bc::Opcode::JLE_F, bc::Opcode::JNLE_F}, {true, true}}},
+        {"==",
+         {{bc::Opcode::JEQ_I, bc::Opcode::JNE_I}, {false, false}, {bc::Opcode::JEQ_F, bc::Opcode::JNE_F}, {false, false}}},
+        {"!=",
+         {{bc::Opcode::JNE_I, bc::Opcode::JEQ_I}, {false, false}, {bc::Opcode::JNE_F, bc::Opcode::JEQ_F}, {false, false}}},
+    };
+
+    // relational condition is fused with the jump
+    if (be && branches.contains(be->getLiteral())) {
+        const FusedJump& branch = branches.at(be->getLiteral());
+
+        bool          isFlt = ast::getType(expr->getChildren().front()) == ts::Type::float_t;
+        std::uint16_t lhs   = compileExpr(expr->getChildren().front());
+        std::uint16_t rhs   = compileExpr(expr->getChildren().back());
+
+        bc::Opcode op   = isFlt ? (jumpIf ? branch.floats.first : branch.floats.second)
+                                : (jumpIf ? branch.ints.first : branch.ints.second);
+        bool       swap = isFlt ? branch.swapFloats[!jumpIf] : branch.swapInts[!jumpIf];
+
+        if (swap) {
+            std::swap(lhs, rhs);
+        }
+        jumps.push_back(emit(op, lhs, rhs));
+        m_temporaries = mark;
+        return;
+    }
+
+    // int is compared with zero without conversion to bool
+    const ast::ImplicitTypeCast* cast = std::get_if<ast::ImplicitTypeCast>(&expr->getData());
+    bool                         skip = cast && cast->getFromCast() != ts::Type::float_t;
+
+    std::uint16_t reg = compileExpr(skip ? expr->getChildren().front() : expr);
+
+    if (ast::getType(expr) == ts::Type::float_t) {
+        reg = compileCast(reg, ts::Type::float_t, ts::Type::bool_t, std::nullopt);
+    }
+
+    jumps.push_back(emit(jumpIf ? bc::Opcode::JNZ : bc::Opcode::JZ, reg));
+    m_temporaries = mark;
+}
+
+void BytecodeCompiler::compileBranch(const ast::ASTNodePtr& node)
+{
+    auto it = node->getChildren().begin();
+
+    const ast::ASTNodePtr& cond     = *it++;
+    const ast::ASTNodePtr& bodyThen = *it++;
+
+    std::vector<std::size_t> jumpElse = compileCondition(cond, false);
+    compileNode(bodyThen);
+
+    if (it == node->getChildren().end()) {
+        patch(jumpElse, m_program.code.size());
+        return;
+    }
+
+    std::size_t jumpEnd = emit(bc::Opcode::JMP);
+    patch(jumpElse, m_program.code.size());
+    compileNode(*it);
+    patch(jumpEnd, m_program.code.size());
+}
+
+void BytecodeCompiler::compileLoop(const ast::ASTNodePtr& node)
+{
+    const ast::ASTNodePtr& cond = node->getChildren().front();
+
+    // condition is checked at the bottom, one dispatch per iteration for the loop itself
+    std::vector<std::size_t> jumpEnd = compileCondition(cond, false);
+    std::size_t              start   = m_program.code.size();
+
+    compileNode(node->getChildren().back());
+    patch(compileCondition(cond, true), start);
+    patch(jumpEnd, m_program.code.size());
+}
+
+std::uint16_t BytecodeCompiler::temporary()
+{
+    std::uint16_t reg = m_firstTemporary + m_temporaries++;
+
+    if (reg >= CONSTANT) {
+        error("expression is too complex for bytecode");
+    }
+
+    m_maxTemporaries = std::max(m_maxTemporaries, m_temporaries);
+    return reg;
+}
+
+std::uint16_t BytecodeCompiler::constant(bc::Value value, const std::string& text)
+{
+    if (!m_constants.contains(value.bits)) {
+        if (m_constantValues.size() >= CONSTANT) {
+            error("too many constants for bytecode");
+        }
+        m_constants[value.bits] = m_constantValues.size();
+        m_constantValues.emplace_back(value, text);
+    }
+    return CONSTANT | m_constants[value.bits];
+}
+
+std::size_t BytecodeCompiler::emit(bc::Opcode op, std::uint16_t a, std::uint16_t b, std::int32_t c)
+{
+    m_program.code.push_back({op, a, b, c});
+    return m_program.code.size() - 1;
+}
+
+void BytecodeCompiler::patch(std::size_t jump, std::size_t target)
+{
+    m_program.code[jump].c = target;
+}
+
+void BytecodeCompiler::patch(const std::vector<std::size_t>& jumps, std::size_t target)
+{
+    for (std::size_t jump : jumps) {
+        patch(jump, target);
+    }
+}
+
+void BytecodeCompiler::relocateConstants()
+{
+    std::size_t first = m_firstTemporary + m_maxTemporaries;
+
+    if (first + m_constantValues.size() > UINT16_MAX) {
+        error("too many registers for bytecode");
+    }
+
+    auto relocate = [first](auto& reg)
+    {
+        if (reg & CONSTANT) {
+            reg = first + (reg & ~CONSTANT);
+        }
+    };
+
+    for (bc::Instruction& instr : m_program.code) {
+        switch (bc::formatOf(instr.op)) {
+            case bc::Format::ABC:
+                relocate(instr.a);
+                relocate(instr.b);
+                relocate(instr.c);
+                break;
+            case bc::Format::AB:
+            case bc::Format::MEMORY:
+            case bc::Format::ABJ:
+                relocate(instr.a);
+                relocate(instr.b);
+                break;
+            case bc::Format::CHECK:
+            case bc::Format::AJ:
+                relocate(instr.a);
+                break;
+            default:
+                break;
+        }
+    }
+
+    m_program.registers.resize(first);
+    m_program.names.resize(first);
+
+    for (const auto& [value, text] : m_constantValues) {
+        m_program.registers.push_back(value);
+        m_program.names.push_back("= " + text);
+    }
+}
+
+void BytecodeCompiler::error(std::string_view msg)
+{
+    throw InterpretError(msg);
+}
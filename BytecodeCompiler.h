@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+#include "Bytecode.h"
+#include "SymbolTable.h"
+
+// compiles analyzed AST to bytecode
+class BytecodeCompiler
+{
+public:
+    BytecodeCompiler(SymbolTable& st) : m_symbolTable(st) {}
+    ~BytecodeCompiler() {}
+
+    BytecodeCompiler(const BytecodeCompiler&)            = delete;
+    BytecodeCompiler(BytecodeCompiler&&)                 = delete;
+    BytecodeCompiler& operator=(const BytecodeCompiler&) = delete;
+    BytecodeCompiler& operator=(BytecodeCompiler&&)      = delete;
+
+    const bc::Program& compile(const ast::ASTNodePtr& ast);
+
+private:
+    // assigns registers to scalar variables and memory addresses to the others
+    void layoutSymbols();
+
+    void compileNode(const ast::ASTNodePtr& node);
+
+    // register with value of expression, result is computed to target if it has to be computed
+    std::uint16_t compileExpr(const ast::ASTNodePtr& node, std::optional<std::uint16_t> target = std::nullopt);
+    std::uint16_t compileBinary(const ast::ASTNodePtr& node, std::optional<std::uint16_t> target);
+    std::uint16_t compileCast(std::uint16_t src, ts::Type from, ts::Type to, std::optional<std::uint16_t> target);
+
+    void compileStore(const ast::ASTNodePtr& target, const ast::ASTNodePtr& value);
+
+    // index register (in units of element size) and address of element with index 0
+    std::pair<std::uint16_t, std::int32_t> compileElement(const ast::ASTNodePtr& node);
+
+    // emits jumps taken when condition equals jumpIf, returns their positions for patching
+    std::vector<std::size_t> compileCondition(const ast::ASTNodePtr& cond, bool jumpIf);
+    // adds positions of jumps taken when expression equals jumpIf, && and || short-circuit
+    void compileJump(const ast::ASTNodePtr& expr, bool jumpIf, std::vector<std::size_t>& jumps);
+
+    void compileBranch(const ast::ASTNodePtr& node);
+    void compileLoop(const ast::ASTNodePtr& node);
+
+    std::uint16_t temporary();
+    // text is shown in disassembly
+    std::uint16_t constant(bc::Value value, const std::string& text);
+
+    std::size_t emit(bc::Opcode op, std::uint16_t a = 0, std::uint16_t b = 0, std::int32_t c = 0);
+    void        patch(std::size_t jump, std::size_t target);
+    void        patch(const std::vector<std::size_t>& jumps, std::size_t target);
+
+    // moves constants after temporaries once their number is known
+    void relocateConstants();
+
+    [[noreturn]] void error(std::string_view msg);
+
+private:
+    SymbolTable& m_symbolTable;
+    bc::Program  m_program;
+
+    std::unordered_map<const Symbol*, std::uint16_t> m_registers; // scalar variables
+    std::unordered_map<const Symbol*, std::uint32_t> m_addresses; // arrays and structs
+
+    std::uint16_t m_firstTemporary = 0;
+    std::uint16_t m_temporaries    = 0; // in use by current statement
+    std::uint16_t m_maxTemporaries = 0;
+
+    std::unordered_map<std::uint32_t, std::uint16_t> m_constants; // bits -> index, register is assigned later
+    std::vector<std::pair<bc::Value, std::string>>   m_constantValues;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bit>
 #include <cstdint>
 #include <map>
 #include <string>
@@ -16,12 +17,21 @@ enum Type
     float_t,
     bool_t,
     char_t,
+    struct_t, // size and layout are in StructType
     unknown_t,
 };
 
-constexpr std::uint8_t TypeSize[]                = {/* int_t */ 4, /* float_t */ 4, /* bool_t */ 1, /* char_t */ 1};
-constexpr std::string  TypeNames[]               = {"int", "float", "bool", "char", "unknown type"};
-constexpr std::size_t  TypePrecedence[unknown_t] = {/* int_t */ 2, /* float_t */ 3, /* bool_t */ 1, /* char_t */ 1};
+constexpr std::uint8_t TypeSize[]                = {/* int_t */ 4,
+                                                    /* float_t */ 4,
+                                                    /* bool_t */ 1,
+                                                    /* char_t */ 1,
+                                                    /* struct_t */ 0};
+constexpr std::string  TypeNames[]               = {"int", "float", "bool", "char", "struct", "unknown type"};
+constexpr std::size_t  TypePrecedence[unknown_t] = {/* int_t */ 2,
+                                                    /* float_t */ 3,
+                                                    /* bool_t */ 1,
+                                                    /* char_t */ 1,
+                                                    /* struct_t */ 0};
 
 constexpr int NONCASTABLE = 0;
 constexpr int SAFE_CAST   = 1;
@@ -32,19 +42,33 @@ constexpr int isImplicitlyCastable(Type t1, Type t2)
 {
     constexpr int castTable[unknown_t][unknown_t] = {
   // int_t
-        {NONCASTABLE, SAFE_CAST,   SAFE_CAST,   UNSAFE_CAST},
+        {NONCASTABLE, SAFE_CAST,   SAFE_CAST,   UNSAFE_CAST, NONCASTABLE},
  // float_t
-        {UNSAFE_CAST, NONCASTABLE, SAFE_CAST,   NONCASTABLE},
+        {UNSAFE_CAST, NONCASTABLE, SAFE_CAST,   NONCASTABLE, NONCASTABLE},
  // bool_t
-        {SAFE_CAST,   SAFE_CAST,   NONCASTABLE, NONCASTABLE},
+        {SAFE_CAST,   SAFE_CAST,   NONCASTABLE, NONCASTABLE, NONCASTABLE},
  // char_t
-        {SAFE_CAST,   SAFE_CAST,   SAFE_CAST,   NONCASTABLE}
+        {SAFE_CAST,   SAFE_CAST,   SAFE_CAST,   NONCASTABLE, NONCASTABLE},
+ // struct_t
+        {NONCASTABLE, NONCASTABLE, NONCASTABLE, NONCASTABLE, NONCASTABLE}
     };
 
     return castTable[t1][t2];
 }
+
+// alignment of array storage: 32 bytes (AVX) if array fills at least one ymm register, else 16 bytes (SSE)
+constexpr std::uint32_t arrayAlignment(std::uint32_t size)
+{
+    return size >= 32 ? 32 : 16;
+}
 } // namespace ts
 
+// rounds value up to a multiple of align (power of two)
+constexpr std::size_t alignTo(std::size_t value, std::size_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
 template <typename T>
 std::uint32_t valueToLong(T&& t)
 {
@@ -52,14 +76,16 @@ std::uint32_t valueToLong(T&& t)
         return t;
     }
     else
-        return std::bit_cast<std::uint32_t, T>(t);
+        return std::bit_cast<std::uint32_t>(t);
 }
 
-// location in source code
+// location in source code, offset of a character in the buffers of SourceManager
+// line and column are only decoded for diagnostics
 struct Location
 {
-    std::size_t line = 0;
-    std::size_t col  = 0;
+    static constexpr std::uint32_t NONE = UINT32_MAX;
+
+    std::uint32_t offset = NONE;
 };
 
 class LexicalError
@@ -94,7 +120,7 @@ class SemanticError
 {
 public:
     SemanticError(const Location& loc, std::string_view what) : m_location(loc), m_msg(what) {}
-    SemanticError(std::string_view what) : m_location({0, 0}), m_msg(what) {}
+    SemanticError(std::string_view what) : m_location(), m_msg(what) {}
 
     const char* what() const { return m_msg.c_str(); }
 
@@ -0,0 +1,272 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <vector>
+
+#include "Common.h"
+#include "CompileCache.h"
+#include "Sha256.h"
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view STATS_FILE  = "stats";
+static constexpr std::string_view TEMP_PREFIX = "tmp.";
+
+// temporary files older than this are left by crashed writers
+static constexpr auto STALE_TEMP = std::chrono::hours(1);
+
+// writes all of data, false on error
+static bool writeAll(int fd, const char* data, std::size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// copies size bytes from in to out, in the kernel when it can
+static bool copyAll(int in, int out, std::size_t size)
+{
+    while (size > 0) {
+        ssize_t n = sendfile(out, in, nullptr, size);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        size -= n;
+    }
+
+    // sendfile can't append, e.g. to stdout opened with O_APPEND
+    char buffer[1 << 16];
+
+    while (size > 0) {
+        ssize_t n = read(in, buffer, std::min(size, sizeof(buffer)));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || !writeAll(out, buffer, n)) {
+            return false;
+        }
+        size -= n;
+    }
+    return true;
+}
+
+CompileCache::CompileCache(std::string dir, std::uint64_t capacity) : m_dir(std::move(dir)), m_capacity(capacity)
+{
+    std::error_code error;
+    fs::create_directories(m_dir, error);
+
+    if (error) {
+        throw InterpretError(std::format("can't create cache directory {}: {}", m_dir, error.message()));
+    }
+}
+
+std::string CompileCache::key(std::string_view source, std::string_view flags)
+{
+    // a rebuilt compiler has another size or modification time
+    static const std::string version = []
+    {
+        struct stat st = {};
+        stat("/proc/self/exe", &st);
+
+        return std::format("{}:{}:{}:{}.{}", st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    }();
+
+    Sha256 hash;
+
+    // lengths keep the parts apart
+    for (std::string_view part : {std::string_view(version), flags, source}) {
+        std::uint64_t size = part.size();
+        hash.update(&size, sizeof(size));
+        hash.update(part);
+    }
+    return hash.hex();
+}
+
+bool CompileCache::load(const std::string& key, const char* output)
+{
+    int in = open(entryPath(key).c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (in < 0) {
+        count(0, 1);
+        return false;
+    }
+
+    struct stat st;
+    int         out = output ? open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666) : STDOUT_FILENO;
+
+    if (fstat(in, &st) < 0 || out < 0) {
+        int error = errno;
+        close(in);
+        throw InterpretError(std::format("can't open {}: {}", out < 0 ? output : key, std::strerror(error)));
+    }
+
+    bool copied = copyAll(in, out, st.st_size);
+    int  error  = errno;
+
+    // modification time orders entries by their last use
+    futimens(in, nullptr);
+
+    close(in);
+    if (output) {
+        close(out);
+    }
+
+    if (!copied) {
+        throw InterpretError(std::format("write failed: {}", std::strerror(error)));
+    }
+
+    count(1, 0);
+    return true;
+}
+
+void CompileCache::store(const std::string& key, std::string_view output)
+{
+    static std::atomic<std::uint64_t> serial = 0;
+
+    // it would only push out everything else
+    if (output.size() > m_capacity) {
+        return;
+    }
+
+    std::string temp = std::format("{}/{}{}.{}", m_dir, TEMP_PREFIX, getpid(), serial++);
+    int         fd   = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return;
+    }
+
+    bool written = writeAll(fd, output.data(), output.size());
+
+    // readers see either no entry or the whole of it
+    if (close(fd) < 0 || !written || rename(temp.c_str(), entryPath(key).c_str()) < 0) {
+        unlink(temp.c_str());
+        return;
+    }
+
+    evict();
+}
+
+CompileCache::Stats CompileCache::count(std::uint64_t hits, std::uint64_t misses)
+{
+    Stats stats;
+
+    std::string path = m_dir + '/' + std::string(STATS_FILE);
+    int         fd   = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return stats;
+    }
+
+    // the lock is released when the file is closed
+    if (flock(fd, LOCK_EX) == 0 && pread(fd, &stats, sizeof(stats), 0) >= 0 && (hits || misses)) {
+        stats.hits += hits;
+        stats.misses += misses;
+        pwrite(fd, &stats, sizeof(stats), 0);
+    }
+    close(fd);
+
+    return stats;
+}
+
+void CompileCache::evict()
+{
+    struct Entry
+    {
+        fs::file_time_type used;
+        std::uint64_t      size;
+        fs::path           path;
+    };
+
+    std::vector<Entry> entries;
+    std::uint64_t      total = 0;
+    std::error_code    error;
+
+    fs::file_time_type now = fs::file_time_type::clock::now();
+
+    for (const fs::directory_entry& e : fs::directory_iterator(m_dir, error)) {
+        std::string name = e.path().filename().string();
+
+        if (name == STATS_FILE || !e.is_regular_file(error)) {
+            continue;
+        }
+
+        fs::file_time_type used = e.last_write_time(error);
+        std::uint64_t      size = e.file_size(error);
+
+        if (error) {
+            continue; // removed by another process
+        }
+
+        if (name.starts_with(TEMP_PREFIX)) {
+            if (now - used > STALE_TEMP) {
+                fs::remove(e.path(), error);
+            }
+            continue;
+        }
+
+        entries.push_back({used, size, e.path()});
+        total += size;
+    }
+
+    if (total <= m_capacity) {
+        return;
+    }
+
+    std::ranges::sort(entries, {}, &Entry::used);
+
+    for (const Entry& e : entries) {
+        if (total <= m_capacity) {
+            break;
+        }
+        fs::remove(e.path, error);
+        total -= e.size;
+    }
+}
+
+void CompileCache::printStats(std::ostream& out)
+{
+    Stats         stats   = count(0, 0);
+    std::uint64_t entries = 0;
+    std::uint64_t size    = 0;
+
+    std::error_code error;
+    for (const fs::directory_entry& e : fs::directory_iterator(m_dir, error)) {
+        std::string name = e.path().filename().string();
+
+        if (name != STATS_FILE && !name.starts_with(TEMP_PREFIX) && e.is_regular_file(error)) {
+            entries++;
+            size += e.file_size(error);
+        }
+    }
+
+    std::uint64_t lookups = stats.hits + stats.misses;
+
+    out << "cache " << m_dir << ": " << entries << " entries, " << size << " of " << m_capacity << " bytes, "
+        << stats.hits << " hits, " << stats.misses << " misses"
+        << std::format(" ({:.1f}% hit rate)\n", lookups ? 100.0 * stats.hits / lookups : 0.0);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// directory of compiler outputs named by SHA-256 of the executable, flags and source
+// entries are written to a temporary file and renamed, so readers never see a partial entry,
+// the least recently used entries are removed when the directory grows above its capacity
+// hits and misses are counted in a stats file shared by all processes using the directory
+class CompileCache
+{
+public:
+    // directory is created if it doesn't exist, throws InterpretError if it can't be
+    CompileCache(std::string dir, std::uint64_t capacity = DEFAULT_CAPACITY);
+    ~CompileCache() {}
+
+    CompileCache(const CompileCache&)            = delete;
+    CompileCache(CompileCache&&)                 = delete;
+    CompileCache& operator=(const CompileCache&) = delete;
+    CompileCache& operator=(CompileCache&&)      = delete;
+
+    // key of source compiled with flags by this executable
+    static std::string key(std::string_view source, std::string_view flags);
+
+    // copies entry to file at output or to stdout if output is nullptr, returns false on a miss
+    // throws InterpretError if the output can't be written
+    bool load(const std::string& key, const char* output);
+
+    // errors are ignored, the output is just not cached, nor is output larger than capacity
+    void store(const std::string& key, std::string_view output);
+
+    // hits, misses, entries and their size
+    void printStats(std::ostream& out);
+
+    static constexpr std::uint64_t DEFAULT_CAPACITY = 256 << 20;
+
+private:
+    struct Stats
+    {
+        std::uint64_t hits   = 0;
+        std::uint64_t misses = 0;
+    };
+
+    // adds to the counters in the stats file under an exclusive lock
+    Stats count(std::uint64_t hits, std::uint64_t misses);
+
+    // removes least recently used entries until the rest fits into capacity
+    void evict();
+
+    std::string entryPath(const std::string& key) const { return m_dir + '/' + key; }
+
+private:
+    std::string   m_dir;
+    std::uint64_t m_capacity;
+};
@@ -0,0 +1,300 @@
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include "CompileServer.h"
+
+using Clock = std::chrono::steady_clock;
+
+// address of the socket at path, throws InterpretError if the path doesn't fit
+static sockaddr_un socketAddress(const std::string& path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family  = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw InterpretError("socket path is too long: " + path);
+    }
+    std::copy(path.begin(), path.end(), addr.sun_path);
+
+    return addr;
+}
+
+CompileServer::CompileServer(std::string path, std::size_t threads) : m_path(std::move(path)), m_threads(threads)
+{
+    if (m_threads == 0) {
+        m_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+CompileServer::~CompileServer()
+{
+    if (m_listen >= 0) {
+        close(m_listen);
+        unlink(m_path.c_str());
+    }
+}
+
+void CompileServer::run()
+{
+    sockaddr_un addr = socketAddress(m_path);
+
+    m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listen < 0) {
+        throw InterpretError(std::format("can't create socket: {}", std::strerror(errno)));
+    }
+
+    unlink(m_path.c_str());
+
+    if (bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(m_listen, SOMAXCONN) < 0) {
+        throw InterpretError(std::format("can't listen on {}: {}", m_path, std::strerror(errno)));
+    }
+
+    // every worker accepts its own connections, there is no queue between threads
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < m_threads; i++) {
+        workers.emplace_back(&CompileServer::serve, this);
+    }
+    int error = serve();
+
+    // the socket is broken for all of them
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    throw InterpretError(std::format("accept failed: {}", std::strerror(error)));
+}
+
+int CompileServer::serve()
+{
+    Worker worker;
+
+    while (true) {
+        int fd = accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // out of descriptors or memory, connections are accepted again when clients finish
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            return errno;
+        }
+
+        handle(fd, worker);
+        close(fd);
+    }
+}
+
+void CompileServer::handle(int fd, Worker& worker)
+{
+    RequestHeader request;
+
+    while (readAll(fd, &request, sizeof(request))) {
+        bool ok = false;
+
+        if (request.size > MAX_SOURCE) {
+            worker.diagnostics = std::format("Request error: source of {} bytes is too large\n", request.size);
+        }
+        else if (request.simd > static_cast<std::uint32_t>(SimdLevel::AVX2)) {
+            worker.diagnostics = std::format("Request error: unknown SIMD level {}\n", request.simd);
+        }
+        else {
+            worker.source.resize(request.size);
+            if (!readAll(fd, worker.source.data(), request.size)) {
+                return;
+            }
+            ok = worker.context.compile(worker.source, {static_cast<SimdLevel>(request.simd)});
+
+            worker.diagnostics.clear();
+            for (const Diagnostic& d : worker.context.diagnostics()) {
+                CompilerContext::render(d, worker.diagnostics);
+            }
+        }
+
+        std::string_view text = ok ? worker.context.output() : std::string_view(worker.diagnostics);
+        ReplyHeader      reply{ok, static_cast<std::uint32_t>(text.size())};
+
+        if (!writeAll(fd, &reply, sizeof(reply)) || !writeAll(fd, text.data(), text.size()) || request.size > MAX_SOURCE) {
+            return;
+        }
+    }
+}
+
+bool CompileServer::request(const std::string& path, std::string_view source, SimdLevel simd, std::string& reply)
+{
+    sockaddr_un addr = socketAddress(path);
+
+    if (source.size() > MAX_SOURCE) {
+        throw InterpretError(std::format("source of {} bytes is too large", source.size()));
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw InterpretError(std::format("can't create socket: {}", std::strerror(errno)));
+    }
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        int error = errno;
+        close(fd);
+        throw InterpretError(std::format("can't connect to {}: {}", path, std::strerror(error)));
+    }
+
+    RequestHeader request{static_cast<std::uint32_t>(simd), static_cast<std::uint32_t>(source.size())};
+    ReplyHeader   header;
+
+    bool done = writeAll(fd, &request, sizeof(request)) && writeAll(fd, source.data(), source.size()) &&
+                readAll(fd, &header, sizeof(header));
+
+    if (done) {
+        reply.resize(header.size);
+        done = readAll(fd, reply.data(), header.size);
+    }
+    close(fd);
+
+    if (!done) {
+        throw InterpretError("server closed the connection");
+    }
+    return header.ok;
+}
+
+void CompileServer::benchmark(const std::string& path, const char* filename, SimdLevel simd, std::size_t runs, std::ostream& out)
+{
+    std::ifstream ifile(filename);
+    if (!ifile.is_open()) {
+        throw InterpretError(std::format("can't open {}", filename));
+    }
+    std::string source((std::istreambuf_iterator<char>(ifile)), std::istreambuf_iterator<char>());
+
+    std::vector<std::string> flags;
+    if (simd == SimdLevel::NONE) {
+        flags.push_back("--no-vectorize");
+    }
+    else if (simd == SimdLevel::AVX2) {
+        flags.push_back("--avx2");
+    }
+    flags.push_back(filename);
+
+    // every compilation writes its assembly to /dev/null, as the server's reply is dropped
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // runs this executable with args before flags and waits for it
+    auto spawn = [&](std::vector<std::string> args)
+    {
+        args.insert(args.begin(), "/proc/self/exe");
+        args.insert(args.end(), flags.begin(), flags.end());
+
+        std::vector<char*> argv;
+        for (std::string& a : args) {
+            argv.push_back(a.data());
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int   status;
+
+        if (posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) != 0 || waitpid(pid, &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            throw InterpretError(std::format("{} {} failed", argv[0], argv[1]));
+        }
+    };
+
+    std::string reply;
+    auto        measure = [runs](auto&& fn)
+    {
+        std::vector<double> times;
+
+        fn(); // warm up
+        for (std::size_t r = 0; r < runs; r++) {
+            Clock::time_point start = Clock::now();
+            fn();
+            times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        std::ranges::sort(times);
+
+        return times;
+    };
+
+    std::pair<const char*, std::vector<double>> modes[] = {
+        {"server",    measure([&] { request(path, source, simd, reply); })},
+        {"client",    measure([&] { spawn({"--client", path}); })     },
+        {"fork_exec", measure([&] { spawn({"-S"}); })                 },
+    };
+
+    posix_spawn_file_actions_destroy(&actions);
+
+    out << std::fixed << std::setprecision(3) << "{\n  \"file\": \"" << filename << "\",\n  \"bytes\": " << source.size()
+        << ",\n  \"runs\": " << runs << ",\n  \"modes\": {\n";
+
+    for (std::size_t i = 0; i < std::size(modes); i++) {
+        const auto& [name, times] = modes[i];
+
+        double mean = 0.0;
+        for (double t : times) {
+            mean += t / times.size();
+        }
+
+        out << "    \"" << name << "\": {\"best_ms\": " << times.front() * 1e3 << ", \"mean_ms\": " << mean * 1e3
+            << ", \"p50_ms\": " << times[times.size() / 2] * 1e3 << ", \"p99_ms\": " << times[times.size() * 99 / 100] * 1e3
+            << '}' << (i + 1 == std::size(modes) ? "\n" : ",\n");
+    }
+
+    out << "  }\n}\n";
+}
+
+bool CompileServer::readAll(int fd, void* data, std::size_t size)
+{
+    char* p = static_cast<char*>(data);
+
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool CompileServer::writeAll(int fd, const void* data, std::size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+
+    while (size > 0) {
+        // a client that went away must not kill the server with SIGPIPE
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "CompilerContext.h"
+#include "Interpreter.h"
+
+// compiles sources sent over a Unix domain socket to NASM assembly, keeps running between compilations
+// so the process, its heap and the buffers of workers stay warm
+//
+// a connection carries any number of requests, each answered before the next is read:
+//     request: RequestHeader, source
+//     reply:   ReplyHeader, assembly or diagnostics
+class CompileServer
+{
+public:
+    // stale socket file at path is replaced, threads == 0 uses one worker per CPU
+    CompileServer(std::string path, std::size_t threads = 0);
+    // removes the socket file
+    ~CompileServer();
+
+    CompileServer(const CompileServer&)            = delete;
+    CompileServer(CompileServer&&)                 = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+    CompileServer& operator=(CompileServer&&)      = delete;
+
+    // binds the socket and serves connections on worker threads, doesn't return unless it fails
+    // throws InterpretError when the socket can't be set up
+    void run();
+
+    // sends source to the server at path, reply is assembly or diagnostics
+    // returns true if it is assembly, throws InterpretError when the server can't be reached
+    static bool request(const std::string& path, std::string_view source, SimdLevel simd, std::string& reply);
+
+    // round trip time of requests to the server against running this executable with -S, JSON to out
+    static void benchmark(const std::string& path, const char* filename, SimdLevel simd, std::size_t runs, std::ostream& out);
+
+    struct RequestHeader
+    {
+        std::uint32_t simd;
+        std::uint32_t size; // of source
+    };
+
+    struct ReplyHeader
+    {
+        std::uint32_t ok;   // 1 for assembly, 0 for diagnostics
+        std::uint32_t size; // of text
+    };
+
+    // larger requests are refused
+    static constexpr std::uint32_t MAX_SOURCE = 64 << 20;
+
+private:
+    // state kept by a worker between requests
+    struct Worker
+    {
+        CompilerContext context;
+        std::string     source;
+        std::string     diagnostics;
+    };
+
+    // accepts connections on the listening socket until it fails, returns errno of the failure
+    int serve();
+
+    // answers requests on the connection until the client closes it
+    void handle(int fd, Worker& worker);
+
+    // false on end of file or error
+    static bool readAll(int fd, void* data, std::size_t size);
+    static bool writeAll(int fd, const void* data, std::size_t size);
+
+private:
+    std::string m_path;
+    std::size_t m_threads;
+    int         m_listen = -1;
+};
@@ -0,0 +1,119 @@
+#include "CompilerContext.h"
+#include "DataLayout.h"
+#include "ElfWriter.h"
+#include "FrameAllocator.h"
+#include "LoopAnalyzer.h"
+#include "Profiler.h"
+#include "SemanticAnalyzer.h"
+
+bool CompilerContext::compile(std::string_view source, const CompilerOptions& options)
+{
+    reset();
+    m_output = options.output;
+
+    try {
+        m_sources.clear();
+        m_sources.addView("<input>", source);
+
+        std::list<Token> tokens = m_lexer.tokenize(source);
+        ast::ASTNodePtr  tree   = m_parser.parse(tokens);
+
+        SemanticAnalyzer sa;
+        sa.analyze(tree);
+
+        LoopAnalyzer la;
+        {
+            TimeScope scope("loop analysis");
+            la.analyze(tree);
+        }
+
+        FrameAllocator fa(sa.getSymbolTable());
+        fa.allocate(tree);
+
+        DataLayout dl(sa.getSymbolTable());
+        dl.layout(tree);
+
+        Interpreter         interpreter(std::move(sa.getSymbolTable()), options.simd, false, options.unroll);
+        const x86::Program& program = interpreter.interpret(tree);
+
+        if (m_output == OutputKind::ASSEMBLY) {
+            x86::printNASM(program, m_assembly);
+        }
+        else {
+            ElfWriter writer;
+            writer.write(program, m_object);
+        }
+        return true;
+    } catch (const LexicalError& e) {
+        diagnose(Diagnostic::Kind::LEXICAL, e.getLocation(), e.what());
+    } catch (const SyntaxError& e) {
+        diagnose(Diagnostic::Kind::SYNTAX, e.getLocation(), e.what());
+    } catch (const SemanticError& e) {
+        diagnose(Diagnostic::Kind::SEMANTIC, e.getLocation(), e.what());
+    } catch (const InterpretError& e) {
+        diagnose(Diagnostic::Kind::CODEGEN, {}, e.what());
+    }
+
+    // output of a failed compilation would be incomplete
+    reset();
+    m_diagnosticCount = 1;
+
+    return false;
+}
+
+std::string_view CompilerContext::output() const
+{
+    return m_output == OutputKind::ASSEMBLY ? m_assembly.view() : m_object.view();
+}
+
+void CompilerContext::reset()
+{
+    m_assembly.clear();
+
+    // the string is moved out and back to keep its capacity
+    std::string object = std::move(m_object).str();
+    object.clear();
+    m_object.str(std::move(object));
+
+    m_diagnosticCount = 0;
+}
+
+void CompilerContext::render(const Diagnostic& diagnostic, std::string& out)
+{
+    static constexpr std::string_view kinds[] = {
+        "Lexical error: ",
+        "Syntax error: ",
+        "Semantic error: ",
+        "Code generation error: ",
+    };
+
+    out.append(kinds[static_cast<std::size_t>(diagnostic.kind)]);
+    out.append(diagnostic.message);
+    out.push_back('\n');
+
+    // code generation errors have no location
+    if (diagnostic.kind == Diagnostic::Kind::CODEGEN) {
+        return;
+    }
+
+    out.append(diagnostic.sourceLine);
+    out.push_back('\n');
+    out.append(diagnostic.column ? diagnostic.column - 1 : 0, ' ');
+    out.append("^\n");
+}
+
+void CompilerContext::diagnose(Diagnostic::Kind kind, const Location& loc, std::string_view message)
+{
+    if (m_diagnostics.empty()) {
+        m_diagnostics.emplace_back();
+    }
+
+    SourceManager::Position pos = m_sources.decode(loc);
+
+    Diagnostic& d = m_diagnostics.front();
+    d.kind        = kind;
+    d.line        = pos.line;
+    d.column      = pos.column;
+    d.message.assign(message);
+    d.sourceLine.assign(pos.lineText);
+}
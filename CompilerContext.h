@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AsmWriter.h"
+#include "Common.h"
+#include "Interpreter.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "SourceManager.h"
+
+enum class OutputKind : std::uint8_t
+{
+    ASSEMBLY, // NASM text
+    OBJECT,   // ELF64 relocatable object
+};
+
+struct CompilerOptions
+{
+    SimdLevel   simd   = SimdLevel::SSE;
+    OutputKind  output = OutputKind::ASSEMBLY;
+    std::size_t unroll = Interpreter::DEFAULT_UNROLL;
+};
+
+struct Diagnostic
+{
+    enum class Kind : std::uint8_t
+    {
+        LEXICAL,
+        SYNTAX,
+        SEMANTIC,
+        CODEGEN,
+    };
+
+    Kind          kind;
+    std::uint32_t line   = 0; // from 1, 0 if there is no location
+    std::uint32_t column = 0; // from 1
+    std::string   message;
+    std::string   sourceLine;
+};
+
+// compiles sources to assembly or object files without doing any I/O
+// a context is used by one thread at a time, contexts on different threads don't share state
+// output and diagnostics stay valid until the next compilation, their buffers are reused by it
+class CompilerContext
+{
+public:
+    CompilerContext() {}
+    ~CompilerContext() {}
+
+    CompilerContext(const CompilerContext&)            = delete;
+    CompilerContext(CompilerContext&&)                 = delete;
+    CompilerContext& operator=(const CompilerContext&) = delete;
+    CompilerContext& operator=(CompilerContext&&)      = delete;
+
+    // replaces output and diagnostics of the previous compilation, returns true on success
+    bool compile(std::string_view source, const CompilerOptions& options = {});
+
+    // of the last successful compilation, empty after a failed one
+    std::string_view output() const;
+
+    std::span<const Diagnostic> diagnostics() const { return {m_diagnostics.data(), m_diagnosticCount}; }
+
+    // drops output and diagnostics, buffers keep their capacity
+    void reset();
+
+    // appends diagnostic as the command line driver prints it: kind, message, line and caret
+    static void render(const Diagnostic& diagnostic, std::string& out);
+
+private:
+    void diagnose(Diagnostic::Kind kind, const Location& loc, std::string_view message);
+
+private:
+    Lexer         m_lexer;
+    Parser        m_parser;
+    SourceManager m_sources; // source of the current compilation
+
+    OutputKind         m_output = OutputKind::ASSEMBLY;
+    AsmWriter          m_assembly; // in memory
+    std::ostringstream m_object;
+
+    std::vector<Diagnostic> m_diagnostics;
+    std::size_t             m_diagnosticCount = 0; // in use, the others keep their strings for reuse
+};
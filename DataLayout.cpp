@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <variant>
+
+#include "DataLayout.h"
+#include "Profiler.h"
+
+void DataLayout::layout(const ast::ASTNodePtr& ast)
+{
+    TimeScope scope("data layout");
+
+    m_loopCount = 0;
+    m_loops.clear();
+    m_groups.clear();
+
+    collect(ast);
+    layoutGlobals();
+}
+
+void DataLayout::layoutGlobals()
+{
+    GlobalSection& data = m_symbolTable.getData();
+    GlobalSection& bss  = m_symbolTable.getBss();
+
+    data = {};
+    bss  = {};
+
+    // compile-time values are stored in .data, the others are set by code
+    for (const auto& [name, sym] : *m_symbolTable[0]) {
+        GlobalSection& section = SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_COMPILETIME) ? data : bss;
+        section.symbols.emplace_back(name, sym);
+    }
+
+    // decreasing alignment leaves no padding, globals of one loop are adjacent among those
+    // of equal alignment, globals outside loops go last, names make the order independent of hashing
+    auto key = [this](const std::pair<std::string, std::shared_ptr<Symbol>>& e)
+    {
+        auto        it    = m_groups.find(e.second.get());
+        std::size_t group = it != m_groups.end() ? it->second : std::numeric_limits<std::size_t>::max();
+
+        return std::make_tuple(-static_cast<std::int64_t>(e.second->align), group,
+                               -static_cast<std::int64_t>(e.second->size), std::cref(e.first));
+    };
+
+    for (GlobalSection* section : {&data, &bss}) {
+        std::ranges::sort(section->symbols, {}, key);
+        place(*section);
+    }
+}
+
+void DataLayout::collect(const ast::ASTNodePtr& node)
+{
+    bool loop = std::holds_alternative<ast::WhileLoop>(node->getData());
+
+    if (loop) {
+        m_loops.push_back(m_loopCount++);
+    }
+
+    const ast::Identifier* id = std::get_if<ast::Identifier>(&node->getData());
+
+    if (id && id->getSymbol() && SYMBOL_GET_FLAG((*id->getSymbol()), SYMBOL_FLAG_GLOBAL) && !m_loops.empty()) {
+        m_groups.try_emplace(id->getSymbol().get(), m_loops.back());
+    }
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        collect(c);
+    }
+
+    if (loop) {
+        m_loops.pop_back();
+    }
+}
+
+void DataLayout::place(GlobalSection& section)
+{
+    // gaps left by alignment are filled by later globals with smaller alignment
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> gaps;
+    std::uint32_t                                        used = 0;
+
+    for (const auto& [name, sym] : section.symbols) {
+        auto fits = [&sym](const std::pair<std::uint32_t, std::uint32_t>& gap)
+        { return alignTo(gap.first, sym->align) + sym->size <= gap.second; };
+
+        if (auto gap = std::ranges::find_if(gaps, fits); gap != gaps.end()) {
+            sym->offset = alignTo(gap->first, sym->align);
+            gap->first  = sym->offset + sym->size;
+        }
+        else {
+            sym->offset = alignTo(section.size, sym->align);
+            if (sym->offset > section.size) {
+                gaps.emplace_back(section.size, sym->offset);
+            }
+            section.size = sym->offset + sym->size;
+        }
+        used += sym->size;
+    }
+
+    // variables are emitted in memory order
+    std::ranges::stable_sort(section.symbols, {}, [](const auto& e) { return e.second->offset; });
+
+    section.padding = section.size - used;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "AST.h"
+#include "SymbolTable.h"
+
+// works with AST, that was checked by the semantic analyzer
+// orders global variables in .data and .bss by decreasing alignment and size,
+// globals of equal alignment used by the same loop are placed together
+// and gaps left by alignment are filled with smaller globals
+class DataLayout
+{
+public:
+    DataLayout(SymbolTable& st) : m_symbolTable(st) {}
+    ~DataLayout() {}
+
+    DataLayout(const DataLayout&)            = delete;
+    DataLayout(DataLayout&&)                 = delete;
+    DataLayout& operator=(const DataLayout&) = delete;
+    DataLayout& operator=(DataLayout&&)      = delete;
+
+    // sets section offsets of globals and sections of the symbol table
+    void layout(const ast::ASTNodePtr& ast);
+
+    // streaming: loops of each top-level statement are recorded while its AST exists,
+    // globals are laid out after the last one
+    void record(const ast::ASTNodePtr& statement) { collect(statement); }
+    void layoutGlobals();
+
+private:
+    // finds the first loop which uses each global
+    void collect(const ast::ASTNodePtr& node);
+
+    // assigns offsets in given order, sorts symbols by offset
+    void place(GlobalSection& section);
+
+private:
+    SymbolTable& m_symbolTable;
+
+    std::size_t                                    m_loopCount = 0;
+    std::vector<std::size_t>                       m_loops;  // enclosing loops, innermost last
+    std::unordered_map<const Symbol*, std::size_t> m_groups; // global -> first loop using it
+};
@@ -0,0 +1,407 @@
+#include <elf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+#include "Common.h"
+#include "ElfWriter.h"
+#include "Profiler.h"
+
+// section header indices
+enum : std::uint16_t
+{
+    SECTION_TEXT = 1,
+    SECTION_DATA,
+    SECTION_BSS,
+    SECTION_RODATA,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_NUM,
+
+    // sections of line info follow if the program has it
+    SECTION_DEBUG_ABBREV = SECTION_NUM,
+    SECTION_DEBUG_INFO,
+    SECTION_RELA_DEBUG_INFO,
+    SECTION_DEBUG_LINE,
+    SECTION_RELA_DEBUG_LINE,
+};
+
+// DWARF 4 constants of a compile unit with a line program
+enum : std::uint8_t
+{
+    DW_TAG_compile_unit = 0x11,
+    DW_CHILDREN_no      = 0x00,
+    DW_AT_name          = 0x03,
+    DW_AT_stmt_list     = 0x10,
+    DW_AT_low_pc        = 0x11,
+    DW_AT_high_pc       = 0x12,
+    DW_FORM_addr        = 0x01,
+    DW_FORM_data8       = 0x07,
+    DW_FORM_string      = 0x08,
+    DW_FORM_sec_offset  = 0x17,
+    DW_LNS_copy         = 0x01,
+    DW_LNS_advance_pc   = 0x02,
+    DW_LNS_advance_line = 0x03,
+    DW_LNE_end_sequence = 0x01,
+    DW_LNE_set_address  = 0x02,
+};
+
+// rows whose line and address advance fit a special opcode take one byte
+static constexpr std::int64_t LINE_BASE   = -5;
+static constexpr std::int64_t LINE_RANGE  = 14;
+static constexpr std::int64_t OPCODE_BASE = 13;
+
+template <typename T>
+static void append(std::vector<std::uint8_t>& bytes, const T& value)
+{
+    const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+static void appendULEB(std::vector<std::uint8_t>& bytes, std::uint64_t value)
+{
+    do {
+        std::uint8_t byte = value & 0x7F;
+        value >>= 7;
+        bytes.push_back(value ? byte | 0x80 : byte);
+    } while (value);
+}
+
+static void appendSLEB(std::vector<std::uint8_t>& bytes, std::int64_t value)
+{
+    bool more = true;
+    while (more) {
+        std::uint8_t byte = value & 0x7F;
+        value >>= 7;
+        more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+        bytes.push_back(more ? byte | 0x80 : byte);
+    }
+}
+
+static void appendString(std::vector<std::uint8_t>& bytes, const std::string& s)
+{
+    bytes.insert(bytes.end(), s.begin(), s.end());
+    bytes.push_back(0);
+}
+
+// field of a debug section resolved against a section symbol
+static void appendRelocation(std::vector<std::uint8_t>& rela, std::uint64_t offset, std::uint32_t symbol, std::uint32_t type)
+{
+    Elf64_Rela entry;
+    entry.r_offset = offset;
+    entry.r_info   = ELF64_R_INFO(symbol, type);
+    entry.r_addend = 0;
+    append(rela, entry);
+}
+
+void ElfWriter::write(const x86::Program& program, std::ostream& out)
+{
+    TimeScope scope("emit elf");
+
+    Encoder encoder;
+    encoder.encode(program.text);
+
+    // without null section
+    m_sections = {
+        {".text",      SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16                                                  },
+        {".data",      SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,     1                                                   },
+        {".bss",       SHT_NOBITS,   SHF_ALLOC | SHF_WRITE,     1                                                   },
+        {".rodata",    SHT_PROGBITS, SHF_ALLOC,                 1                                                   },
+        {".rela.text", SHT_RELA,     SHF_INFO_LINK,             8, SECTION_SYMTAB, SECTION_TEXT, sizeof(Elf64_Rela)},
+        {".symtab",    SHT_SYMTAB,   0,                         8, SECTION_STRTAB, 0,            sizeof(Elf64_Sym) },
+        {".strtab",    SHT_STRTAB,   0,                         1                                                   },
+        {".shstrtab",  SHT_STRTAB,   0,                         1                                                   },
+    };
+
+    m_symtab.clear();
+    m_strtab = {0};
+    m_symbols.clear();
+    m_symbolCount = 0;
+
+    // null symbol
+    addSymbol("", SHN_UNDEF, 0, 0, false);
+
+    layoutVariables(program.data, SECTION_DATA, false);
+    layoutVariables(program.bss, SECTION_BSS, true);
+    layoutVariables(program.rodata, SECTION_RODATA, false);
+
+    Section& text = m_sections[SECTION_TEXT - 1];
+    text.bytes    = encoder.getCode();
+    text.size     = text.bytes.size();
+
+    if (!program.source.empty()) {
+        addLineInfo(program, encoder);
+    }
+
+    // local symbols go first, info is the index of the first global one
+    m_sections[SECTION_SYMTAB - 1].info = m_symbolCount;
+    addSymbol(program.entry, SECTION_TEXT, 0, text.size, true);
+
+    Section& rela = m_sections[SECTION_RELA_TEXT - 1];
+    for (const Relocation& r : encoder.getRelocations()) {
+        if (!m_symbols.contains(r.symbol)) {
+            throw InterpretError(std::format("undefined symbol {}", r.symbol));
+        }
+
+        Elf64_Rela entry;
+        entry.r_offset = r.offset;
+        entry.r_info   = ELF64_R_INFO(m_symbols[r.symbol], R_X86_64_PC32);
+        entry.r_addend = r.addend;
+        append(rela.bytes, entry);
+    }
+
+    m_sections[SECTION_SYMTAB - 1].bytes = m_symtab;
+    m_sections[SECTION_STRTAB - 1].bytes = m_strtab;
+
+    std::vector<std::uint8_t>  shstrtab = {0};
+    std::vector<std::uint32_t> names;
+    for (const Section& s : m_sections) {
+        names.push_back(addString(shstrtab, s.name));
+    }
+    m_sections[SECTION_SHSTRTAB - 1].bytes = shstrtab;
+
+    // elf header, section contents, section headers
+    std::vector<std::uint8_t>  file(sizeof(Elf64_Ehdr));
+    std::vector<std::uint64_t> offsets;
+
+    for (Section& s : m_sections) {
+        if (s.type != SHT_NOBITS) {
+            s.size = s.bytes.size();
+            file.resize(alignTo(file.size(), s.align));
+        }
+        offsets.push_back(file.size());
+        file.insert(file.end(), s.bytes.begin(), s.bytes.end());
+    }
+    file.resize(alignTo(file.size(), 8));
+
+    Elf64_Ehdr header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS]   = ELFCLASS64;
+    header.e_ident[EI_DATA]    = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI]   = ELFOSABI_SYSV;
+    header.e_type              = ET_REL;
+    header.e_machine           = EM_X86_64;
+    header.e_version           = EV_CURRENT;
+    header.e_shoff             = file.size();
+    header.e_ehsize            = sizeof(Elf64_Ehdr);
+    header.e_shentsize         = sizeof(Elf64_Shdr);
+    header.e_shnum             = m_sections.size() + 1;
+    header.e_shstrndx          = SECTION_SHSTRTAB;
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    Elf64_Shdr null;
+    std::memset(&null, 0, sizeof(null));
+    append(file, null);
+
+    for (std::size_t i = 0; i < m_sections.size(); i++) {
+        const Section& s = m_sections[i];
+
+        Elf64_Shdr sh;
+        sh.sh_name      = names[i];
+        sh.sh_type      = s.type;
+        sh.sh_flags     = s.flags;
+        sh.sh_addr      = 0;
+        sh.sh_offset    = offsets[i];
+        sh.sh_size      = s.size;
+        sh.sh_link      = s.link;
+        sh.sh_info      = s.info;
+        sh.sh_addralign = s.align;
+        sh.sh_entsize   = s.entsize;
+        append(file, sh);
+    }
+
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+void ElfWriter::addLineInfo(const x86::Program& program, const Encoder& encoder)
+{
+    m_sections.push_back({".debug_abbrev", SHT_PROGBITS, 0, 1});
+    m_sections.push_back({".debug_info", SHT_PROGBITS, 0, 1});
+    m_sections.push_back(
+        {".rela.debug_info", SHT_RELA, SHF_INFO_LINK, 8, SECTION_SYMTAB, SECTION_DEBUG_INFO, sizeof(Elf64_Rela)});
+    m_sections.push_back({".debug_line", SHT_PROGBITS, 0, 1});
+    m_sections.push_back(
+        {".rela.debug_line", SHT_RELA, SHF_INFO_LINK, 8, SECTION_SYMTAB, SECTION_DEBUG_LINE, sizeof(Elf64_Rela)});
+
+    // offsets into sections are relocated, the linker concatenates sections of all objects
+    std::uint32_t textSymbol   = addSectionSymbol(SECTION_TEXT);
+    std::uint32_t abbrevSymbol = addSectionSymbol(SECTION_DEBUG_ABBREV);
+    std::uint32_t lineSymbol   = addSectionSymbol(SECTION_DEBUG_LINE);
+    std::uint64_t textSize     = encoder.getOffset(program.text.size());
+
+    // compile unit without children: source name as given to the compiler, line program and code range
+    m_sections[SECTION_DEBUG_ABBREV - 1].bytes = {1,
+                                                  DW_TAG_compile_unit,
+                                                  DW_CHILDREN_no,
+                                                  DW_AT_name,
+                                                  DW_FORM_string,
+                                                  DW_AT_stmt_list,
+                                                  DW_FORM_sec_offset,
+                                                  DW_AT_low_pc,
+                                                  DW_FORM_addr,
+                                                  DW_AT_high_pc,
+                                                  DW_FORM_data8,
+                                                  0,
+                                                  0,
+                                                  0};
+
+    std::vector<std::uint8_t>& info     = m_sections[SECTION_DEBUG_INFO - 1].bytes;
+    std::vector<std::uint8_t>& infoRela = m_sections[SECTION_RELA_DEBUG_INFO - 1].bytes;
+
+    append<std::uint32_t>(info, 0); // unit length
+    append<std::uint16_t>(info, 4); // version
+    appendRelocation(infoRela, info.size(), abbrevSymbol, R_X86_64_32);
+    append<std::uint32_t>(info, 0);
+    info.push_back(8); // address size
+    info.push_back(1); // abbreviation code
+    appendString(info, program.source);
+    appendRelocation(infoRela, info.size(), lineSymbol, R_X86_64_32);
+    append<std::uint32_t>(info, 0);
+    appendRelocation(infoRela, info.size(), textSymbol, R_X86_64_64);
+    append<std::uint64_t>(info, 0);
+    append<std::uint64_t>(info, textSize); // high pc is the size with data form
+
+    std::uint32_t infoLength = info.size() - 4;
+    std::memcpy(info.data(), &infoLength, 4);
+
+    std::vector<std::uint8_t>& line     = m_sections[SECTION_DEBUG_LINE - 1].bytes;
+    std::vector<std::uint8_t>& lineRela = m_sections[SECTION_RELA_DEBUG_LINE - 1].bytes;
+
+    append<std::uint32_t>(line, 0); // unit length
+    append<std::uint16_t>(line, 4); // version
+    append<std::uint32_t>(line, 0); // header length
+
+    // instruction length, operations per instruction, is_stmt, line base, line range, opcode base
+    line.insert(line.end(), {1, 1, 1, static_cast<std::uint8_t>(LINE_BASE), LINE_RANGE, OPCODE_BASE});
+    // operands of standard opcodes
+    line.insert(line.end(), {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1});
+    // no include directories, one file in the compilation directory
+    line.push_back(0);
+    appendString(line, program.source);
+    line.insert(line.end(), {0, 0, 0, 0});
+
+    std::uint32_t headerLength = line.size() - 10;
+    std::memcpy(line.data() + 6, &headerLength, 4);
+
+    line.insert(line.end(), {0, 9, DW_LNE_set_address});
+    appendRelocation(lineRela, line.size(), textSymbol, R_X86_64_64);
+    append<std::uint64_t>(line, 0);
+
+    // a row starts where the line of instructions changes, labels take no code
+    std::uint64_t address = 0;
+    std::int64_t  row     = 1;
+    bool          first   = true;
+
+    for (std::size_t i = 0; i < program.text.size(); i++) {
+        std::uint64_t offset = encoder.getOffset(i);
+
+        if (offset == encoder.getOffset(i + 1) || (!first && program.text[i].line == row)) {
+            continue;
+        }
+
+        std::int64_t  lineDelta    = static_cast<std::int64_t>(program.text[i].line) - row;
+        std::uint64_t addressDelta = offset - address;
+        std::int64_t  special      = lineDelta - LINE_BASE + LINE_RANGE * static_cast<std::int64_t>(addressDelta) + OPCODE_BASE;
+
+        if (lineDelta >= LINE_BASE && lineDelta < LINE_BASE + LINE_RANGE && special <= 255) {
+            line.push_back(special);
+        }
+        else {
+            if (lineDelta) {
+                line.push_back(DW_LNS_advance_line);
+                appendSLEB(line, lineDelta);
+            }
+            if (addressDelta) {
+                line.push_back(DW_LNS_advance_pc);
+                appendULEB(line, addressDelta);
+            }
+            line.push_back(DW_LNS_copy);
+        }
+
+        row     = program.text[i].line;
+        address = offset;
+        first   = false;
+    }
+
+    // the sequence ends after the code
+    if (textSize > address) {
+        line.push_back(DW_LNS_advance_pc);
+        appendULEB(line, textSize - address);
+    }
+    line.insert(line.end(), {0, 1, DW_LNE_end_sequence});
+
+    std::uint32_t lineLength = line.size() - 4;
+    std::memcpy(line.data(), &lineLength, 4);
+}
+
+void ElfWriter::layoutVariables(const std::vector<x86::Variable>& vars, std::uint16_t index, bool reserve)
+{
+    Section&      s      = m_sections[index - 1];
+    std::uint64_t offset = s.size;
+
+    for (const x86::Variable& v : vars) {
+        std::uint64_t size = v.unit * v.count;
+
+        offset  = alignTo(offset, v.align);
+        s.align = std::max<std::uint64_t>(s.align, v.align);
+
+        addSymbol(v.name, index, offset, size, false);
+
+        if (!reserve) {
+            s.bytes.resize(offset);
+            for (std::uint32_t i = 0; i < v.count; i++) {
+                for (std::uint32_t b = 0; b < v.unit; b++) {
+                    s.bytes.push_back(static_cast<std::uint8_t>(v.value >> (8 * b)));
+                }
+            }
+        }
+
+        offset += size;
+    }
+
+    s.size = offset;
+}
+
+void ElfWriter::addSymbol(const std::string& name,
+                          std::uint16_t      section,
+                          std::uint64_t      value,
+                          std::uint64_t      size,
+                          bool               global)
+{
+    Elf64_Sym sym;
+    sym.st_name  = name.empty() ? 0 : addString(m_strtab, name);
+    sym.st_info  = name.empty() ? 0 : ELF64_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, global ? STT_NOTYPE : STT_OBJECT);
+    sym.st_other = STV_DEFAULT;
+    sym.st_shndx = section;
+    sym.st_value = value;
+    sym.st_size  = size;
+    append(m_symtab, sym);
+
+    m_symbols[name] = m_symbolCount++;
+}
+
+std::uint32_t ElfWriter::addSectionSymbol(std::uint16_t section)
+{
+    Elf64_Sym sym;
+    std::memset(&sym, 0, sizeof(sym));
+    sym.st_info  = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    sym.st_shndx = section;
+    append(m_symtab, sym);
+
+    return m_symbolCount++;
+}
+
+std::uint32_t ElfWriter::addString(std::vector<std::uint8_t>& table, const std::string& s)
+{
+    std::uint32_t offset = table.size();
+
+    table.insert(table.end(), s.begin(), s.end());
+    table.push_back(0);
+
+    return offset;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Assembly.h"
+#include "Encoder.h"
+
+// writes program as ELF64 relocatable object for x86-64 Linux
+// sections: .text, .data, .bss, .rodata, .rela.text and symbol table,
+// DWARF 4 line info in .debug_* sections if the program has lines of instructions
+class ElfWriter
+{
+public:
+    ElfWriter() {}
+    ~ElfWriter() {}
+
+    ElfWriter(const ElfWriter&)            = delete;
+    ElfWriter(ElfWriter&&)                 = delete;
+    ElfWriter& operator=(const ElfWriter&) = delete;
+    ElfWriter& operator=(ElfWriter&&)      = delete;
+
+    void write(const x86::Program& program, std::ostream& out);
+
+private:
+    struct Section
+    {
+        std::string               name;
+        std::uint32_t             type;
+        std::uint64_t             flags;
+        std::uint64_t             align   = 1;
+        std::uint32_t             link    = 0;
+        std::uint32_t             info    = 0;
+        std::uint64_t             entsize = 0;
+        std::uint64_t             size    = 0; // for .bss, contents are empty
+        std::vector<std::uint8_t> bytes   = {};
+    };
+
+    // lays out variables in section, symbols are added for each of them
+    void layoutVariables(const std::vector<x86::Variable>& vars, std::uint16_t index, bool reserve);
+
+    // compile unit and line program mapping addresses of instructions to source lines
+    void addLineInfo(const x86::Program& program, const Encoder& encoder);
+
+    void addSymbol(const std::string& name, std::uint16_t section, std::uint64_t value, std::uint64_t size, bool global);
+    // local symbol of a section, debug sections refer to sections by them; returns its index
+    std::uint32_t addSectionSymbol(std::uint16_t section);
+
+    std::uint32_t addString(std::vector<std::uint8_t>& table, const std::string& s);
+
+private:
+    std::vector<Section>                           m_sections;
+    std::vector<std::uint8_t>                      m_symtab;
+    std::vector<std::uint8_t>                      m_strtab;
+    std::unordered_map<std::string, std::uint32_t> m_symbols; // name -> index in symtab
+    std::uint32_t                                  m_symbolCount = 0;
+};
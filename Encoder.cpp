@@ -0,0 +1,585 @@
+#include <format>
+
+#include "Common.h"
+#include "Encoder.h"
+#include "Profiler.h"
+
+static bool fitsInt8(std::int64_t value)
+{
+    return value >= -128 && value <= 127;
+}
+
+// appends value as n little-endian bytes
+static void put(std::vector<std::uint8_t>& bytes, std::int64_t value, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        bytes.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+static const x86::Register* regOf(const x86::Operand& op)
+{
+    return std::get_if<x86::Register>(&op);
+}
+
+static const x86::Memory* memOf(const x86::Operand& op)
+{
+    return std::get_if<x86::Memory>(&op);
+}
+
+static const x86::Immediate* immOf(const x86::Operand& op)
+{
+    return std::get_if<x86::Immediate>(&op);
+}
+
+// size of register or memory operand, 0 if unknown
+static std::uint8_t sizeOf(const x86::Operand& op)
+{
+    if (const x86::Register* r = regOf(op)) {
+        return r->size();
+    }
+    if (const x86::Memory* m = memOf(op)) {
+        return m->size;
+    }
+    return 0;
+}
+
+// legacy SSE instruction: mandatory prefix, opcode of xmm <- xmm/mem form, opcode of mem <- xmm form
+struct SSEInfo
+{
+    std::uint8_t              prefix;
+    std::vector<std::uint8_t> load;
+    std::vector<std::uint8_t> store;
+};
+
+// VEX encoded instruction: implied prefix (pp), opcode map, opcodes, three-operand form
+struct VEXInfo
+{
+    std::uint8_t pp;
+    std::uint8_t map;
+    std::uint8_t load;
+    std::uint8_t store;
+    bool         nds;
+};
+
+static const std::unordered_map<x86::Opcode, SSEInfo> SSEOps = {
+    {x86::Opcode::MOVSS,     {0xF3, {0x0F, 0x10}, {0x0F, 0x11}}},
+    {x86::Opcode::MOVD,      {0x66, {0x0F, 0x6E}, {0x0F, 0x7E}}},
+    {x86::Opcode::ADDSS,     {0xF3, {0x0F, 0x58}, {}}          },
+    {x86::Opcode::SUBSS,     {0xF3, {0x0F, 0x5C}, {}}          },
+    {x86::Opcode::MULSS,     {0xF3, {0x0F, 0x59}, {}}          },
+    {x86::Opcode::DIVSS,     {0xF3, {0x0F, 0x5E}, {}}          },
+    {x86::Opcode::UCOMISS,   {0x00, {0x0F, 0x2E}, {}}          },
+    {x86::Opcode::XORPS,     {0x00, {0x0F, 0x57}, {}}          },
+    {x86::Opcode::CVTSI2SS,  {0xF3, {0x0F, 0x2A}, {}}          },
+    {x86::Opcode::CVTTSS2SI, {0xF3, {0x0F, 0x2C}, {}}          },
+    {x86::Opcode::SHUFPS,    {0x00, {0x0F, 0xC6}, {}}          },
+    {x86::Opcode::PSHUFD,    {0x66, {0x0F, 0x70}, {}}          },
+    {x86::Opcode::MOVUPS,    {0x00, {0x0F, 0x10}, {0x0F, 0x11}}},
+    {x86::Opcode::MOVDQU,    {0xF3, {0x0F, 0x6F}, {0x0F, 0x7F}}},
+    {x86::Opcode::ADDPS,     {0x00, {0x0F, 0x58}, {}}          },
+    {x86::Opcode::SUBPS,     {0x00, {0x0F, 0x5C}, {}}          },
+    {x86::Opcode::MULPS,     {0x00, {0x0F, 0x59}, {}}          },
+    {x86::Opcode::DIVPS,     {0x00, {0x0F, 0x5E}, {}}          },
+    {x86::Opcode::PADDD,     {0x66, {0x0F, 0xFE}, {}}          },
+    {x86::Opcode::PSUBD,     {0x66, {0x0F, 0xFA}, {}}          },
+    {x86::Opcode::PMULUDQ,   {0x66, {0x0F, 0xF4}, {}}          },
+    {x86::Opcode::PUNPCKLDQ, {0x66, {0x0F, 0x62}, {}}          },
+};
+
+// pp: 0 - none, 1 - 66, 2 - F3; map: 1 - 0F, 2 - 0F38
+static const std::unordered_map<x86::Opcode, VEXInfo> VEXOps = {
+    {x86::Opcode::VMOVD,        {1, 1, 0x6E, 0x7E, false}},
+    {x86::Opcode::VPBROADCASTD, {1, 2, 0x58, 0x00, false}},
+    {x86::Opcode::VBROADCASTSS, {1, 2, 0x18, 0x00, false}},
+    {x86::Opcode::VMOVUPS,      {0, 1, 0x10, 0x11, false}},
+    {x86::Opcode::VMOVDQU,      {2, 1, 0x6F, 0x7F, false}},
+    {x86::Opcode::VADDPS,       {0, 1, 0x58, 0x00, true} },
+    {x86::Opcode::VSUBPS,       {0, 1, 0x5C, 0x00, true} },
+    {x86::Opcode::VMULPS,       {0, 1, 0x59, 0x00, true} },
+    {x86::Opcode::VDIVPS,       {0, 1, 0x5E, 0x00, true} },
+    {x86::Opcode::VPADDD,       {1, 1, 0xFE, 0x00, true} },
+    {x86::Opcode::VPSUBD,       {1, 1, 0xFA, 0x00, true} },
+    {x86::Opcode::VPMULLD,      {1, 2, 0x40, 0x00, true} },
+};
+
+std::size_t Encoder::Chunk::size() const
+{
+    if (!isJump) {
+        return bytes.size();
+    }
+    if (isShort) {
+        return 2;
+    }
+    return isCond ? 6 : 5;
+}
+
+void Encoder::encode(const std::vector<x86::Instruction>& text)
+{
+    TimeScope scope("encode");
+
+    m_chunks.clear();
+    m_labels.clear();
+    m_code.clear();
+    m_relocations.clear();
+
+    for (const x86::Instruction& instr : text) {
+        Chunk c = encodeInstruction(instr);
+
+        if (instr.op == x86::Opcode::LABEL && !m_labels.emplace(c.label, m_chunks.size()).second) {
+            throw InterpretError(std::format("label {} is defined twice", c.label));
+        }
+        m_chunks.push_back(std::move(c));
+    }
+
+    for (const Chunk& c : m_chunks) {
+        if (c.isJump && !m_labels.contains(c.label)) {
+            throw InterpretError(std::format("undefined label {}", c.label));
+        }
+    }
+
+    // jumps start short and are made long when the target is out of range
+    // long jumps only move targets further, so this stops
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        m_offsets.assign(m_chunks.size() + 1, 0);
+        for (std::size_t i = 0; i < m_chunks.size(); i++) {
+            m_offsets[i + 1] = m_offsets[i] + m_chunks[i].size();
+        }
+
+        for (std::size_t i = 0; i < m_chunks.size(); i++) {
+            if (m_chunks[i].isJump && m_chunks[i].isShort && !fitsInt8(jumpDisp(i))) {
+                m_chunks[i].isShort = false;
+                changed             = true;
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < m_chunks.size(); i++) {
+        const Chunk& c = m_chunks[i];
+
+        if (c.isJump) {
+            std::int64_t disp = jumpDisp(i);
+
+            if (c.isShort) {
+                m_code.push_back(c.isCond ? 0x70 + c.cond : 0xEB);
+                put(m_code, disp, 1);
+            }
+            else {
+                if (c.isCond) {
+                    m_code.insert(m_code.end(), {0x0F, static_cast<std::uint8_t>(0x80 + c.cond)});
+                }
+                else {
+                    m_code.push_back(0xE9);
+                }
+                put(m_code, disp, 4);
+            }
+            continue;
+        }
+
+        if (c.hasRelocation) {
+            Relocation r = c.relocation;
+            r.offset += m_offsets[i];
+            m_relocations.push_back(r);
+        }
+        m_code.insert(m_code.end(), c.bytes.begin(), c.bytes.end());
+    }
+}
+
+std::int64_t Encoder::jumpDisp(std::size_t i) const
+{
+    std::size_t target = m_offsets[m_labels.at(m_chunks[i].label)];
+
+    return static_cast<std::int64_t>(target) - static_cast<std::int64_t>(m_offsets[i] + m_chunks[i].size());
+}
+
+Encoder::Chunk Encoder::encodeInstruction(const x86::Instruction& instr)
+{
+    Chunk                            c;
+    const std::vector<x86::Operand>& ops = instr.operands;
+
+    switch (instr.op) {
+        case x86::Opcode::LABEL:
+            c.label = std::get<x86::Label>(ops[0]).name;
+            break;
+        case x86::Opcode::JMP:
+            [[fallthrough]];
+        case x86::Opcode::JCC:
+            c.isJump = true;
+            c.isCond = instr.op == x86::Opcode::JCC;
+            c.cond   = static_cast<std::uint8_t>(instr.cond);
+            c.label  = std::get<x86::Label>(ops[0]).name;
+            break;
+        case x86::Opcode::MOV: {
+            std::uint8_t size = sizeOf(ops[0]) ? sizeOf(ops[0]) : sizeOf(ops[1]);
+
+            if (const x86::Immediate* value = immOf(ops[1])) {
+                const x86::Register* dst = regOf(ops[0]);
+
+                // mov r32, imm32 has a short form
+                if (dst && size == 4) {
+                    if (dst->num >= 8) {
+                        c.bytes.push_back(0x41);
+                    }
+                    c.bytes.push_back(0xB8 + (dst->num & 7));
+                    put(c.bytes, value->value, 4);
+                }
+                else if (size == 1) {
+                    legacy(c, 0, false, {0xC6}, 0, ops[0]);
+                    put(c.bytes, value->value, 1);
+                }
+                else {
+                    legacy(c, 0, size == 8, {0xC7}, 0, ops[0]);
+                    put(c.bytes, value->value, 4);
+                }
+            }
+            else if (const x86::Register* src = regOf(ops[1])) {
+                legacy(c, 0, size == 8, {static_cast<std::uint8_t>(size == 1 ? 0x88 : 0x89)}, src->num, ops[0]);
+            }
+            else if (const x86::Register* dst = regOf(ops[0])) {
+                legacy(c, 0, size == 8, {static_cast<std::uint8_t>(size == 1 ? 0x8A : 0x8B)}, dst->num, ops[1]);
+            }
+            else {
+                error(instr);
+            }
+            break;
+        }
+        case x86::Opcode::MOVZX:
+            legacy(c, 0, false, {0x0F, 0xB6}, regOf(ops[0])->num, ops[1]);
+            break;
+        case x86::Opcode::MOVSX:
+            legacy(c, 0, false, {0x0F, 0xBE}, regOf(ops[0])->num, ops[1]);
+            break;
+        case x86::Opcode::MOVSXD:
+            legacy(c, 0, true, {0x63}, regOf(ops[0])->num, ops[1]);
+            break;
+        case x86::Opcode::LEA:
+            legacy(c, 0, true, {0x8D}, regOf(ops[0])->num, ops[1]);
+            break;
+        case x86::Opcode::ADD:
+            encodeALU(c, instr, 0);
+            break;
+        case x86::Opcode::OR:
+            encodeALU(c, instr, 1);
+            break;
+        case x86::Opcode::AND:
+            encodeALU(c, instr, 4);
+            break;
+        case x86::Opcode::SUB:
+            encodeALU(c, instr, 5);
+            break;
+        case x86::Opcode::XOR:
+            encodeALU(c, instr, 6);
+            break;
+        case x86::Opcode::CMP:
+            encodeALU(c, instr, 7);
+            break;
+        case x86::Opcode::TEST: {
+            std::uint8_t size = sizeOf(ops[0]);
+            legacy(c, 0, size == 8, {static_cast<std::uint8_t>(size == 1 ? 0x84 : 0x85)}, regOf(ops[1])->num, ops[0]);
+            break;
+        }
+        case x86::Opcode::IMUL: {
+            bool w = sizeOf(ops[0]) == 8;
+
+            if (ops.size() == 2 && !immOf(ops[1])) {
+                legacy(c, 0, w, {0x0F, 0xAF}, regOf(ops[0])->num, ops[1]);
+                break;
+            }
+
+            // imul r, imm is imul r, r, imm
+            const x86::Operand& src   = ops.size() == 2 ? ops[0] : ops[1];
+            std::int64_t        value = immOf(ops.back())->value;
+
+            if (fitsInt8(value)) {
+                legacy(c, 0, w, {0x6B}, regOf(ops[0])->num, src);
+                put(c.bytes, value, 1);
+            }
+            else {
+                legacy(c, 0, w, {0x69}, regOf(ops[0])->num, src);
+                put(c.bytes, value, 4);
+            }
+            break;
+        }
+        case x86::Opcode::CDQ:
+            c.bytes.push_back(0x99);
+            break;
+        case x86::Opcode::IDIV:
+            legacy(c, 0, sizeOf(ops[0]) == 8, {0xF7}, 7, ops[0]);
+            break;
+        case x86::Opcode::NEG:
+            legacy(c, 0, sizeOf(ops[0]) == 8, {static_cast<std::uint8_t>(sizeOf(ops[0]) == 1 ? 0xF6 : 0xF7)}, 3, ops[0]);
+            break;
+        case x86::Opcode::SHL:
+            [[fallthrough]];
+        case x86::Opcode::SHR:
+            [[fallthrough]];
+        case x86::Opcode::SAR: {
+            // shift by imm8: C1 /4, /5, /7
+            std::uint8_t ext = instr.op == x86::Opcode::SHL ? 4 : instr.op == x86::Opcode::SHR ? 5 : 7;
+
+            legacy(c, 0, sizeOf(ops[0]) == 8, {0xC1}, ext, ops[0]);
+            put(c.bytes, immOf(ops[1])->value, 1);
+            break;
+        }
+        case x86::Opcode::PUSH:
+            [[fallthrough]];
+        case x86::Opcode::POP: {
+            const x86::Register* r = regOf(ops[0]);
+
+            if (r->num >= 8) {
+                c.bytes.push_back(0x41);
+            }
+            c.bytes.push_back((instr.op == x86::Opcode::PUSH ? 0x50 : 0x58) + (r->num & 7));
+            break;
+        }
+        case x86::Opcode::SETCC:
+            legacy(c, 0, false, {0x0F, static_cast<std::uint8_t>(0x90 + static_cast<std::uint8_t>(instr.cond))}, 0, ops[0]);
+            break;
+        case x86::Opcode::RET:
+            c.bytes.push_back(0xC3);
+            break;
+        case x86::Opcode::SYSCALL:
+            c.bytes.insert(c.bytes.end(), {0x0F, 0x05});
+            break;
+        case x86::Opcode::VZEROUPPER:
+            c.bytes.insert(c.bytes.end(), {0xC5, 0xF8, 0x77});
+            break;
+        default:
+            if (SSEOps.contains(instr.op)) {
+                encodeSSE(c, instr);
+            }
+            else if (VEXOps.contains(instr.op)) {
+                encodeVEX(c, instr);
+            }
+            else {
+                error(instr);
+            }
+    }
+
+    // rip-relative displacement is counted from the end of instruction
+    if (c.hasRelocation) {
+        c.relocation.addend -= static_cast<std::int64_t>(c.bytes.size() - c.relocation.offset);
+    }
+
+    return c;
+}
+
+void Encoder::encodeALU(Chunk& c, const x86::Instruction& instr, std::uint8_t ext)
+{
+    const std::vector<x86::Operand>& ops  = instr.operands;
+    std::uint8_t                     size = sizeOf(ops[0]) ? sizeOf(ops[0]) : sizeOf(ops[1]);
+    bool                             w    = size == 8;
+    std::uint8_t                     base = ext * 8;
+
+    if (const x86::Immediate* value = immOf(ops[1])) {
+        const x86::Register* dst = regOf(ops[0]);
+
+        if (size == 1) {
+            legacy(c, 0, false, {0x80}, ext, ops[0]);
+            put(c.bytes, value->value, 1);
+        }
+        else if (fitsInt8(value->value)) {
+            legacy(c, 0, w, {0x83}, ext, ops[0]);
+            put(c.bytes, value->value, 1);
+        }
+        // eax/rax has a short form
+        else if (dst && dst->num == 0) {
+            if (w) {
+                c.bytes.push_back(0x48);
+            }
+            c.bytes.push_back(base + 5);
+            put(c.bytes, value->value, 4);
+        }
+        else {
+            legacy(c, 0, w, {0x81}, ext, ops[0]);
+            put(c.bytes, value->value, 4);
+        }
+    }
+    else if (const x86::Register* src = regOf(ops[1])) {
+        legacy(c, 0, w, {static_cast<std::uint8_t>(base + (size == 1 ? 0 : 1))}, src->num, ops[0]);
+    }
+    else if (const x86::Register* dst = regOf(ops[0])) {
+        legacy(c, 0, w, {static_cast<std::uint8_t>(base + (size == 1 ? 2 : 3))}, dst->num, ops[1]);
+    }
+    else {
+        error(instr);
+    }
+}
+
+void Encoder::encodeSSE(Chunk& c, const x86::Instruction& instr)
+{
+    const std::vector<x86::Operand>& ops  = instr.operands;
+    const SSEInfo&                   info = SSEOps.at(instr.op);
+
+    // movd r/m32, xmm and stores use the second form
+    const x86::Register* dst   = regOf(ops[0]);
+    bool                 store = !dst || (instr.op == x86::Opcode::MOVD && !dst->isVector());
+
+    if (store) {
+        if (info.store.empty()) {
+            error(instr);
+        }
+        legacy(c, info.prefix, false, info.store, regOf(ops[1])->num, ops[0]);
+        return;
+    }
+
+    legacy(c, info.prefix, false, info.load, dst->num, ops[1]);
+
+    if (ops.size() == 3) {
+        put(c.bytes, immOf(ops[2])->value, 1);
+    }
+}
+
+void Encoder::encodeVEX(Chunk& c, const x86::Instruction& instr)
+{
+    const std::vector<x86::Operand>& ops  = instr.operands;
+    const VEXInfo&                   info = VEXOps.at(instr.op);
+    const x86::Register*             dst  = regOf(ops[0]);
+
+    if (!dst || !dst->isVector()) {
+        const x86::Register* src = regOf(ops[1]);
+
+        if (!info.store) {
+            error(instr);
+        }
+        vex(c, info.pp, info.map, false, src->cls == x86::RegClass::YMM, info.store, src->num, 0, ops[0]);
+        return;
+    }
+
+    bool l = dst->cls == x86::RegClass::YMM;
+
+    if (info.nds) {
+        vex(c, info.pp, info.map, false, l, info.load, dst->num, regOf(ops[1])->num, ops[2]);
+    }
+    else {
+        vex(c, info.pp, info.map, false, l, info.load, dst->num, 0, ops[1]);
+    }
+}
+
+void Encoder::legacy(Chunk&                           c,
+                     std::uint8_t                     prefix,
+                     bool                             w,
+                     const std::vector<std::uint8_t>& opcode,
+                     std::uint8_t                     reg,
+                     const x86::Operand&              rm)
+{
+    std::uint8_t x = 0;
+    std::uint8_t b = 0;
+
+    if (const x86::Register* r = regOf(rm)) {
+        b = r->num >> 3;
+    }
+    else if (const x86::Memory* m = memOf(rm)) {
+        x = m->hasIndex ? m->index.num >> 3 : 0;
+        b = m->hasBase ? m->base.num >> 3 : 0;
+    }
+
+    if (prefix) {
+        c.bytes.push_back(prefix);
+    }
+
+    std::uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (x << 1) | b;
+    if (rex != 0x40) {
+        c.bytes.push_back(rex);
+    }
+
+    c.bytes.insert(c.bytes.end(), opcode.begin(), opcode.end());
+    modRM(c, reg, rm);
+}
+
+void Encoder::vex(Chunk&              c,
+                  std::uint8_t        pp,
+                  std::uint8_t        map,
+                  bool                w,
+                  bool                l,
+                  std::uint8_t        opcode,
+                  std::uint8_t        reg,
+                  std::uint8_t        vvvv,
+                  const x86::Operand& rm)
+{
+    std::uint8_t x = 0;
+    std::uint8_t b = 0;
+
+    if (const x86::Register* r = regOf(rm)) {
+        b = r->num >> 3;
+    }
+    else if (const x86::Memory* m = memOf(rm)) {
+        x = m->hasIndex ? m->index.num >> 3 : 0;
+        b = m->hasBase ? m->base.num >> 3 : 0;
+    }
+
+    // register extension bits and vvvv are stored inverted
+    std::uint8_t r    = reg >> 3;
+    std::uint8_t tail = ((~vvvv & 0xF) << 3) | (l << 2) | pp;
+
+    if (map == 1 && !w && !x && !b) {
+        c.bytes.insert(c.bytes.end(), {0xC5, static_cast<std::uint8_t>((!r << 7) | tail)});
+    }
+    else {
+        c.bytes.insert(c.bytes.end(),
+                       {0xC4,
+                        static_cast<std::uint8_t>((!r << 7) | (!x << 6) | (!b << 5) | map),
+                        static_cast<std::uint8_t>((w << 7) | tail)});
+    }
+
+    c.bytes.push_back(opcode);
+    modRM(c, reg, rm);
+}
+
+void Encoder::modRM(Chunk& c, std::uint8_t reg, const x86::Operand& rm)
+{
+    std::uint8_t r = (reg & 7) << 3;
+
+    if (const x86::Register* rr = regOf(rm)) {
+        c.bytes.push_back(0xC0 | r | (rr->num & 7));
+        return;
+    }
+
+    const x86::Memory& m = std::get<x86::Memory>(rm);
+
+    // [rip + disp32]
+    if (!m.hasBase) {
+        if (m.hasIndex || m.symbol.empty()) {
+            throw InterpretError("memory operand without base register");
+        }
+
+        c.bytes.push_back(0x05 | r);
+
+        c.hasRelocation = true;
+        c.relocation    = {c.bytes.size(), m.symbol, m.disp};
+        put(c.bytes, 0, 4);
+        return;
+    }
+
+    std::uint8_t base = m.base.num & 7;
+
+    // rbp and r13 have no form without displacement
+    std::uint8_t mod = (m.disp == 0 && base != 5) ? 0 : fitsInt8(m.disp) ? 1 : 2;
+
+    // rsp and r12 can only be encoded with SIB
+    if (m.hasIndex || base == 4) {
+        std::uint8_t scale = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+        std::uint8_t index = m.hasIndex ? m.index.num & 7 : 4;
+
+        c.bytes.push_back((mod << 6) | r | 4);
+        c.bytes.push_back((scale << 6) | (index << 3) | base);
+    }
+    else {
+        c.bytes.push_back((mod << 6) | r | base);
+    }
+
+    if (mod == 1) {
+        put(c.bytes, m.disp, 1);
+    }
+    else if (mod == 2) {
+        put(c.bytes, m.disp, 4);
+    }
+}
+
+void Encoder::error(const x86::Instruction& instr)
+{
+    throw InterpretError(std::format("cannot encode {}", x86::toString(instr)));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Assembly.h"
+
+// 32-bit pc-relative reference to a global variable
+// resolved value is symbol + addend - address of the field
+struct Relocation
+{
+    std::size_t  offset; // offset of the 4-byte field in code
+    std::string  symbol;
+    std::int64_t addend;
+};
+
+// encodes x86-64 instructions to machine code
+// jumps to labels are resolved and relaxed to the short form where they fit,
+// references to globals are left as relocations
+class Encoder
+{
+public:
+    Encoder() {}
+    ~Encoder() {}
+
+    Encoder(const Encoder&)            = delete;
+    Encoder(Encoder&&)                 = delete;
+    Encoder& operator=(const Encoder&) = delete;
+    Encoder& operator=(Encoder&&)      = delete;
+
+    void encode(const std::vector<x86::Instruction>& text);
+
+    const std::vector<std::uint8_t>& getCode() const { return m_code; }
+    const std::vector<Relocation>&   getRelocations() const { return m_relocations; }
+    // code offset of instruction i of the text, the code size for i == size of the text
+    std::size_t getOffset(std::size_t i) const { return m_offsets[i]; }
+
+private:
+    // encoded instruction, jumps are encoded after their length is known
+    struct Chunk
+    {
+        std::vector<std::uint8_t> bytes;
+
+        bool       hasRelocation = false;
+        Relocation relocation    = {}; // offset is relative to the instruction
+
+        std::string  label; // jump target or defined label
+        bool         isJump  = false;
+        bool         isShort = true;
+        bool         isCond  = false;
+        std::uint8_t cond    = 0;
+
+        std::size_t size() const;
+    };
+
+    Chunk encodeInstruction(const x86::Instruction& instr);
+
+    void encodeALU(Chunk& c, const x86::Instruction& instr, std::uint8_t ext);
+    void encodeSSE(Chunk& c, const x86::Instruction& instr);
+    void encodeVEX(Chunk& c, const x86::Instruction& instr);
+
+    // [prefix] [REX] opcode ModRM [SIB] [disp]
+    void legacy(Chunk&                           c,
+                std::uint8_t                     prefix,
+                bool                             w,
+                const std::vector<std::uint8_t>& opcode,
+                std::uint8_t                     reg,
+                const x86::Operand&              rm);
+    // VEX opcode ModRM [SIB] [disp]
+    void vex(Chunk&              c,
+             std::uint8_t        pp,
+             std::uint8_t        map,
+             bool                w,
+             bool                l,
+             std::uint8_t        opcode,
+             std::uint8_t        reg,
+             std::uint8_t        vvvv,
+             const x86::Operand& rm);
+
+    void modRM(Chunk& c, std::uint8_t reg, const x86::Operand& rm);
+
+    // final displacement of jump in chunk i
+    std::int64_t jumpDisp(std::size_t i) const;
+
+    [[noreturn]] void error(const x86::Instruction& instr);
+
+private:
+    std::vector<Chunk>                           m_chunks;
+    std::vector<std::size_t>                     m_offsets;
+    std::unordered_map<std::string, std::size_t> m_labels; // label -> chunk index
+
+    std::vector<std::uint8_t> m_code;
+    std::vector<Relocation>   m_relocations;
+};
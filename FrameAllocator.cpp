@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <variant>
+
+#include "FrameAllocator.h"
+#include "Profiler.h"
+
+// variable stored in the stack frame
+static bool isLocal(const Symbol& sym)
+{
+    return !SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_GLOBAL) && !SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_FIELD);
+}
+
+void FrameAllocator::allocate(const ast::ASTNodePtr& ast)
+{
+    TimeScope scope("frame layout");
+
+    m_position = 0;
+    m_ranges.clear();
+    m_index.clear();
+    m_loops.clear();
+
+    collect(ast);
+    extendOverLoops();
+
+    m_symbolTable.setFrameSize(assignOffsets());
+}
+
+void FrameAllocator::collect(const ast::ASTNodePtr& node)
+{
+    std::size_t position = m_position++;
+
+    if (std::holds_alternative<ast::Declaration>(node->getData())) {
+        const ast::Identifier& id = std::get<ast::Identifier>(node->getChildren().front()->getData());
+
+        if (isLocal(*id.getSymbol())) {
+            m_index[id.getSymbol().get()] = m_ranges.size();
+            m_ranges.push_back({id.getSymbol().get(), position, position});
+        }
+    }
+    else if (const ast::Identifier* id = std::get_if<ast::Identifier>(&node->getData())) {
+        auto it = id->getSymbol() ? m_index.find(id->getSymbol().get()) : m_index.end();
+
+        if (it != m_index.end()) {
+            m_ranges[it->second].end = position;
+        }
+    }
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        collect(c);
+    }
+
+    if (std::holds_alternative<ast::WhileLoop>(node->getData())) {
+        m_loops.emplace_back(position, m_position - 1);
+    }
+}
+
+void FrameAllocator::extendOverLoops()
+{
+    // a use after the loop start is either inside the loop or after its end,
+    // the value must survive the back edge in both cases
+    for (LiveRange& r : m_ranges) {
+        for (const auto& [first, last] : m_loops) {
+            if (r.start < first && r.end >= first) {
+                r.end = std::max(r.end, last);
+            }
+        }
+    }
+}
+
+std::size_t FrameAllocator::assignOffsets()
+{
+    // ranges are in order of their start, active ones are sorted by their lowest byte
+    struct Slot
+    {
+        std::size_t low;
+        std::size_t high;
+        std::size_t end;
+    };
+
+    std::vector<Slot> active;
+    std::size_t       frame = 0;
+
+    for (const LiveRange& r : m_ranges) {
+        std::erase_if(active, [&r](const Slot& s) { return s.end < r.start; });
+
+        // variable takes bytes [offset - size, offset) below the frame base
+        std::size_t size   = std::max<std::size_t>(r.sym->size, 1);
+        std::size_t offset = alignTo(size, r.sym->align);
+
+        for (const Slot& s : active) {
+            if (offset - size < s.high && s.low < offset) {
+                offset = alignTo(s.high + size, r.sym->align);
+            }
+        }
+
+        r.sym->offset = offset;
+        frame         = std::max(frame, offset);
+
+        Slot slot{offset - size, offset, r.end};
+        active.insert(std::ranges::upper_bound(active, slot.low, {}, &Slot::low), slot);
+    }
+
+    return frame;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+#include "SymbolTable.h"
+
+// works with AST, that was checked by the semantic analyzer
+// assigns stack frame offsets to local variables by their live ranges,
+// variables which are never live at the same time share stack slots
+class FrameAllocator
+{
+public:
+    FrameAllocator(SymbolTable& st) : m_symbolTable(st) {}
+    ~FrameAllocator() {}
+
+    FrameAllocator(const FrameAllocator&)            = delete;
+    FrameAllocator(FrameAllocator&&)                 = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(FrameAllocator&&)      = delete;
+
+    // sets offsets of local symbols and frame size of the symbol table
+    void allocate(const ast::ASTNodePtr& ast);
+
+private:
+    // numbers nodes in execution order, records declarations, uses and loops
+    void collect(const ast::ASTNodePtr& node);
+
+    // variable used inside a loop and declared before it lives until the loop ends
+    void extendOverLoops();
+
+    // first fit by start of live range, offsets keep natural alignment
+    std::size_t assignOffsets();
+
+private:
+    struct LiveRange
+    {
+        Symbol*     sym;
+        std::size_t start; // declaration
+        std::size_t end;   // last use
+    };
+
+    SymbolTable& m_symbolTable;
+
+    std::size_t                                      m_position = 0;
+    std::vector<LiveRange>                           m_ranges; // in declaration order
+    std::unordered_map<const Symbol*, std::size_t>   m_index;  // symbol -> range
+    std::vector<std::pair<std::size_t, std::size_t>> m_loops;  // first and last position
+};
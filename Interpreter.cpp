@@ -1,105 +1,1409 @@
+#include <bit>
 #include <format>
+#include <limits>
 #include <memory>
-#include <ranges>
 
 #include "Interpreter.h"
+#include "Profiler.h"
 
-void Interpreter::interpret(const ast::ASTNodePtr& ast)
+// setcc and jcc conditions of relational operators on int, bool and char
+static const std::unordered_map<std::string, x86::Cond> intConditions = {
+    {">",  x86::Cond::G },
+    {"<",  x86::Cond::L },
+    {">=", x86::Cond::GE},
+    {"<=", x86::Cond::LE},
+    {"==", x86::Cond::E },
+    {"!=", x86::Cond::NE},
+};
+
+const x86::Program& Interpreter::interpret(const ast::ASTNodePtr& ast)
 {
+    TimeScope scope("interpret");
+
+    m_program = {};
+    m_line    = 0;
+    m_counters.clear();
+    m_counterCount = 0;
+    m_coldBlocks.clear();
+
+    if (!m_profilePath.empty() || m_profile) {
+        numberCounters(ast);
+    }
+
     interpretSymbols();
     interpretText(ast);
+    interpretConstants();
+
+    return m_program;
+}
+
+const x86::Program& Interpreter::interpretBegin()
+{
+    m_program = {};
+    interpretPrologue(true);
+
+    return m_program;
+}
+
+const x86::Program& Interpreter::interpretStatement(const ast::ASTNodePtr& statement)
+{
+    m_program.text.clear();
+    interpretNode(statement);
+
+    return m_program;
+}
+
+const x86::Program& Interpreter::interpretEnd(SymbolTable&& st)
+{
+    m_symbolTable = std::move(st);
+
+    m_program.text.clear();
+    interpretEpilogue();
+    interpretSymbols();
+    interpretConstants();
+
+    return m_program;
 }
 
 void Interpreter::interpretSymbols()
 {
-    // Symbol table entry
-    using STEntry = std::pair<std::string, std::shared_ptr<Symbol>>;
+    for (const auto& [name, sym] : m_symbolTable.getData().symbols) {
+        m_program.data.push_back({name, sym->align, ts::TypeSize[sym->type], 1, sym->value});
+    }
+
+    // globals initialized at runtime are reserved too
+    for (const auto& [name, sym] : m_symbolTable.getBss().symbols) {
+        // structs are reserved as bytes
+        if (sym->type == ts::Type::struct_t) {
+            m_program.bss.push_back({name, sym->align, 1, sym->size});
+            continue;
+        }
+
+        std::uint32_t unit = ts::TypeSize[sym->type];
+
+        m_program.bss.push_back({name, sym->align, unit, sym->size / unit});
+    }
+
+    if (!m_profilePath.empty()) {
+        m_program.bss.push_back({PROFILE_LABEL, 8, 1, static_cast<std::uint32_t>(profileSize())});
+    }
+}
+
+void Interpreter::interpretText(const ast::ASTNodePtr& ast)
+{
+    interpretPrologue(false);
+    interpretNode(ast);
+    interpretEpilogue();
+}
 
-    std::vector<STEntry> globalSymbols(m_symbolTable[0]->getSize());
+void Interpreter::interpretPrologue(bool streamed)
+{
+    // callee-saved registers, rbx keeps the caller's stack pointer
+    if (m_callable) {
+        emit(x86::Opcode::PUSH, x86::RBP);
+        emit(x86::Opcode::PUSH, x86::RBX);
+        emit(x86::Opcode::MOV, x86::RBX, x86::RSP);
+    }
+
+    // rbp is aligned for 32-byte array slots
+    emit(x86::Opcode::AND, x86::RSP, x86::imm(-32));
+    emit(x86::Opcode::MOV, x86::RBP, x86::RSP);
+    if (streamed) {
+        emit(x86::Opcode::SUB, x86::RSP, x86::label(FRAME_LABEL));
+    }
+    else if (std::size_t size = frameSize()) {
+        emit(x86::Opcode::SUB, x86::RSP, x86::imm(size));
+    }
 
-    std::copy(m_symbolTable[0]->begin(), m_symbolTable[0]->end(), globalSymbols.begin());
+    if (!m_profilePath.empty()) {
+        interpretProfileHeader();
+    }
+}
 
-    std::ranges::filter_view initializedGlobal = globalSymbols |
-                                                 std::ranges::views::filter(
-                                                     [](STEntry& s) -> bool
-                                                     { return SYMBOL_GET_FLAG((*s.second), SYMBOL_FLAG_COMPILETIME); });
+void Interpreter::interpretEpilogue()
+{
+    interpretExit(0);
+    interpretColdBlocks();
 
-    if (!initializedGlobal.empty()) {
-        m_outputStream << "section .data\n";
+    // array index out of range or division by zero
+    if (m_faultExit) {
+        emitLabel(".Lfault");
+        interpretExit(1);
     }
-    for (const auto& e : initializedGlobal) {
-        m_outputStream << '\t' << std::format("{} {} {}\n", e.first, definedirectiveToASM(e.second->type), e.second->value);
+}
+
+void Interpreter::interpretExit(std::int32_t code)
+{
+    if (!m_profilePath.empty()) {
+        interpretProfileDump();
     }
 
-    std::ranges::filter_view
-        uninitGlobal = globalSymbols |
-                       std::ranges::views::filter(
-                           [](STEntry& s) -> bool {
-                               return !(SYMBOL_GET_FLAG((*s.second), SYMBOL_FLAG_INITIALIZED | SYMBOL_FLAG_COMPILETIME));
-                           });
+    if (m_callable) {
+        if (code == 0) {
+            emit(x86::Opcode::XOR, x86::EAX, x86::EAX);
+        }
+        else {
+            emit(x86::Opcode::MOV, x86::EAX, x86::imm(code));
+        }
+        emit(x86::Opcode::MOV, x86::RSP, x86::RBX);
+        emit(x86::Opcode::POP, x86::RBX);
+        emit(x86::Opcode::POP, x86::RBP);
+        emit(x86::Opcode::RET);
+        return;
+    }
 
-    if (!uninitGlobal.empty()) {
-        m_outputStream << "\nsection .bss\n";
+    // exit syscall
+    emit(x86::Opcode::MOV, x86::EAX, x86::imm(60));
+    if (code == 0) {
+        emit(x86::Opcode::XOR, x86::EDI, x86::EDI);
     }
-    for (const auto& e : uninitGlobal) {
-        m_outputStream << '\t'
-                       << std::format("{} {} {}\n",
-                                      e.first,
-                                      reservedirectiveToASM(e.second->type),
-                                      e.second->size / ts::TypeSize[e.second->type]);
+    else {
+        emit(x86::Opcode::MOV, x86::EDI, x86::imm(code));
     }
+    emit(x86::Opcode::SYSCALL);
 }
 
-void Interpreter::interpretText(const ast::ASTNodePtr& ast)
+void Interpreter::interpretColdBlocks()
+{
+    // cold blocks may have cold branches of their own
+    while (!m_coldBlocks.empty()) {
+        ColdBlock block = std::move(m_coldBlocks.back());
+        m_coldBlocks.pop_back();
+
+        emitLabel(block.label);
+        interpretCount(block.branch.get(), block.arm);
+        interpretNode(*std::next(block.branch->getChildren().begin(), block.arm + 1));
+        emit(x86::Opcode::JMP, x86::label(block.returnLabel));
+    }
+}
+
+void Interpreter::numberCounters(const ast::ASTNodePtr& node)
+{
+    if (std::holds_alternative<ast::Branch>(node->getData())) {
+        m_counters[node.get()] = m_counterCount;
+        m_counterCount += 2;
+    }
+    else if (std::holds_alternative<ast::WhileLoop>(node->getData())) {
+        m_counters[node.get()] = m_counterCount;
+        m_counterCount += 1;
+    }
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        numberCounters(c);
+    }
+}
+
+void Interpreter::instrument(std::string path, std::uint64_t sourceHash)
+{
+    m_profilePath = std::move(path);
+    m_sourceHash  = sourceHash;
+}
+
+void Interpreter::interpretProfileHeader()
+{
+    std::vector<std::uint32_t> words = {Profile::MAGIC,
+                                        Profile::VERSION,
+                                        static_cast<std::uint32_t>(m_sourceHash),
+                                        static_cast<std::uint32_t>(m_sourceHash >> 32),
+                                        static_cast<std::uint32_t>(m_counterCount),
+                                        static_cast<std::uint32_t>(static_cast<std::uint64_t>(m_counterCount) >> 32)};
+
+    // zero-terminated path follows the counters, .bss is zeroed
+    for (std::size_t i = 0; i < m_profilePath.size(); i += 4) {
+        std::uint32_t word = 0;
+        for (std::size_t j = 0; j < 4 && i + j < m_profilePath.size(); j++) {
+            word |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(m_profilePath[i + j])) << (8 * j);
+        }
+        words.push_back(word);
+    }
+
+    std::int32_t pathOffset = Profile::HEADER_SIZE + 8 * m_counterCount;
+
+    for (std::size_t i = 0; i < words.size(); i++) {
+        if (words[i] == 0) {
+            continue;
+        }
+
+        std::int32_t disp = i < 6 ? 4 * i : pathOffset + 4 * (i - 6);
+        emit(x86::Opcode::MOV, x86::mem(4, PROFILE_LABEL, disp), x86::imm(static_cast<std::int32_t>(words[i])));
+    }
+}
+
+void Interpreter::interpretProfileDump()
+{
+    std::string skipLabel = newLabel();
+
+    // open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+    emit(x86::Opcode::MOV, x86::EAX, x86::imm(2));
+    emit(x86::Opcode::LEA, x86::RDI, x86::mem(0, PROFILE_LABEL, Profile::HEADER_SIZE + 8 * m_counterCount));
+    emit(x86::Opcode::MOV, x86::ESI, x86::imm(0x241));
+    emit(x86::Opcode::MOV, x86::EDX, x86::imm(0644));
+    emit(x86::Opcode::SYSCALL);
+    emit(x86::Opcode::CMP, x86::EAX, x86::imm(0));
+    emitCond(x86::Opcode::JCC, x86::Cond::L, x86::label(skipLabel));
+
+    // write(fd, profile, size), close(fd)
+    emit(x86::Opcode::MOV, x86::EDI, x86::EAX);
+    emit(x86::Opcode::MOV, x86::EAX, x86::imm(1));
+    emit(x86::Opcode::LEA, x86::RSI, x86::mem(0, PROFILE_LABEL));
+    emit(x86::Opcode::MOV, x86::EDX, x86::imm(Profile::HEADER_SIZE + 8 * m_counterCount));
+    emit(x86::Opcode::SYSCALL);
+    emit(x86::Opcode::MOV, x86::EAX, x86::imm(3));
+    emit(x86::Opcode::SYSCALL);
+
+    emitLabel(skipLabel);
+}
+
+void Interpreter::interpretCount(const ast::ASTNode* node, std::size_t arm, std::int64_t n)
+{
+    if (m_profilePath.empty()) {
+        return;
+    }
+
+    auto it = m_counters.find(node);
+    if (it == m_counters.end()) {
+        return;
+    }
+
+    std::int32_t disp = Profile::HEADER_SIZE + 8 * (it->second + arm);
+    emit(x86::Opcode::ADD, x86::mem(8, PROFILE_LABEL, disp), x86::imm(n));
+}
+
+std::uint64_t Interpreter::profileCount(const ast::ASTNode* node, std::size_t arm) const
 {
-    m_outputStream << "\nsection .text\n\tglobal _start\n\n_start:\n";
+    auto it = m_counters.find(node);
+
+    return m_profile && it != m_counters.end() ? m_profile->count(it->second + arm) : 0;
+}
+
+std::size_t Interpreter::profileSize() const
+{
+    // path is stored in whole words
+    return Profile::HEADER_SIZE + 8 * m_counterCount + (m_profilePath.size() + 4) / 4 * 4;
+}
+
+void Interpreter::interpretConstants()
+{
+    for (const auto& [bits, label] : m_floatConstants) {
+        m_program.rodata.push_back({label, 4, 4, 1, bits});
+    }
 }
 
 void Interpreter::interpretNode(const ast::ASTNodePtr& node)
 {
+    std::uint32_t line = m_line;
+    if (m_sources) {
+        m_line = sourceLine(node);
+    }
+
     std::visit(
         [&node, this](auto&& arg) -> void
         {
             using T = std::decay_t<decltype(arg)>;
 
-            if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+            if constexpr (std::disjunction_v<std::is_same<T, ast::Root>,
+                                             std::is_same<T, ast::BodyThen>,
+                                             std::is_same<T, ast::BodyElse>>) {
+                for (const ast::ASTNodePtr& c : node->getChildren()) {
+                    interpretNode(c);
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::Declaration>) {
+                if (node->getChildren().size() != 2) {
+                    return;
+                }
+
+                const ast::ASTNodePtr& id  = node->getChildren().front();
+                const Symbol&          sym = *std::get<ast::Identifier>(id->getData()).getSymbol();
+
+                // value is already in .data
+                if (SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_GLOBAL) && SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_COMPILETIME)) {
+                    return;
+                }
+
+                interpretExpr(node->getChildren().back());
+                interpretStore(id, sym.type);
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                if (arg.getLiteral() != "=") {
+                    error("expression statement is not an assignment");
+                }
+
+                interpretExpr(node->getChildren().back());
+                interpretStore(node->getChildren().front(), arg.getType());
+            }
+            else if constexpr (std::is_same_v<T, ast::Branch>) {
+                interpretBranch(node);
+            }
+            else if constexpr (std::is_same_v<T, ast::WhileLoop>) {
+                interpretLoop(node);
             }
         },
         node->getData());
+
+    m_line = line;
 }
 
-std::string Interpreter::definedirectiveToASM(const ts::Type& type)
+void Interpreter::interpretExpr(const ast::ASTNodePtr& node)
 {
+    std::uint32_t line = m_line;
+    if (m_sources) {
+        m_line = sourceLine(node);
+    }
+
+    std::visit(
+        [&node, this](auto&& arg) -> void
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::is_same_v<T, ast::Integer>) {
+                emit(x86::Opcode::MOV, x86::EAX, x86::imm(arg.getValue()));
+            }
+            else if constexpr (std::is_same_v<T, ast::Boolean>) {
+                emit(x86::Opcode::MOV, x86::EAX, x86::imm(arg.getValue() ? 1 : 0));
+            }
+            else if constexpr (std::is_same_v<T, ast::Float>) {
+                emit(x86::Opcode::MOVSS, x86::xmm(0), floatToASM(arg.getValue()));
+            }
+            else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                switch (arg.getSymbol()->type) {
+                    case ts::Type::int_t:
+                        emit(x86::Opcode::MOV, x86::EAX, variableToASM(node));
+                        break;
+                    case ts::Type::float_t:
+                        emit(x86::Opcode::MOVSS, x86::xmm(0), variableToASM(node));
+                        break;
+                    case ts::Type::bool_t:
+                        emit(x86::Opcode::MOVZX, x86::EAX, variableToASM(node));
+                        break;
+                    case ts::Type::char_t:
+                        emit(x86::Opcode::MOVSX, x86::EAX, variableToASM(node));
+                        break;
+                    default:
+                        error("cannot convert unknown type to assembly");
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::UnaryExpr>) {
+                interpretExpr(node->getChildren().front());
+
+                if (arg.getType() == ts::Type::float_t) {
+                    emit(x86::Opcode::MOV, x86::EAX, x86::imm(0x80000000));
+                    emit(x86::Opcode::MOVD, x86::xmm(1), x86::EAX);
+                    emit(x86::Opcode::XORPS, x86::xmm(0), x86::xmm(1));
+                }
+                else {
+                    emit(x86::Opcode::NEG, x86::EAX);
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::ImplicitTypeCast>) {
+                interpretExpr(node->getChildren().front());
+                interpretCast(arg.getFromCast(), arg.getToCast());
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                interpretBinary(node);
+            }
+            else {
+                error("node is not an expression");
+            }
+        },
+        node->getData());
+
+    m_line = line;
+}
+
+void Interpreter::interpretBinary(const ast::ASTNodePtr& node)
+{
+    const ast::BinaryExpr& be    = std::get<ast::BinaryExpr>(node->getData());
+    std::string            op    = be.getLiteral();
+    const ast::ASTNodePtr& left  = node->getChildren().front();
+    const ast::ASTNodePtr& right = node->getChildren().back();
+
+    if (ast::isLogical(node)) {
+        interpretLogical(node);
+        return;
+    }
+
+    if (op == "[]" || op == ".") {
+        interpretIndex(node);
+
+        x86::Memory element = elementToASM(node);
+
+        switch (be.getType()) {
+            case ts::Type::int_t:
+                emit(x86::Opcode::MOV, x86::EAX, element);
+                break;
+            case ts::Type::float_t:
+                emit(x86::Opcode::MOVSS, x86::xmm(0), element);
+                break;
+            case ts::Type::bool_t:
+                emit(x86::Opcode::MOVZX, x86::EAX, element);
+                break;
+            case ts::Type::char_t:
+                emit(x86::Opcode::MOVSX, x86::EAX, element);
+                break;
+            default:
+                error("cannot convert unknown type to assembly");
+        }
+        return;
+    }
+
+    if (interpretReduced(op, left, right)) {
+        return;
+    }
+
+    // both operands have the same type after semantic analysis
+    bool         isFlt   = ast::getType(left) == ts::Type::float_t;
+    x86::Operand rhs     = interpretOperands(left, right);
+    bool         operand = !std::holds_alternative<x86::Register>(rhs);
+
+    if (isFlt) {
+        static const std::unordered_map<std::string, x86::Opcode> arithmetic = {
+            {"+", x86::Opcode::ADDSS},
+            {"-", x86::Opcode::SUBSS},
+            {"*", x86::Opcode::MULSS},
+            {"/", x86::Opcode::DIVSS},
+        };
+
+        if (arithmetic.contains(op)) {
+            emit(arithmetic.at(op), x86::xmm(0), rhs);
+            return;
+        }
+
+        if (operand) {
+            emit(x86::Opcode::MOVSS, x86::xmm(1), rhs);
+        }
+
+        // unordered (NaN) operands compare false, except for !=
+        if (op == ">" || op == ">=") {
+            emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+            emitCond(x86::Opcode::SETCC, op == ">" ? x86::Cond::A : x86::Cond::AE, x86::AL);
+        }
+        else if (op == "<" || op == "<=") {
+            emit(x86::Opcode::UCOMISS, x86::xmm(1), x86::xmm(0));
+            emitCond(x86::Opcode::SETCC, op == "<" ? x86::Cond::A : x86::Cond::AE, x86::AL);
+        }
+        else if (op == "==") {
+            emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+            emitCond(x86::Opcode::SETCC, x86::Cond::E, x86::AL);
+            emitCond(x86::Opcode::SETCC, x86::Cond::NP, x86::CL);
+            emit(x86::Opcode::AND, x86::AL, x86::CL);
+        }
+        else if (op == "!=") {
+            emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+            emitCond(x86::Opcode::SETCC, x86::Cond::NE, x86::AL);
+            emitCond(x86::Opcode::SETCC, x86::Cond::P, x86::CL);
+            emit(x86::Opcode::OR, x86::AL, x86::CL);
+        }
+        else {
+            error(std::format("unknown operator {}", op));
+        }
+        emit(x86::Opcode::MOVZX, x86::EAX, x86::AL);
+        return;
+    }
+
+    if (op == "+") {
+        emit(x86::Opcode::ADD, x86::EAX, rhs);
+    }
+    else if (op == "-") {
+        emit(x86::Opcode::SUB, x86::EAX, rhs);
+    }
+    else if (op == "*") {
+        emit(x86::Opcode::IMUL, x86::EAX, rhs);
+    }
+    else if (op == "/") {
+        if (operand) {
+            emit(x86::Opcode::MOV, x86::ECX, rhs);
+        }
+
+        // constant divisor is neither 0 nor -1 here
+        if (std::holds_alternative<x86::Immediate>(rhs)) {
+            emit(x86::Opcode::CDQ);
+            emit(x86::Opcode::IDIV, x86::ECX);
+            return;
+        }
+
+        // division by zero exits like an index out of range, x / -1 is negation, so INT_MIN / -1 wraps
+        std::string divide = newLabel();
+        std::string done   = newLabel();
+
+        emit(x86::Opcode::TEST, x86::ECX, x86::ECX);
+        emitCond(x86::Opcode::JCC, x86::Cond::E, x86::label(".Lfault"));
+        m_faultExit = true;
+
+        emit(x86::Opcode::CMP, x86::ECX, x86::imm(-1));
+        emitCond(x86::Opcode::JCC, x86::Cond::NE, x86::label(divide));
+        emit(x86::Opcode::NEG, x86::EAX);
+        emit(x86::Opcode::JMP, x86::label(done));
+        emitLabel(divide);
+        emit(x86::Opcode::CDQ);
+        emit(x86::Opcode::IDIV, x86::ECX);
+        emitLabel(done);
+    }
+    else if (intConditions.contains(op)) {
+        emit(x86::Opcode::CMP, x86::EAX, rhs);
+        emitCond(x86::Opcode::SETCC, intConditions.at(op), x86::AL);
+        emit(x86::Opcode::MOVZX, x86::EAX, x86::AL);
+    }
+    else {
+        error(std::format("unknown operator {}", op));
+    }
+}
+
+x86::Operand Interpreter::interpretOperands(const ast::ASTNodePtr& left, const ast::ASTNodePtr& right)
+{
+    bool isFlt = ast::getType(left) == ts::Type::float_t;
+
+    // right operand: immediate/memory, or evaluated first and kept on stack
+    if (std::optional<x86::Operand> operand = operandToASM(right)) {
+        interpretExpr(left);
+        return *operand;
+    }
+
+    interpretExpr(right);
+    if (isFlt) {
+        emit(x86::Opcode::SUB, x86::RSP, x86::imm(8));
+        emit(x86::Opcode::MOVSS, x86::mem(4, x86::RSP), x86::xmm(0));
+    }
+    else {
+        emit(x86::Opcode::PUSH, x86::RAX);
+    }
+
+    interpretExpr(left);
+
+    if (isFlt) {
+        emit(x86::Opcode::MOVSS, x86::xmm(1), x86::mem(4, x86::RSP));
+        emit(x86::Opcode::ADD, x86::RSP, x86::imm(8));
+        return x86::xmm(1);
+    }
+    emit(x86::Opcode::POP, x86::RCX);
+    return x86::ECX;
+}
+
+// magic number and shift of signed division by divisor >= 3 that isn't a power of two, Hacker's Delight 10-1
+static std::pair<std::int32_t, std::int32_t> magicDivisor(std::uint32_t divisor)
+{
+    const std::uint32_t two31 = 0x80000000;
+
+    // nc is the largest dividend with nc % divisor == divisor - 1
+    std::uint32_t nc = two31 - 1 - two31 % divisor;
+    std::int32_t  p  = 31;
+    std::uint32_t q1 = two31 / nc;
+    std::uint32_t r1 = two31 - q1 * nc;
+    std::uint32_t q2 = two31 / divisor;
+    std::uint32_t r2 = two31 - q2 * divisor;
+    std::uint32_t delta;
+
+    // smallest p with 2^p > nc * (divisor - 2^p % divisor)
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= nc) {
+            q1++;
+            r1 -= nc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= divisor) {
+            q2++;
+            r2 -= divisor;
+        }
+        delta = divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    return {static_cast<std::int32_t>(q2 + 1), p - 32};
+}
+
+bool Interpreter::interpretReduced(const std::string& op, const ast::ASTNodePtr& left, const ast::ASTNodePtr& right)
+{
+    if (const ast::Float* f = std::get_if<ast::Float>(&right->getData())) {
+        if (op != "*" || f->getValue() != 2.0f) {
+            return false;
+        }
+
+        interpretExpr(left);
+        emit(x86::Opcode::ADDSS, x86::xmm(0), x86::xmm(0));
+        return true;
+    }
+
+    const ast::Integer* i = std::get_if<ast::Integer>(&right->getData());
+
+    if (!i) {
+        return false;
+    }
+
+    std::int32_t value = i->getValue();
+
+    if (op == "*" && value > 1 && std::has_single_bit(static_cast<std::uint32_t>(value))) {
+        interpretExpr(left);
+        emit(x86::Opcode::SHL, x86::EAX, x86::imm(std::countr_zero(static_cast<std::uint32_t>(value))));
+        return true;
+    }
+
+    // division by zero always exits
+    if (op == "/" && value == 0) {
+        interpretExpr(left);
+        emit(x86::Opcode::JMP, x86::label(".Lfault"));
+        m_faultExit = true;
+        return true;
+    }
+    // idiv faults on INT_MIN / -1, negation wraps
+    if (op == "/" && value == -1) {
+        interpretExpr(left);
+        emit(x86::Opcode::NEG, x86::EAX);
+        return true;
+    }
+
+    if (op == "/" && value != 0 && value != 1 && value != -1 && value != std::numeric_limits<std::int32_t>::min()) {
+        interpretExpr(left);
+        interpretDivision(value);
+        return true;
+    }
+
+    return false;
+}
+
+void Interpreter::interpretDivision(std::int32_t divisor)
+{
+    std::uint32_t magnitude = divisor < 0 ? -static_cast<std::uint32_t>(divisor) : divisor;
+
+    if (std::has_single_bit(magnitude)) {
+        std::int32_t shift = std::countr_zero(magnitude);
+
+        // negative dividends are biased by 2^shift - 1, so the arithmetic shift rounds toward zero
+        emit(x86::Opcode::MOV, x86::ECX, x86::EAX);
+        if (shift > 1) {
+            emit(x86::Opcode::SAR, x86::ECX, x86::imm(31));
+        }
+        emit(x86::Opcode::SHR, x86::ECX, x86::imm(32 - shift));
+        emit(x86::Opcode::ADD, x86::EAX, x86::ECX);
+        emit(x86::Opcode::SAR, x86::EAX, x86::imm(shift));
+    }
+    else {
+        auto [magic, shift] = magicDivisor(magnitude);
+
+        // high half of the 64-bit product, the dividend is added back if the magic number exceeds INT_MAX
+        emit(x86::Opcode::MOVSXD, x86::RCX, x86::EAX);
+        emit(x86::Opcode::IMUL, x86::RAX, x86::RCX, x86::imm(magic));
+        emit(x86::Opcode::SAR, x86::RAX, x86::imm(32));
+        if (magic < 0) {
+            emit(x86::Opcode::ADD, x86::EAX, x86::ECX);
+        }
+        if (shift) {
+            emit(x86::Opcode::SAR, x86::EAX, x86::imm(shift));
+        }
+
+        // the quotient is rounded down, a negative one is rounded up instead
+        emit(x86::Opcode::MOV, x86::ECX, x86::EAX);
+        emit(x86::Opcode::SHR, x86::ECX, x86::imm(31));
+        emit(x86::Opcode::ADD, x86::EAX, x86::ECX);
+    }
+
+    if (divisor < 0) {
+        emit(x86::Opcode::NEG, x86::EAX);
+    }
+}
+
+void Interpreter::interpretCast(ts::Type from, ts::Type to)
+{
+    if (from == to) {
+        return;
+    }
+
+    if (to == ts::Type::float_t) {
+        emit(x86::Opcode::CVTSI2SS, x86::xmm(0), x86::EAX);
+    }
+    else if (from == ts::Type::float_t && to == ts::Type::bool_t) {
+        // NaN is true
+        emit(x86::Opcode::XORPS, x86::xmm(1), x86::xmm(1));
+        emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+        emitCond(x86::Opcode::SETCC, x86::Cond::NE, x86::AL);
+        emitCond(x86::Opcode::SETCC, x86::Cond::P, x86::CL);
+        emit(x86::Opcode::OR, x86::AL, x86::CL);
+        emit(x86::Opcode::MOVZX, x86::EAX, x86::AL);
+    }
+    else if (from == ts::Type::float_t) {
+        emit(x86::Opcode::CVTTSS2SI, x86::EAX, x86::xmm(0));
+        if (to == ts::Type::char_t) {
+            emit(x86::Opcode::MOVSX, x86::EAX, x86::AL);
+        }
+    }
+    else if (to == ts::Type::bool_t) {
+        emit(x86::Opcode::TEST, x86::EAX, x86::EAX);
+        emitCond(x86::Opcode::SETCC, x86::Cond::NE, x86::AL);
+        emit(x86::Opcode::MOVZX, x86::EAX, x86::AL);
+    }
+    else if (to == ts::Type::char_t) {
+        emit(x86::Opcode::MOVSX, x86::EAX, x86::AL);
+    }
+    // bool and char values are already extended to int
+}
+
+void Interpreter::interpretStore(const ast::ASTNodePtr& target, ts::Type type)
+{
+    x86::Memory dest;
+
+    if (std::holds_alternative<ast::Identifier>(target->getData())) {
+        dest = variableToASM(target);
+    }
+    else {
+        const ast::ASTNodePtr* subscript = ast::subscriptOf(target);
+        bool                   isFlt     = type == ts::Type::float_t;
+
+        // index computation overwrites the value
+        bool save = subscript && !operandToASM((*subscript)->getChildren().back());
+
+        if (save) {
+            if (isFlt) {
+                emit(x86::Opcode::SUB, x86::RSP, x86::imm(8));
+                emit(x86::Opcode::MOVSS, x86::mem(4, x86::RSP), x86::xmm(0));
+            }
+            else {
+                emit(x86::Opcode::PUSH, x86::RAX);
+            }
+        }
+        interpretIndex(target);
+        if (save) {
+            if (isFlt) {
+                emit(x86::Opcode::MOVSS, x86::xmm(0), x86::mem(4, x86::RSP));
+                emit(x86::Opcode::ADD, x86::RSP, x86::imm(8));
+            }
+            else {
+                emit(x86::Opcode::POP, x86::RAX);
+            }
+        }
+
+        dest = elementToASM(target);
+    }
+
     switch (type) {
         case ts::Type::int_t:
-            [[fallthrough]];
+            emit(x86::Opcode::MOV, dest, x86::EAX);
+            break;
         case ts::Type::float_t:
-            return "dd";
+            emit(x86::Opcode::MOVSS, dest, x86::xmm(0));
+            break;
         case ts::Type::bool_t:
             [[fallthrough]];
         case ts::Type::char_t:
-            return "db";
+            emit(x86::Opcode::MOV, dest, x86::AL);
+            break;
         default:
             error("cannot convert unknown type to assembly");
     }
 }
 
-std::string Interpreter::reservedirectiveToASM(const ts::Type& type)
+// operand of a cast to bool, which only tests for zero, or the node itself
+static const ast::ASTNodePtr& testedOperand(const ast::ASTNodePtr& node)
+{
+    const ast::ImplicitTypeCast* cast = std::get_if<ast::ImplicitTypeCast>(&node->getData());
+
+    if (cast && cast->getToCast() == ts::Type::bool_t) {
+        return node->getChildren().front();
+    }
+    return node;
+}
+
+void Interpreter::interpretCondition(const ast::ASTNodePtr& cond, const std::string& falseLabel)
+{
+    interpretJump(cond->getChildren().front(), false, falseLabel);
+}
+
+void Interpreter::interpretJump(const ast::ASTNodePtr& expr, bool jumpIf, const std::string& label)
+{
+    if (ast::isLogical(expr)) {
+        bool                   isAnd = std::get<ast::BinaryExpr>(expr->getData()).getLiteral() == "&&";
+        const ast::ASTNodePtr& left  = expr->getChildren().front();
+        const ast::ASTNodePtr& right = expr->getChildren().back();
+
+        // false left operand of && and true left operand of || already give the outcome looked for
+        if (isAnd != jumpIf) {
+            interpretJump(left, jumpIf, label);
+            interpretJump(right, jumpIf, label);
+            return;
+        }
+
+        // otherwise the left operand can only decide the opposite outcome, which skips the right one
+        std::string skipLabel = newLabel();
+
+        interpretJump(left, !jumpIf, skipLabel);
+        interpretJump(right, jumpIf, label);
+        emitLabel(skipLabel);
+        return;
+    }
+
+    // relational condition is fused with the jump
+    if (const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&expr->getData());
+        be && intConditions.contains(be->getLiteral())) {
+        interpretCompareJump(expr, jumpIf, label);
+        return;
+    }
+
+    // constant condition jumps always or never
+    if (const ast::Boolean* b = std::get_if<ast::Boolean>(&expr->getData())) {
+        if (b->getValue() == jumpIf) {
+            emit(x86::Opcode::JMP, x86::label(label));
+        }
+        return;
+    }
+
+    const ast::ASTNodePtr& tested = testedOperand(expr);
+
+    interpretExpr(tested);
+
+    if (ast::getType(tested) != ts::Type::float_t) {
+        emit(x86::Opcode::TEST, x86::EAX, x86::EAX);
+        emitCond(x86::Opcode::JCC, jumpIf ? x86::Cond::NE : x86::Cond::E, x86::label(label));
+        return;
+    }
+
+    // NaN is true
+    emit(x86::Opcode::XORPS, x86::xmm(1), x86::xmm(1));
+    emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+    emitEqualJump(!jumpIf, label);
+}
+
+void Interpreter::interpretCompareJump(const ast::ASTNodePtr& node, bool jumpIf, const std::string& label)
+{
+    std::string            op    = std::get<ast::BinaryExpr>(node->getData()).getLiteral();
+    const ast::ASTNodePtr& left  = node->getChildren().front();
+    const ast::ASTNodePtr& right = node->getChildren().back();
+
+    bool         isFlt = ast::getType(left) == ts::Type::float_t;
+    x86::Operand rhs   = interpretOperands(left, right);
+
+    if (!isFlt) {
+        x86::Cond cond = intConditions.at(op);
+
+        emit(x86::Opcode::CMP, x86::EAX, rhs);
+        emitCond(x86::Opcode::JCC, jumpIf ? cond : x86::negate(cond), x86::label(label));
+        return;
+    }
+
+    if (!std::holds_alternative<x86::Register>(rhs)) {
+        emit(x86::Opcode::MOVSS, x86::xmm(1), rhs);
+    }
+
+    if (op == "==" || op == "!=") {
+        emit(x86::Opcode::UCOMISS, x86::xmm(0), x86::xmm(1));
+        emitEqualJump((op == "==") == jumpIf, label);
+        return;
+    }
+
+    // a and ae are false for unordered (NaN) operands, their negations be and b are true
+    bool      less = op == "<" || op == "<=";
+    x86::Cond cond = op == ">" || op == "<" ? x86::Cond::A : x86::Cond::AE;
+
+    emit(x86::Opcode::UCOMISS, less ? x86::xmm(1) : x86::xmm(0), less ? x86::xmm(0) : x86::xmm(1));
+    emitCond(x86::Opcode::JCC, jumpIf ? cond : x86::negate(cond), x86::label(label));
+}
+
+void Interpreter::interpretLogical(const ast::ASTNodePtr& node)
+{
+    bool isAnd = std::get<ast::BinaryExpr>(node->getData()).getLiteral() == "&&";
+
+    // operands are bool, casts from int and char are replaced by the test, float is tested by its cast
+    auto test = [this](const ast::ASTNodePtr& operand)
+    {
+        const ast::ASTNodePtr& tested = testedOperand(operand);
+
+        interpretExpr(ast::getType(tested) == ts::Type::float_t ? operand : tested);
+        emit(x86::Opcode::TEST, x86::EAX, x86::EAX);
+    };
+
+    // the left operand decides when it's false for && and true for ||,
+    // at the end flags are of the operand that decided
+    std::string endLabel = newLabel();
+
+    test(node->getChildren().front());
+    emitCond(x86::Opcode::JCC, isAnd ? x86::Cond::E : x86::Cond::NE, x86::label(endLabel));
+    test(node->getChildren().back());
+    emitLabel(endLabel);
+
+    emitCond(x86::Opcode::SETCC, x86::Cond::NE, x86::AL);
+    emit(x86::Opcode::MOVZX, x86::EAX, x86::AL);
+}
+
+void Interpreter::interpretBranch(const ast::ASTNodePtr& node)
+{
+    const ast::ASTNodePtr& cond    = node->getChildren().front()->getChildren().front();
+    bool                   hasElse = node->getChildren().size() == 3;
+
+    // runs of the arms, a missing else arm runs when the condition is false
+    std::uint64_t thenCount = profileCount(node.get(), 0);
+    std::uint64_t elseCount = profileCount(node.get(), 1);
+
+    auto arm = [&node, this](std::size_t i)
+    {
+        interpretCount(node.get(), i);
+        if (i + 1 < node->getChildren().size()) {
+            interpretNode(*std::next(node->getChildren().begin(), i + 1));
+        }
+    };
+
+    std::string endLabel = newLabel();
+
+    // a cold arm is jumped to and jumps back, the other one falls through
+    if (thenCount * COLD_RATIO < elseCount || (hasElse && elseCount * COLD_RATIO < thenCount)) {
+        std::size_t cold      = thenCount < elseCount ? 0 : 1;
+        std::string coldLabel = newLabel();
+
+        m_coldBlocks.push_back({coldLabel, node, cold, endLabel});
+        interpretJump(cond, cold == 0, coldLabel);
+        arm(1 - cold);
+    }
+    // else arm is more frequent, it falls through
+    else if (hasElse && elseCount > thenCount) {
+        std::string thenLabel = newLabel();
+
+        interpretJump(cond, true, thenLabel);
+        arm(1);
+        emit(x86::Opcode::JMP, x86::label(endLabel));
+        emitLabel(thenLabel);
+        arm(0);
+    }
+    else {
+        // instrumented code counts the missing else arm too
+        bool        needsElse = hasElse || !m_profilePath.empty();
+        std::string elseLabel = needsElse ? newLabel() : endLabel;
+
+        interpretJump(cond, false, elseLabel);
+        arm(0);
+
+        if (needsElse) {
+            emit(x86::Opcode::JMP, x86::label(endLabel));
+            emitLabel(elseLabel);
+            arm(1);
+        }
+    }
+
+    emitLabel(endLabel);
+}
+
+void Interpreter::interpretLoop(const ast::ASTNodePtr& node)
+{
+    const ast::WhileLoop&  loop = std::get<ast::WhileLoop>(node->getData());
+    const ast::ASTNodePtr& cond = node->getChildren().front();
+
+    // scalar loop after the vector loop does the leftover iterations, their number isn't known
+    if (m_simd != SimdLevel::NONE && loop.isCounted() && loop.getCounted().vectorizable) {
+        interpretVectorLoop(node);
+    }
+    else if (loop.isCounted()) {
+        interpretCountedLoop(node);
+        return;
+    }
+
+    std::string startLabel = newLabel();
+    std::string endLabel   = newLabel();
+
+    interpretCondition(cond, endLabel);
+    emitLabel(startLabel);
+    interpretLoopBody(node);
+    interpretJump(cond->getChildren().front(), true, startLabel);
+    emitLabel(endLabel);
+}
+
+void Interpreter::interpretLoopBody(const ast::ASTNodePtr& node)
+{
+    interpretCount(node.get(), 0);
+    interpretNode(node->getChildren().back());
+}
+
+void Interpreter::interpretCountedLoop(const ast::ASTNodePtr& node)
+{
+    const ast::CountedLoop& counted = std::get<ast::WhileLoop>(node->getData()).getCounted();
+    const ast::ASTNodePtr&  var     = node->getChildren().front()->getChildren().front()->getChildren().front();
+
+    std::int64_t span   = static_cast<std::int64_t>(counted.bound) - counted.start;
+    std::int64_t trips  = span > 0 ? (span + counted.step - 1) / counted.step : 0;
+    std::int64_t unroll = counted.unrollable ? m_unroll : 1;
+
+    // a loop that never ran keeps one copy, the hottest ones get twice as many
+    if (counted.unrollable && m_profile) {
+        std::uint64_t iterations = profileCount(node.get(), 0);
+
+        if (iterations == 0) {
+            unroll = 1;
+        }
+        else if (iterations * HOT_RATIO >= m_profile->max()) {
+            unroll *= 2;
+        }
+    }
+
+    // no loop is left for a small trip count, the first iteration needs no check
+    if (trips <= unroll) {
+        for (std::int64_t i = 0; i < trips; i++) {
+            interpretLoopBody(node);
+        }
+        return;
+    }
+
+    // while var + (unroll - 1) * step < bound, each copy of the body runs with var < bound
+    std::string startLabel = newLabel();
+
+    emitLabel(startLabel);
+    for (std::int64_t i = 0; i < unroll; i++) {
+        interpretLoopBody(node);
+    }
+    emit(x86::Opcode::MOV, x86::EAX, variableToASM(var));
+    emit(x86::Opcode::CMP, x86::EAX, x86::imm(counted.bound - (unroll - 1) * counted.step));
+    emitCond(x86::Opcode::JCC, x86::Cond::L, x86::label(startLabel));
+
+    for (std::int64_t i = 0; i < trips % unroll; i++) {
+        interpretLoopBody(node);
+    }
+}
+
+void Interpreter::interpretVectorLoop(const ast::ASTNodePtr& node)
+{
+    const ast::CountedLoop& counted = std::get<ast::WhileLoop>(node->getData()).getCounted();
+    const ast::ASTNodePtr&  var     = node->getChildren().front()->getChildren().front()->getChildren().front();
+
+    std::int64_t width = m_simd == SimdLevel::AVX2 ? 8 : 4;
+    bool         avx   = m_simd == SimdLevel::AVX2;
+
+    std::string startLabel = newLabel();
+    std::string endLabel   = newLabel();
+
+    // while (var <= bound - width)
+    emitLabel(startLabel);
+    emit(x86::Opcode::MOV, x86::EAX, variableToASM(var));
+    emit(x86::Opcode::CMP, x86::EAX, x86::imm(counted.bound - width));
+    emitCond(x86::Opcode::JCC, x86::Cond::G, x86::label(endLabel));
+    emit(x86::Opcode::MOVSXD, x86::RCX, x86::EAX);
+    interpretCount(node.get(), 0, width);
+
+    for (const ast::ASTNodePtr& s : node->getChildren().back()->getChildren()) {
+        if (!std::holds_alternative<ast::BinaryExpr>(s->getData())) {
+            continue;
+        }
+
+        const ast::ASTNodePtr& target = s->getChildren().front();
+
+        // the induction variable increment is left to the vector loop
+        if (!std::holds_alternative<ast::BinaryExpr>(target->getData())) {
+            continue;
+        }
+
+        ts::Type type = ast::getType(target);
+
+        interpretVectorExpr(s->getChildren().back(), type, 0);
+
+        x86::Opcode store = type == ts::Type::float_t ? (avx ? x86::Opcode::VMOVUPS : x86::Opcode::MOVUPS)
+                                                      : (avx ? x86::Opcode::VMOVDQU : x86::Opcode::MOVDQU);
+        emit(store, elementToASM(target, false), avx ? x86::ymm(0) : x86::xmm(0));
+    }
+
+    emit(x86::Opcode::ADD, variableToASM(var), x86::imm(width));
+    emit(x86::Opcode::JMP, x86::label(startLabel));
+    emitLabel(endLabel);
+
+    if (avx) {
+        emit(x86::Opcode::VZEROUPPER);
+    }
+}
+
+void Interpreter::interpretVectorExpr(const ast::ASTNodePtr& node, ts::Type type, std::size_t reg)
+{
+    bool          avx   = m_simd == SimdLevel::AVX2;
+    bool          isFlt = type == ts::Type::float_t;
+    x86::Register r     = avx ? x86::ymm(reg) : x86::xmm(reg);
+    x86::Register x     = x86::xmm(reg);
+
+    std::visit(
+        [&](auto&& arg) -> void
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            // scalars are broadcasted to all lanes
+            if constexpr (std::is_same_v<T, ast::Integer>) {
+                emit(x86::Opcode::MOV, x86::EAX, x86::imm(arg.getValue()));
+                if (avx) {
+                    emit(x86::Opcode::VMOVD, x, x86::EAX);
+                    emit(x86::Opcode::VPBROADCASTD, r, x);
+                }
+                else {
+                    emit(x86::Opcode::MOVD, x, x86::EAX);
+                    emit(x86::Opcode::PSHUFD, x, x, x86::imm(0));
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::Float>) {
+                if (avx) {
+                    emit(x86::Opcode::VBROADCASTSS, r, floatToASM(arg.getValue()));
+                }
+                else {
+                    emit(x86::Opcode::MOVSS, x, floatToASM(arg.getValue()));
+                    emit(x86::Opcode::SHUFPS, x, x, x86::imm(0));
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                x86::Memory var = variableToASM(node);
+
+                if (avx) {
+                    emit(isFlt ? x86::Opcode::VBROADCASTSS : x86::Opcode::VPBROADCASTD, r, var);
+                }
+                else if (isFlt) {
+                    emit(x86::Opcode::MOVSS, x, var);
+                    emit(x86::Opcode::SHUFPS, x, x, x86::imm(0));
+                }
+                else {
+                    emit(x86::Opcode::MOVD, x, var);
+                    emit(x86::Opcode::PSHUFD, x, x, x86::imm(0));
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                std::string op = arg.getLiteral();
+
+                if (op == "[]" || op == ".") {
+                    x86::Opcode load = isFlt ? (avx ? x86::Opcode::VMOVUPS : x86::Opcode::MOVUPS)
+                                             : (avx ? x86::Opcode::VMOVDQU : x86::Opcode::MOVDQU);
+                    emit(load, r, elementToASM(node, false));
+                    return;
+                }
+
+                interpretVectorExpr(node->getChildren().front(), type, reg);
+                interpretVectorExpr(node->getChildren().back(), type, reg + 1);
+
+                // sse and avx forms
+                using OpcodePair = std::pair<x86::Opcode, x86::Opcode>;
+
+                static const std::unordered_map<std::string, OpcodePair> intOps = {
+                    {"+", {x86::Opcode::PADDD, x86::Opcode::VPADDD}},
+                    {"-", {x86::Opcode::PSUBD, x86::Opcode::VPSUBD}},
+                };
+                static const std::unordered_map<std::string, OpcodePair> floatOps = {
+                    {"+", {x86::Opcode::ADDPS, x86::Opcode::VADDPS}},
+                    {"-", {x86::Opcode::SUBPS, x86::Opcode::VSUBPS}},
+                    {"*", {x86::Opcode::MULPS, x86::Opcode::VMULPS}},
+                    {"/", {x86::Opcode::DIVPS, x86::Opcode::VDIVPS}},
+                };
+
+                x86::Register rhs = avx ? x86::ymm(reg + 1) : x86::xmm(reg + 1);
+
+                // pmulld is SSE4.1, SSE2 multiplies even and odd lanes to 64 bits with pmuludq
+                // and gathers the low halves, operands are at most MAX_VECTOR_DEPTH deep, so xmm(reg + 2) exists
+                if (!isFlt && op == "*") {
+                    if (avx) {
+                        emit(x86::Opcode::VPMULLD, r, r, rhs);
+                        return;
+                    }
+                    x86::Register odd = x86::xmm(reg + 2);
+
+                    emit(x86::Opcode::PSHUFD, odd, r, x86::imm(0xF5));
+                    emit(x86::Opcode::PMULUDQ, r, rhs);
+                    emit(x86::Opcode::PSHUFD, rhs, rhs, x86::imm(0xF5));
+                    emit(x86::Opcode::PMULUDQ, odd, rhs);
+                    emit(x86::Opcode::PSHUFD, r, r, x86::imm(0x08));
+                    emit(x86::Opcode::PSHUFD, odd, odd, x86::imm(0x08));
+                    emit(x86::Opcode::PUNPCKLDQ, r, odd);
+                    return;
+                }
+
+                auto [sse, vex] = isFlt ? floatOps.at(op) : intOps.at(op);
+
+                if (avx) {
+                    emit(vex, r, r, rhs);
+                }
+                else {
+                    emit(sse, r, rhs);
+                }
+            }
+            else {
+                error("expression can't be vectorized");
+            }
+        },
+        node->getData());
+}
+
+void Interpreter::interpretIndex(const ast::ASTNodePtr& node)
+{
+    const ast::ASTNodePtr* subscript = ast::subscriptOf(node);
+
+    if (!subscript) {
+        return; // member of scalar struct has constant address
+    }
+
+    const ast::ASTNodePtr& index = (*subscript)->getChildren().back();
+
+    if (ast::constantIndex(*subscript)) {
+        return; // folded into address
+    }
+
+    std::optional<x86::Operand> operand = operandToASM(index);
+
+    if (!operand) {
+        interpretExpr(index);
+        operand = x86::EAX;
+    }
+    // movsxd has no immediate form
+    else if (std::holds_alternative<x86::Immediate>(*operand)) {
+        emit(x86::Opcode::MOV, x86::ECX, *operand);
+        operand = x86::ECX;
+    }
+    emit(x86::Opcode::MOVSXD, x86::RCX, *operand);
+
+    if (std::get<ast::BinaryExpr>((*subscript)->getData()).isBoundsChecked()) {
+        const Symbol& array = *std::get<ast::Identifier>((*subscript)->getChildren().front()->getData()).getSymbol();
+
+        // negative index is a huge unsigned value
+        emit(x86::Opcode::CMP, x86::RCX, x86::imm(array.length));
+        emitCond(x86::Opcode::JCC, x86::Cond::AE, x86::label(".Lfault"));
+        m_faultExit = true;
+    }
+}
+
+x86::Memory Interpreter::variableToASM(const ast::ASTNodePtr& id)
+{
+    const ast::Identifier& identifier = std::get<ast::Identifier>(id->getData());
+    const Symbol&          sym        = *identifier.getSymbol();
+
+    if (SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_GLOBAL)) {
+        return x86::mem(sizeToASM(sym.type), identifier.getName());
+    }
+    return x86::mem(sizeToASM(sym.type), x86::RBP, -static_cast<std::int32_t>(sym.offset));
+}
+
+x86::Memory Interpreter::elementToASM(const ast::ASTNodePtr& node, bool sized)
+{
+    ast::ElementLocation   loc   = ast::elementLocation(node);
+    const ast::Identifier& array = *loc.variable;
+    const Symbol&          sym   = *array.getSymbol();
+
+    bool         global = SYMBOL_GET_FLAG(sym, SYMBOL_FLAG_GLOBAL);
+    std::uint8_t size   = sized ? sizeToASM(ast::getType(node)) : 0;
+
+    // address is base + disp + index * scale
+    std::int64_t disp  = loc.disp;
+    std::int64_t scale = loc.stride;
+
+    // member of scalar struct has no index
+    if (loc.subscript) {
+        if (const ast::Integer* i = ast::constantIndex(*loc.subscript)) {
+            disp += i->getValue() * scale;
+            scale = 0;
+        }
+        // only 1, 2, 4 and 8 can be encoded as a scale
+        else if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+            emit(x86::Opcode::IMUL, x86::RCX, x86::RCX, x86::imm(scale));
+            scale = 1;
+        }
+    }
+
+    // locals are below rbp
+    if (!global) {
+        disp -= sym.offset;
+    }
+
+    if (scale == 0) {
+        if (global) {
+            return x86::mem(size, array.getName(), disp);
+        }
+        return x86::mem(size, x86::RBP, disp);
+    }
+
+    // rip-relative address can't have an index register
+    if (global) {
+        emit(x86::Opcode::LEA, x86::RDX, x86::mem(0, array.getName()));
+        return x86::mem(size, x86::RDX, x86::RCX, scale, disp);
+    }
+    return x86::mem(size, x86::RBP, x86::RCX, scale, disp);
+}
+
+std::optional<x86::Operand> Interpreter::operandToASM(const ast::ASTNodePtr& node)
+{
+    if (const ast::Integer* i = std::get_if<ast::Integer>(&node->getData())) {
+        return x86::imm(i->getValue());
+    }
+    if (const ast::Float* f = std::get_if<ast::Float>(&node->getData())) {
+        return floatToASM(f->getValue());
+    }
+    if (const ast::Identifier* id = std::get_if<ast::Identifier>(&node->getData())) {
+        ts::Type type = id->getSymbol()->type;
+
+        // byte values need extension
+        if (type == ts::Type::int_t || type == ts::Type::float_t) {
+            return variableToASM(node);
+        }
+    }
+
+    return std::nullopt;
+}
+
+x86::Memory Interpreter::floatToASM(float value)
+{
+    std::uint32_t bits = valueToLong(value);
+
+    if (!m_floatConstants.contains(bits)) {
+        m_floatConstants[bits] = std::format("__float_{}", m_floatConstants.size());
+    }
+    return x86::mem(4, m_floatConstants[bits]);
+}
+
+std::uint8_t Interpreter::sizeToASM(const ts::Type& type)
 {
     switch (type) {
         case ts::Type::int_t:
             [[fallthrough]];
         case ts::Type::float_t:
-            return "resd";
+            return 4;
         case ts::Type::bool_t:
             [[fallthrough]];
         case ts::Type::char_t:
-            return "resb";
+            return 1;
         default:
             error("cannot convert unknown type to assembly");
     }
 }
 
+std::uint32_t Interpreter::sourceLine(const ast::ASTNodePtr& node)
+{
+    SourceManager::Position pos = m_sources->decode(node->getLocation());
+
+    if (pos.line == 0) {
+        return m_line;
+    }
+    if (m_program.source.empty()) {
+        m_program.source = pos.name;
+    }
+    return pos.line;
+}
+
+void Interpreter::emitCond(x86::Opcode op, x86::Cond cond, const x86::Operand& operand)
+{
+    m_program.text.push_back({op, cond, m_line, {operand}});
+}
+
+void Interpreter::emitEqualJump(bool equal, const std::string& label)
+{
+    if (!equal) {
+        emitCond(x86::Opcode::JCC, x86::Cond::NE, x86::label(label));
+        emitCond(x86::Opcode::JCC, x86::Cond::P, x86::label(label));
+        return;
+    }
+
+    std::string unorderedLabel = newLabel();
+
+    emitCond(x86::Opcode::JCC, x86::Cond::P, x86::label(unorderedLabel));
+    emitCond(x86::Opcode::JCC, x86::Cond::E, x86::label(label));
+    emitLabel(unorderedLabel);
+}
+
+void Interpreter::emitLabel(const std::string& name)
+{
+    emit(x86::Opcode::LABEL, x86::label(name));
+}
+
+std::string Interpreter::newLabel()
+{
+    return std::format(".L{}", m_labelCount++);
+}
+
+std::size_t Interpreter::frameSize()
+{
+    return alignTo(m_symbolTable.getFrameSize(), 32);
+}
+
 void Interpreter::error(std::string_view msg)
 {
     throw InterpretError(msg);
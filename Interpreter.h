@@ -1,14 +1,43 @@
 #pragma once
 
-#include <ostream>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
 
 #include "AST.h"
+#include "Assembly.h"
+#include "Profile.h"
+#include "SourceManager.h"
 #include "SymbolTable.h"
 
+// vector extension used for loops marked vectorizable by LoopAnalyzer
+enum class SimdLevel : std::uint8_t
+{
+    NONE, // scalar code only
+    SSE,  // 4 lanes, SSE2
+    AVX2, // 8 lanes
+};
+
 class Interpreter
 {
 public:
-    Interpreter(SymbolTable&& sm, std::ostream& out = std::cout) : m_symbolTable(std::move(sm)), m_outputStream(out) {}
+    // copies of the body of an unrollable counted loop per iteration
+    static constexpr std::size_t DEFAULT_UNROLL = 4;
+
+    // callable code is called as int() function returning the exit code, instead of being an entry point
+    // unroll 1 keeps one copy of loop bodies
+    Interpreter(SymbolTable&& sm,
+                SimdLevel     simd     = SimdLevel::SSE,
+                bool          callable = false,
+                std::size_t   unroll   = DEFAULT_UNROLL)
+    : m_symbolTable(std::move(sm)),
+      m_simd(simd),
+      m_callable(callable),
+      m_unroll(std::max<std::size_t>(unroll, 1))
+    {
+    }
     Interpreter(const Interpreter&)            = delete;
     Interpreter(Interpreter&&)                 = delete;
     Interpreter& operator=(const Interpreter&) = delete;
@@ -16,20 +45,163 @@ public:
 
     virtual ~Interpreter() {}
 
-    // interprets AST to assembly and writes it to out stream
-    void interpret(const ast::ASTNodePtr& ast);
+    // interprets AST to x86-64 program
+    const x86::Program& interpret(const ast::ASTNodePtr& ast);
+
+    SymbolTable& getSymbolTable() { return m_symbolTable; }
+
+    // counts iterations of loops and runs of branch arms, the program writes them to path when it exits
+    void instrument(std::string path, std::uint64_t sourceHash);
+    // hot arms of branches are laid out on the fall-through path, cold ones after the exit,
+    // unroll factors of counted loops follow their iteration counts; the profile must outlive the interpreter
+    void useProfile(const Profile* profile) { m_profile = profile; }
+    // instructions get source lines of the statements and expressions they come from, for debug info;
+    // sources must outlive the interpreter
+    void emitLineInfo(const SourceManager* sources) { m_sources = sources; }
+
+    // streaming: code is generated one top-level statement at a time, text of the returned
+    // program holds only the code of the last call and is printed by the caller in between
+    // the prologue subtracts FRAME_LABEL, the caller defines it as frameSize() after the text
+    const x86::Program& interpretBegin();
+    const x86::Program& interpretStatement(const ast::ASTNodePtr& statement);
+    // st is the symbol table of the semantic analyzer after the passes over all statements
+    const x86::Program& interpretEnd(SymbolTable&& st);
+
+    static constexpr const char* FRAME_LABEL   = ".Lframe";
+    static constexpr const char* PROFILE_LABEL = "__profile";
+
+    // an arm is cold if it ran COLD_RATIO times less than the other one
+    static constexpr std::uint64_t COLD_RATIO = 100;
+    // a loop is hot if it iterated at least max / HOT_RATIO times, max is the largest count of the profile
+    static constexpr std::uint64_t HOT_RATIO = 8;
+
+    // size of the stack frame for all local variables
+    std::size_t frameSize();
 
 private:
     void interpretSymbols();
     void interpretText(const ast::ASTNodePtr& ast);
+    // streamed prologue refers to FRAME_LABEL
+    void interpretPrologue(bool streamed);
+    void interpretEpilogue();
     void interpretNode(const ast::ASTNodePtr& node);
+    void interpretConstants();
+    void interpretExit(std::int32_t code);
+    // cold blocks are emitted after the exit and jump back to where they were cut out
+    void interpretColdBlocks();
+
+    // numbers branches and loops in preorder, a branch takes counters of both arms
+    void numberCounters(const ast::ASTNodePtr& node);
+    // header and path of the profile in .bss, counters start zeroed
+    void interpretProfileHeader();
+    // writes header and counters to the profile path, failure to open it is ignored
+    void interpretProfileDump();
+    // adds n to counter arm of a branch or loop if the code is instrumented
+    void interpretCount(const ast::ASTNode* node, std::size_t arm, std::int64_t n = 1);
+    // count of a profile used for layout, 0 without profile
+    std::uint64_t profileCount(const ast::ASTNode* node, std::size_t arm) const;
+    // bytes reserved for the profile
+    std::size_t profileSize() const;
+
+    // evaluates expression to eax (int, bool, char) or xmm0 (float)
+    void interpretExpr(const ast::ASTNodePtr& node);
+    void interpretBinary(const ast::ASTNodePtr& node);
+    // evaluates left operand to eax or xmm0, returns right operand:
+    // immediate or memory if it needs no evaluation, ecx or xmm1 otherwise
+    x86::Operand interpretOperands(const ast::ASTNodePtr& left, const ast::ASTNodePtr& right);
+    void interpretCast(ts::Type from, ts::Type to);
+
+    // strength reduction: int multiplication by a power of two is a shift, division by a constant is a
+    // multiplication by its magic number, float x * 2 is x + x; false if the operation has no cheaper form
+    bool interpretReduced(const std::string& op, const ast::ASTNodePtr& left, const ast::ASTNodePtr& right);
+    // eax / divisor rounded toward zero, divisor isn't 0, 1, -1 or INT_MIN
+    void interpretDivision(std::int32_t divisor);
+
+    // stores eax or xmm0 to variable or array element
+    void interpretStore(const ast::ASTNodePtr& target, ts::Type type);
 
-    std::string definedirectiveToASM(const ts::Type& type);
-    std::string reservedirectiveToASM(const ts::Type& type);
+    // jumps to falseLabel if condition is false
+    void interpretCondition(const ast::ASTNodePtr& cond, const std::string& falseLabel);
+    // jumps to label if expression equals jumpIf, && and || short-circuit without values of their own
+    void interpretJump(const ast::ASTNodePtr& expr, bool jumpIf, const std::string& label);
+    // cmp or ucomiss of relational operands and the jcc taken when the comparison equals jumpIf
+    void interpretCompareJump(const ast::ASTNodePtr& node, bool jumpIf, const std::string& label);
+    // && and || as a value in eax
+    void interpretLogical(const ast::ASTNodePtr& node);
+
+    void interpretBranch(const ast::ASTNodePtr& node);
+
+    // loops are rotated: the condition is checked before the first iteration and by the back edge
+    void interpretLoop(const ast::ASTNodePtr& node);
+    // one copy of the body, counted as an iteration if instrumented
+    void interpretLoopBody(const ast::ASTNodePtr& node);
+    // counted loop with known trip count, unrolled by m_unroll, leftover iterations follow as straight code
+    void interpretCountedLoop(const ast::ASTNodePtr& node);
+
+    // packed loop for vectorizable counting loop, leftover iterations are done by the scalar loop
+    void interpretVectorLoop(const ast::ASTNodePtr& node);
+    void interpretVectorExpr(const ast::ASTNodePtr& node, ts::Type type, std::size_t reg);
+
+    // loads array index of element or member access to rcx, checks bounds if needed
+    void interpretIndex(const ast::ASTNodePtr& node);
+
+    // memory operand of a scalar variable
+    x86::Memory variableToASM(const ast::ASTNodePtr& id);
+    // memory operand of array element or struct member, non-constant index is expected in rcx
+    // vector loads and stores use unsized operand
+    x86::Memory elementToASM(const ast::ASTNodePtr& node, bool sized = true);
+    // source operand that doesn't need evaluation (immediate or memory)
+    std::optional<x86::Operand> operandToASM(const ast::ASTNodePtr& node);
+    // memory operand of float constant in .rodata
+    x86::Memory floatToASM(float value);
+
+    std::uint8_t sizeToASM(const ts::Type& type);
+
+    // line of node, the current line if it has no location
+    std::uint32_t sourceLine(const ast::ASTNodePtr& node);
+
+    template <typename... Operands>
+    void emit(x86::Opcode op, Operands&&... operands)
+    {
+        m_program.text.push_back({op, x86::Cond::E, m_line, {x86::Operand(std::forward<Operands>(operands))...}});
+    }
+    // setcc and jcc
+    void emitCond(x86::Opcode op, x86::Cond cond, const x86::Operand& operand);
+    // jumps after ucomiss if operands are equal or if they aren't, unordered operands aren't equal
+    void emitEqualJump(bool equal, const std::string& label);
+    void emitLabel(const std::string& name);
+
+    std::string newLabel();
 
     [[noreturn]] void error(std::string_view msg);
 
 private:
-    SymbolTable   m_symbolTable;
-    std::ostream& m_outputStream;
+    SymbolTable  m_symbolTable;
+    SimdLevel    m_simd;
+    bool         m_callable;
+    std::size_t  m_unroll;
+    x86::Program m_program;
+
+    std::size_t                          m_labelCount    = 0;
+    bool                                 m_faultExit     = false; // exit of failed bounds checks and division by zero
+    std::map<std::uint32_t, std::string> m_floatConstants;        // float bits -> label in .rodata
+
+    // arm of a branch cut out of the hot path
+    struct ColdBlock
+    {
+        std::string     label;
+        ast::ASTNodePtr branch;
+        std::size_t     arm; // 0 - then, 1 - else
+        std::string     returnLabel;
+    };
+
+    std::string                                          m_profilePath;      // empty if not instrumented
+    std::uint64_t                                        m_sourceHash   = 0;
+    const Profile*                                       m_profile      = nullptr;
+    std::unordered_map<const ast::ASTNode*, std::size_t> m_counters;         // branch or loop -> its first counter
+    std::size_t                                          m_counterCount = 0;
+    std::vector<ColdBlock>                               m_coldBlocks;       // emitted after the exit
+
+    const SourceManager* m_sources = nullptr; // no line info without sources
+    std::uint32_t        m_line    = 0;       // line of emitted instructions
 };
@@ -0,0 +1,107 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <format>
+
+#include "Common.h"
+#include "Encoder.h"
+#include "Jit.h"
+#include "Profiler.h"
+
+Jit::~Jit()
+{
+    if (m_memory) {
+        munmap(m_memory, m_size);
+    }
+}
+
+void Jit::load(const x86::Program& program)
+{
+    TimeScope scope("jit load");
+
+    Encoder encoder;
+    encoder.encode(program.text);
+
+    const std::vector<std::uint8_t>& code = encoder.getCode();
+
+    m_dataSize = 0;
+    m_data.clear();
+    m_offsets.clear();
+
+    layoutVariables(program.data);
+    layoutVariables(program.bss);
+    layoutVariables(program.rodata);
+
+    std::size_t page = sysconf(_SC_PAGESIZE);
+
+    m_codeSize = alignTo(code.size(), page);
+    m_size     = m_codeSize + alignTo(std::max<std::size_t>(m_dataSize, 1), page);
+
+    void* memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        error(std::format("mmap failed: {}", std::strerror(errno)));
+    }
+    m_memory = static_cast<std::uint8_t*>(memory);
+
+    std::memcpy(m_memory, code.data(), code.size());
+    std::memcpy(m_memory + m_codeSize, m_data.data(), m_data.size());
+
+    // S + A - P
+    for (const Relocation& r : encoder.getRelocations()) {
+        std::uint8_t* target = static_cast<std::uint8_t*>(address(r.symbol));
+        std::int64_t  value  = target + r.addend - (m_memory + r.offset);
+
+        std::int32_t disp = static_cast<std::int32_t>(value);
+        std::memcpy(m_memory + r.offset, &disp, sizeof(disp));
+    }
+
+    if (mprotect(m_memory, m_codeSize, PROT_READ | PROT_EXEC) != 0) {
+        error(std::format("mprotect failed: {}", std::strerror(errno)));
+    }
+}
+
+int Jit::run()
+{
+    TimeScope scope("jit run");
+
+    if (!m_memory) {
+        error("program is not loaded");
+    }
+
+    auto entry = reinterpret_cast<int (*)()>(m_memory);
+
+    return entry();
+}
+
+void* Jit::address(const std::string& name) const
+{
+    auto it = m_offsets.find(name);
+
+    if (it == m_offsets.end()) {
+        throw InterpretError(std::format("undefined symbol {}", name));
+    }
+    return m_memory + m_codeSize + it->second;
+}
+
+void Jit::layoutVariables(const std::vector<x86::Variable>& vars)
+{
+    for (const x86::Variable& v : vars) {
+        m_dataSize        = alignTo(m_dataSize, v.align);
+        m_offsets[v.name] = m_dataSize;
+
+        m_data.resize(m_dataSize);
+        for (std::uint32_t i = 0; i < v.count; i++) {
+            for (std::uint32_t b = 0; b < v.unit; b++) {
+                m_data.push_back(static_cast<std::uint8_t>(v.value >> (8 * b)));
+            }
+        }
+
+        m_dataSize += v.unit * v.count;
+    }
+}
+
+void Jit::error(std::string_view msg)
+{
+    throw InterpretError(msg);
+}
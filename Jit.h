@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Assembly.h"
+
+// runs program in the current process
+// code and globals are placed in one mapping, so rip-relative references reach the globals;
+// the code part is made read-only and executable after relocation
+class Jit
+{
+public:
+    Jit() {}
+    ~Jit();
+
+    Jit(const Jit&)            = delete;
+    Jit(Jit&&)                 = delete;
+    Jit& operator=(const Jit&) = delete;
+    Jit& operator=(Jit&&)      = delete;
+
+    // program must be generated as callable
+    void load(const x86::Program& program);
+
+    // returns exit code of the program
+    int run();
+
+    // address of global variable in the data segment
+    void* address(const std::string& name) const;
+
+private:
+    void layoutVariables(const std::vector<x86::Variable>& vars);
+
+    [[noreturn]] void error(std::string_view msg);
+
+private:
+    std::uint8_t* m_memory   = nullptr;
+    std::size_t   m_size     = 0;
+    std::size_t   m_codeSize = 0; // code pages at the beginning of mapping
+
+    std::size_t                                  m_dataSize = 0;
+    std::vector<std::uint8_t>                    m_data; // initial contents of data segment
+    std::unordered_map<std::string, std::size_t> m_offsets; // variable -> offset in data segment
+};
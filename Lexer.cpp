@@ -1,9 +1,14 @@
 #include <cctype>
+#include <cstdint>
 #include <cstdlib>
 #include <format>
+
+#ifdef DEBUG
 #include <iostream>
+#endif
 
 #include "Lexer.h"
+#include "Profiler.h"
 
 const std::unordered_map<std::string_view, TokenKind> Lexer::m_punctuators = {
     {"(",  TokenKind::LPAREN },
@@ -38,6 +43,7 @@ const std::unordered_map<std::string_view, TokenKind> Lexer::m_keywords = {
     {"true",   TokenKind::KW_TRUE  },
     {"false",  TokenKind::KW_FALSE },
     {"while",  TokenKind::KW_WHILE },
+    {"struct", TokenKind::KW_STRUCT},
 };
 
 const std::unordered_map<std::string_view, TokenKind> Lexer::m_types = {
@@ -51,32 +57,110 @@ Lexer::Lexer() {}
 
 /* virtual */ Lexer::~Lexer() {}
 
-std::list<Token> Lexer::tokenize(std::string_view source)
+std::list<Token> Lexer::tokenize(std::string_view source, std::uint32_t base)
 {
+    TimeScope scope("lex");
+
+#ifdef DEBUG
     std::cout << "Lexer::tokenize() called" << std::endl;
+#endif
 
     std::list<Token> tokens;
 
-    std::string lexeme;
+    start(source, base);
+    lex(tokens, SIZE_MAX);
+
+#ifdef DEBUG
+    std::cout << "Lexer::tokenize() success" << std::endl;
+#endif
+
+    return tokens;
+}
+
+void Lexer::start(std::string_view source, std::uint32_t base)
+{
+    m_source = source;
+    m_pos    = 0;
+    m_base   = base;
+    m_in     = nullptr;
+    m_state  = State::START;
+    m_end    = base;
+    m_done   = false;
+    m_lexeme.clear();
+}
+
+void Lexer::start(std::istream& in, std::uint32_t base)
+{
+    start(std::string_view(), base);
+    m_in = &in;
+}
+
+bool Lexer::refill()
+{
+    if (!m_in) {
+        return false;
+    }
 
-    State currentState = State::START;
-    State lastState    = State::START; // state before next State::START
-                                       // needed for adding token to output list
+    m_base += m_source.size();
 
-    std::string_view::const_iterator it        = source.cbegin(); // current char
-    std::string_view::const_iterator lineStart = source.cbegin(); //
+    m_chunk.resize(CHUNK_SIZE);
+    m_in->read(m_chunk.data(), m_chunk.size());
+    m_chunk.resize(m_in->gcount());
 
-    std::size_t line = 1;
+    // one past the end is the location of end of input, as in SourceManager
+    if (m_chunk.size() >= Location::NONE - m_base) {
+        throw InterpretError("sources larger than 4 GiB are not supported");
+    }
+
+    m_source = m_chunk;
+    m_pos    = 0;
+
+    return !m_source.empty();
+}
+
+bool Lexer::lex(std::list<Token>& tokens, std::size_t count)
+{
+    if (m_done) {
+        return false;
+    }
+
+    // state is kept in locals while lexing, members are only used between calls
+    std::string_view source = m_source;
+    std::size_t      pos    = m_pos;
+    State            state  = m_state;
+    std::string      lexeme = std::move(m_lexeme);
+
+    State lastState; // state before next State::START
+                     // needed for adding token to output list
+
+    // offset of current char
+    auto offset = [&] { return static_cast<std::uint32_t>(m_base + pos); };
 
     while (true) {
-        if (it == source.cend() && lexeme.empty()) {
+        bool end = false;
+
+        if (pos == source.size()) {
+            m_pos  = pos;
+            end    = !refill();
+            source = m_source;
+            pos    = m_pos;
+        }
+
+        if (end && lexeme.empty()) {
             break;
         }
 
-        lastState    = currentState;
-        currentState = move(currentState, *it);
+        // end of input reads as '\0', which ends the last lexeme, source may not be null-terminated
+        char c = end ? '\0' : source[pos];
+
+        if (end && (state == State::OPEN_QUOTE || state == State::STRING_CONST)) {
+            throw LexicalError({offset()}, "unterminated string");
+        }
 
-        switch (currentState) {
+        lastState = state;
+        state     = move(state, c);
+
+        switch (state) {
             case State::START:
             {
                 // add previous lexeme to output list
@@ -90,12 +174,22 @@ std::list<Token> Lexer::tokenize(std::string_view source)
                     }
 
                     else if (lastState == State::PUNCTUATOR) {
-                        if (this->isPunctuator(lexeme))
-                            tokens.emplace_back(m_punctuators.at(lexeme));
-                        else {
-                            for (char c : lexeme) {
-                                tokens.emplace_back(m_punctuators.at(std::string_view(&c, 1)));
+                        // longest punctuator first, ">=(" is ">=" and "(", every one has its own location
+                        std::uint32_t start = offset() - lexeme.length();
+
+                        for (std::size_t p = 0; p < lexeme.size();) {
+                            std::string_view s = std::string_view(lexeme).substr(p, 2);
+                            if (!this->isPunctuator(s)) {
+                                s = s.substr(0, 1);
                             }
+                            if (!this->isPunctuator(s)) {
+                                throw LexicalError({static_cast<std::uint32_t>(start + p)},
+                                                   std::format("invalid token: {}", s));
+                            }
+
+                            tokens.emplace_back(m_punctuators.at(s));
+                            tokens.back().setLoc({static_cast<std::uint32_t>(start + p)});
+                            p += s.size();
                         }
                     }
 
@@ -120,15 +214,22 @@ std::list<Token> Lexer::tokenize(std::string_view source)
                     }
 
                     else {
-                        throw LexicalError({line, static_cast<std::size_t>(it - lineStart) + 1},
-                                           std::format("Invalid token: {}", lexeme));
+                        throw LexicalError({offset()}, std::format("Invalid token: {}", lexeme));
                     }
 
-                    std::size_t col = it - lineStart - lexeme.length() + 1;
-                    tokens.back().setLoc({line, col});
+                    if (lastState != State::PUNCTUATOR) {
+                        tokens.back().setLoc({static_cast<std::uint32_t>(offset() - lexeme.length())});
+                    }
+                    m_end = tokens.back().getLoc().offset + 1;
+
+                    lexeme.clear();
+                    if (--count == 0) {
+                        m_pos    = pos;
+                        m_state  = state;
+                        m_lexeme = std::move(lexeme);
+                        return true;
+                    }
                 }
-
-                lexeme.clear();
                 break;
             }
 
@@ -141,41 +242,32 @@ std::list<Token> Lexer::tokenize(std::string_view source)
             case State::STRING_CONST:
                 [[fallthrough]];
             case State::PUNCTUATOR:
-                lexeme += *it;
+                lexeme += c;
                 [[fallthrough]];
             case State::SPACE:
-                if (*it == '\n') {
-                    line++;
-                    lineStart = it + 1;
-                }
                 [[fallthrough]];
             case State::OPEN_QUOTE:
                 [[fallthrough]];
             case State::CLOSE_QUOTE:
                 [[fallthrough]];
             case State::COMMENT:
-                it++;
+                pos++;
                 break;
             case State::ERROR:
-                throw LexicalError({line, static_cast<std::size_t>(it - lineStart) + 1},
-                                   std::format("invalid token: {}", *it));
+                throw LexicalError({offset()}, std::format("invalid token: {}", c));
         }
     }
 
-    Location last = tokens.back().getLoc();
     tokens.emplace_back(TokenKind::EOS);
-    tokens.back().setLoc({last.line, last.col + 1});
-
-    std::cout << "Lexer::tokenize() success" << std::endl;
+    tokens.back().setLoc({m_end});
+    m_done = true;
 
-    return tokens;
+    return false;
 }
 
 // state transition function
 Lexer::State Lexer::move(State s, char c) noexcept
 {
-    static char opened = '\0'; // for double symbols (quotes, etc)
-
     switch (s) {
         case State::START:
             if (std::isspace(c)) {
@@ -194,7 +286,7 @@ Lexer::State Lexer::move(State s, char c) noexcept
                 return State::COMMENT;
             }
             if (c == '\"') {
-                opened = c;
+                m_opened = c;
                 return State::OPEN_QUOTE;
             }
 
@@ -222,7 +314,7 @@ Lexer::State Lexer::move(State s, char c) noexcept
             return State::FLOATING_CONST;
 
         case State::OPEN_QUOTE:
-            if (c == opened) {
+            if (c == m_opened) {
                 return State::CLOSE_QUOTE;
             }
 
@@ -230,7 +322,7 @@ Lexer::State Lexer::move(State s, char c) noexcept
 
         // words in double quotes
         case State::STRING_CONST:
-            if (c == opened) {
+            if (c == m_opened) {
                 return State::CLOSE_QUOTE;
             }
 
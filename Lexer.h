@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <format>
+#include <istream>
 #include <list>
 #include <string>
 #include <string_view>
@@ -20,7 +21,19 @@ public:
 
     virtual ~Lexer();
 
-    std::list<Token> tokenize(std::string_view source);
+    // locations are offsets in source plus base, see SourceManager
+    std::list<Token> tokenize(std::string_view source, std::uint32_t base = 0);
+
+    // on demand lexing, start() sets the input and lex() produces its tokens
+    // source must outlive lexing, a stream is read in chunks of CHUNK_SIZE
+    void start(std::string_view source, std::uint32_t base = 0);
+    void start(std::istream& in, std::uint32_t base = 0);
+
+    // appends at least count tokens unless input ends, the last one is EOS
+    // returns false when EOS has been appended
+    bool lex(std::list<Token>& tokens, std::size_t count);
+
+    static constexpr std::size_t CHUNK_SIZE = 1 << 16;
 
 private:
     // for lexer state machine
@@ -49,11 +62,27 @@ private:
     // transition between states
     State move(State s, char c) noexcept;
 
+    // reads next chunk of stream, false at end of input
+    bool refill();
+
 private:
     static const std::unordered_map<std::string_view, TokenKind> m_punctuators;
 
     // chars that can be used in punctuators
-    const std::string m_punctuatorsChars = "(){}[]!;.,*/-+=><";
+    const std::string m_punctuatorsChars = "(){}[]!;.,*/-+=><&|";
+
+    char m_opened = '\0'; // for double symbols (quotes, etc)
+
+    // input and state of lexing between calls of lex()
+    std::string_view m_source;               // current chunk of stream or whole source
+    std::size_t      m_pos   = 0;            // current char in m_source
+    std::uint32_t    m_base  = 0;            // offset of m_source
+    std::istream*    m_in    = nullptr;      // nullptr if source is given whole
+    std::string      m_chunk;                // buffer of stream
+    std::string      m_lexeme;
+    State            m_state = State::START;
+    std::uint32_t    m_end   = 0;            // location of EOS, after the last token
+    bool             m_done  = true;         // EOS has been appended
 
     static const std::unordered_map<std::string_view, TokenKind> m_keywords;
     static const std::unordered_map<std::string_view, TokenKind> m_types;
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <limits>
+#include <variant>
+
+#include "LoopAnalyzer.h"
+
+// symbol of identifier node, nullptr for other nodes
+static std::shared_ptr<Symbol> symbolOf(const ast::ASTNodePtr& node)
+{
+    const ast::Identifier* id = std::get_if<ast::Identifier>(&node->getData());
+    return id ? id->getSymbol() : nullptr;
+}
+
+static std::optional<std::int32_t> constantOf(const ast::ASTNodePtr& node)
+{
+    if (const ast::Integer* i = std::get_if<ast::Integer>(&node->getData())) {
+        return i->getValue();
+    }
+    return std::nullopt;
+}
+
+static bool isBinary(const ast::ASTNodePtr& node, std::string_view op)
+{
+    const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&node->getData());
+    return be && be->getLiteral() == op;
+}
+
+void LoopAnalyzer::analyze(ast::ASTNodePtr& node)
+{
+    // inner loops first, so outer loops see their final state
+    for (ast::ASTNodePtr& c : node->getChildren()) {
+        analyze(c);
+    }
+
+    if (std::holds_alternative<ast::WhileLoop>(node->getData())) {
+        analyzeLoop(node);
+    }
+    else if (m_streaming && std::holds_alternative<ast::Declaration>(node->getData())) {
+        std::shared_ptr<Symbol> sym = symbolOf(node->getChildren().front());
+
+        if (SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_GLOBAL) && SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_ARRAY) &&
+            sym->structType && sym->structType->soa) {
+            alignForVectors(*sym);
+        }
+    }
+}
+
+void LoopAnalyzer::analyzeLoop(ast::ASTNodePtr& loop)
+{
+    const ast::ASTNodePtr& cond = loop->getChildren().front()->getChildren().front();
+    const ast::ASTNodePtr& body = loop->getChildren().back();
+
+    // condition: var < bound, var <= bound
+    bool inclusive = isBinary(cond, "<=");
+    if (!(isBinary(cond, "<") || inclusive)) {
+        return;
+    }
+
+    std::shared_ptr<Symbol>     var   = symbolOf(cond->getChildren().front());
+    std::optional<std::int32_t> bound = constantOf(cond->getChildren().back());
+
+    if (!var || !bound || var->type != ts::Type::int_t || SYMBOL_GET_FLAG((*var), SYMBOL_FLAG_ARRAY)) {
+        return;
+    }
+    if (inclusive) {
+        if (*bound == std::numeric_limits<std::int32_t>::max()) return;
+        ++*bound;
+    }
+
+    // body: ...; var = var + step;
+    std::vector<ast::ASTNodePtr> statements = bodyStatements(body);
+    if (statements.empty()) {
+        return;
+    }
+
+    std::optional<std::int32_t> step  = findStep(statements.back(), var);
+    std::optional<std::int32_t> start = findStart(loop, var);
+
+    if (!step || *step <= 0 || !start) {
+        return;
+    }
+    // var + step must not overflow before the condition is checked again
+    if (*bound > std::numeric_limits<std::int32_t>::max() - *step) {
+        return;
+    }
+
+    statements.pop_back();
+    for (const ast::ASTNodePtr& s : statements) {
+        if (assigns(s, var)) return;
+    }
+
+    // var is in [start, bound - 1] everywhere in the body except the increment
+    for (const ast::ASTNodePtr& s : statements) {
+        removeBoundsChecks(s, var, *start, static_cast<std::int64_t>(*bound) - 1);
+    }
+
+    ast::CountedLoop counted;
+    counted.start        = *start;
+    counted.bound        = *bound;
+    counted.step         = *step;
+    counted.vectorizable = *step == 1 && isVectorizable(statements, var);
+
+    if (counted.vectorizable) {
+        for (const ast::ASTNodePtr& s : statements) {
+            alignVectorArrays(s);
+        }
+    }
+
+    std::size_t size   = unrollSize(body);
+    counted.unrollable = size != 0 && size <= MAX_UNROLL_SIZE;
+
+    std::get<ast::WhileLoop>(loop->getData()).setCounted(counted);
+}
+
+std::vector<ast::ASTNodePtr> LoopAnalyzer::bodyStatements(const ast::ASTNodePtr& body)
+{
+    std::vector<ast::ASTNodePtr> statements;
+
+    for (const ast::ASTNodePtr& c : body->getChildren()) {
+        if (!(std::holds_alternative<ast::BlockStart>(c->getData()) ||
+              std::holds_alternative<ast::BlockEnd>(c->getData()))) {
+            statements.push_back(c);
+        }
+    }
+
+    return statements;
+}
+
+std::optional<std::int32_t> LoopAnalyzer::findStart(const ast::ASTNodePtr& loop, const std::shared_ptr<Symbol>& var)
+{
+    ast::ASTNodePtr parent = loop->getParent().lock();
+    if (!parent) {
+        return std::nullopt;
+    }
+
+    std::list<ast::ASTNodePtr>& siblings = parent->getChildren();
+    auto                        it       = std::ranges::find(siblings, loop);
+
+    if (it == siblings.begin()) {
+        return std::nullopt;
+    }
+
+    const ast::ASTNodePtr& prev = *std::prev(it);
+
+    // int var = start;
+    if (std::holds_alternative<ast::Declaration>(prev->getData()) && prev->getChildren().size() == 2 &&
+        symbolOf(prev->getChildren().front()) == var) {
+        return constantOf(prev->getChildren().back());
+    }
+    // var = start;
+    if (isBinary(prev, "=") && symbolOf(prev->getChildren().front()) == var) {
+        return constantOf(prev->getChildren().back());
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::int32_t> LoopAnalyzer::findStep(const ast::ASTNodePtr& stmt, const std::shared_ptr<Symbol>& var)
+{
+    if (!isBinary(stmt, "=") || symbolOf(stmt->getChildren().front()) != var) {
+        return std::nullopt;
+    }
+
+    const ast::ASTNodePtr& value = stmt->getChildren().back();
+    if (!isBinary(value, "+")) {
+        return std::nullopt;
+    }
+
+    const ast::ASTNodePtr& left  = value->getChildren().front();
+    const ast::ASTNodePtr& right = value->getChildren().back();
+
+    if (symbolOf(left) == var) {
+        return constantOf(right);
+    }
+    if (symbolOf(right) == var) {
+        return constantOf(left);
+    }
+
+    return std::nullopt;
+}
+
+bool LoopAnalyzer::assigns(const ast::ASTNodePtr& node, const std::shared_ptr<Symbol>& var)
+{
+    if (isBinary(node, "=") && symbolOf(node->getChildren().front()) == var) {
+        return true;
+    }
+
+    return std::ranges::any_of(node->getChildren(), [&](const ast::ASTNodePtr& c) { return assigns(c, var); });
+}
+
+std::size_t LoopAnalyzer::unrollSize(const ast::ASTNodePtr& node)
+{
+    if (std::holds_alternative<ast::WhileLoop>(node->getData())) {
+        return 0;
+    }
+
+    std::size_t size = 1;
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        std::size_t s = unrollSize(c);
+        if (s == 0) {
+            return 0;
+        }
+        size += s;
+    }
+
+    return size;
+}
+
+void LoopAnalyzer::removeBoundsChecks(const ast::ASTNodePtr&         node,
+                                      const std::shared_ptr<Symbol>& var,
+                                      std::int64_t                   low,
+                                      std::int64_t                   high)
+{
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        removeBoundsChecks(c, var, low, high);
+    }
+
+    if (!isBinary(node, "[]")) {
+        return;
+    }
+
+    const ast::ASTNodePtr& index = node->getChildren().back();
+
+    // index is var, var + k, k + var or var - k
+    std::optional<std::int64_t> offset;
+
+    if (symbolOf(index) == var) {
+        offset = 0;
+    }
+    else if (isBinary(index, "+") || isBinary(index, "-")) {
+        const ast::ASTNodePtr&      left  = index->getChildren().front();
+        const ast::ASTNodePtr&      right = index->getChildren().back();
+        std::optional<std::int32_t> k;
+
+        if (symbolOf(left) == var && (k = constantOf(right))) {
+            offset = isBinary(index, "+") ? *k : -static_cast<std::int64_t>(*k);
+        }
+        else if (isBinary(index, "+") && symbolOf(right) == var && (k = constantOf(left))) {
+            offset = *k;
+        }
+    }
+
+    if (!offset) {
+        return;
+    }
+
+    const Symbol& array = *symbolOf(node->getChildren().front());
+
+    if (low + *offset >= 0 && high + *offset < array.length) {
+        std::get<ast::BinaryExpr>(node->getData()).setBoundsChecked(false);
+    }
+}
+
+bool LoopAnalyzer::isVectorizable(const std::vector<ast::ASTNodePtr>& statements, const std::shared_ptr<Symbol>& var)
+{
+    if (statements.empty()) {
+        return false;
+    }
+
+    for (const ast::ASTNodePtr& s : statements) {
+        if (!isBinary(s, "=")) {
+            return false;
+        }
+
+        const ast::ASTNodePtr& target = s->getChildren().front();
+        const ast::ASTNodePtr& value  = s->getChildren().back();
+
+        if (!isUncheckedElement(target, var)) {
+            return false;
+        }
+
+        ts::Type type = ast::getType(target);
+
+        if (type != ts::Type::int_t && type != ts::Type::float_t) {
+            return false;
+        }
+        if (!isVectorizableExpr(value, var, type, 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LoopAnalyzer::isVectorizableExpr(const ast::ASTNodePtr&         node,
+                                      const std::shared_ptr<Symbol>& var,
+                                      ts::Type                       type,
+                                      std::size_t                    depth)
+{
+    if (depth > MAX_VECTOR_DEPTH || ast::getType(node) != type) {
+        return false;
+    }
+
+    return std::visit(
+        [&](auto&& arg) -> bool
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::is_same_v<T, ast::Integer> || std::is_same_v<T, ast::Float>) {
+                return true;
+            }
+            // loop-invariant scalar, broadcasted to all lanes
+            else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                return arg.getSymbol() != var && !SYMBOL_GET_FLAG((*arg.getSymbol()), SYMBOL_FLAG_ARRAY);
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                std::string op = arg.getLiteral();
+
+                if (op == "[]" || op == ".") {
+                    return isUncheckedElement(node, var);
+                }
+                // there is no packed integer division
+                if (!(op == "+" || op == "-" || op == "*" || (op == "/" && type == ts::Type::float_t))) {
+                    return false;
+                }
+
+                return isVectorizableExpr(node->getChildren().front(), var, type, depth + 1) &&
+                       isVectorizableExpr(node->getChildren().back(), var, type, depth + 1);
+            }
+
+            return false;
+        },
+        node->getData());
+}
+
+bool LoopAnalyzer::isUncheckedElement(const ast::ASTNodePtr& node, const std::shared_ptr<Symbol>& var)
+{
+    // a[var].field is contiguous only in SoA layout
+    if (isBinary(node, ".")) {
+        const ast::ASTNodePtr& element = node->getChildren().front();
+        if (!isBinary(element, "[]")) {
+            return false;
+        }
+
+        std::shared_ptr<StructType> type = symbolOf(element->getChildren().front())->structType;
+        return type->soa && isUncheckedElement(element, var);
+    }
+
+    return isBinary(node, "[]") && !std::get<ast::BinaryExpr>(node->getData()).isBoundsChecked() &&
+           symbolOf(node->getChildren().back()) == var;
+}
+
+void LoopAnalyzer::alignVectorArrays(const ast::ASTNodePtr& node)
+{
+    if (isBinary(node, ".") && isBinary(node->getChildren().front(), "[]")) {
+        std::shared_ptr<Symbol> sym = symbolOf(node->getChildren().front()->getChildren().front());
+
+        if (sym->structType->soa && !SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_VECTOR)) {
+            alignForVectors(*sym);
+        }
+    }
+
+    for (const ast::ASTNodePtr& c : node->getChildren()) {
+        alignVectorArrays(c);
+    }
+}
+
+void LoopAnalyzer::alignForVectors(Symbol& array)
+{
+    SYMBOL_SET_FLAG(array, SYMBOL_FLAG_VECTOR);
+    array.size  = array.structType->arraySize(array.length, true);
+    array.align = std::max(array.align, ts::arrayAlignment(array.size));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "AST.h"
+#include "SymbolTable.h"
+
+// works with AST, that was checked by the semantic analyzer
+// recognizes counting while loops, removes array bounds checks that
+// can't fail inside them and marks loops which bodies can be vectorized
+// SoA arrays of vectorized loops get field arrays aligned for vector access
+class LoopAnalyzer
+{
+public:
+    // streamed statements can't see the loops of later ones, so every global SoA array is aligned
+    LoopAnalyzer(bool streaming = false) : m_streaming(streaming) {}
+    ~LoopAnalyzer() {}
+
+    LoopAnalyzer(const LoopAnalyzer&)            = delete;
+    LoopAnalyzer(LoopAnalyzer&&)                 = delete;
+    LoopAnalyzer& operator=(const LoopAnalyzer&) = delete;
+    LoopAnalyzer& operator=(LoopAnalyzer&&)      = delete;
+
+    void analyze(ast::ASTNodePtr& node);
+
+    // deepest expression that can be vectorized (one vector register per level, and a scratch one)
+    static constexpr std::size_t MAX_VECTOR_DEPTH = 14;
+    // most nodes in the body of a loop that is unrolled
+    static constexpr std::size_t MAX_UNROLL_SIZE = 48;
+
+private:
+    void analyzeLoop(ast::ASTNodePtr& loop);
+
+    // loop statements without block markers
+    std::vector<ast::ASTNodePtr> bodyStatements(const ast::ASTNodePtr& body);
+
+    // value of induction variable set by the statement right before the loop
+    std::optional<std::int32_t> findStart(const ast::ASTNodePtr& loop, const std::shared_ptr<Symbol>& var);
+
+    // step of "var = var + step" statement
+    std::optional<std::int32_t> findStep(const ast::ASTNodePtr& stmt, const std::shared_ptr<Symbol>& var);
+
+    // checks if subtree contains assignment to var
+    bool assigns(const ast::ASTNodePtr& node, const std::shared_ptr<Symbol>& var);
+
+    // number of nodes in subtree, 0 if it contains a loop
+    std::size_t unrollSize(const ast::ASTNodePtr& node);
+
+    // removes checks of a[var + k] when var is in [low, high]
+    void removeBoundsChecks(const ast::ASTNodePtr&         node,
+                            const std::shared_ptr<Symbol>& var,
+                            std::int64_t                   low,
+                            std::int64_t                   high);
+
+    // loop body is a sequence of a[var] = <element-wise expression>
+    bool isVectorizable(const std::vector<ast::ASTNodePtr>& statements, const std::shared_ptr<Symbol>& var);
+    bool isVectorizableExpr(const ast::ASTNodePtr&         node,
+                            const std::shared_ptr<Symbol>& var,
+                            ts::Type                       type,
+                            std::size_t                    depth);
+
+    // a[var] or soa[var].field access without bounds check
+    bool isUncheckedElement(const ast::ASTNodePtr& node, const std::shared_ptr<Symbol>& var);
+
+    // aligns field arrays of SoA arrays accessed in subtree
+    void alignVectorArrays(const ast::ASTNodePtr& node);
+    static void alignForVectors(Symbol& array);
+
+private:
+    bool m_streaming;
+};
@@ -5,6 +5,7 @@
 #include "AST.h"
 #include "Common.h"
 #include "Parser.h"
+#include "Profiler.h"
 
 Parser::Parser() : m_ct(nullptr) {}
 
@@ -13,10 +14,14 @@ Parser::~Parser() {}
 
 ast::ASTNodePtr Parser::parse(const std::list<Token>& tokens)
 {
+    TimeScope scope("parse");
+
 #ifdef DEBUG
     std::cout << "Parser::parse() called" << std::endl;
 #endif
-    m_ct = tokens.begin();
+    m_ct     = tokens.begin();
+    m_scopes = 0;
+    m_lexer  = nullptr;
 
     auto tree = program();
 
@@ -27,16 +32,40 @@ ast::ASTNodePtr Parser::parse(const std::list<Token>& tokens)
     return tree;
 }
 
+void Parser::start(Lexer& lexer)
+{
+    m_lexer  = &lexer;
+    m_scopes = 0;
+    m_tokens.clear();
+
+    m_lexer->lex(m_tokens, TOKEN_BATCH);
+    m_ct = m_tokens.begin();
+}
+
+ast::ASTNodePtr Parser::next()
+{
+    m_tokens.erase(m_tokens.begin(), m_ct);
+
+    if (m_ct->getKind() == TokenKind::EOS) {
+        return nullptr;
+    }
+    return statement();
+}
+
 void Parser::eat(const TokenKind& token)
 {
     if (!m_ct->is(token)) {
         error();
     }
-    m_ct++;
+    eat();
 }
 
 void Parser::eat()
 {
+    // end iterator of a list doesn't move to tokens appended after it
+    if (m_lexer && std::next(m_ct) == m_tokens.end()) {
+        m_lexer->lex(m_tokens, TOKEN_BATCH);
+    }
     m_ct++;
 }
 
@@ -66,6 +95,9 @@ ast::ASTNodePtr Parser::statement()
     else if (kind == TokenKind::KW_WHILE) {
         return while_stmt();
     }
+    else if (kind == TokenKind::KW_STRUCT) {
+        return struct_stmt();
+    }
     else if (kind == TokenKind::IDENTIFIER) {
         return assignment_stmt();
     }
@@ -77,8 +109,6 @@ ast::ASTNodePtr Parser::declaration_stmt()
 {
     TokenKind kind = m_ct->getKind();
 
-    ast::ASTNodePtr decl = std::make_shared<ast::ASTNode>(ast::Declaration(TOK_TO_TYPE(kind)));
-    decl->setLocation(m_ct->getLoc());
     eat();
 
     if (m_ct->getKind() != TokenKind::IDENTIFIER) error();
@@ -86,13 +116,19 @@ ast::ASTNodePtr Parser::declaration_stmt()
     ast::Identifier id = ast::Identifier(m_ct->getString());
     id.setType(TOK_TO_TYPE(kind));
 
-    decl->addChild(std::make_shared<ast::ASTNode>(id));
-    decl->setLocation(m_ct->getLoc());
+    ast::ASTNodePtr idNode = std::make_shared<ast::ASTNode>(id);
+    idNode->setLocation(m_ct->getLoc());
 
     eat();
 
-    ast::ASTNodePtr ex = nullptr;
-    if (m_ct->getKind() == TokenKind::ASSIGN) {
+    std::uint32_t length = array_length();
+
+    ast::ASTNodePtr decl = std::make_shared<ast::ASTNode>(ast::Declaration(TOK_TO_TYPE(kind), length));
+    decl->addChild(idNode);
+    decl->setLocation(idNode->getLocation());
+
+    // arrays have no initializer
+    if (m_ct->getKind() == TokenKind::ASSIGN && length == 0) {
         eat();
         decl->addChild(expr());
     }
@@ -101,6 +137,88 @@ ast::ASTNodePtr Parser::declaration_stmt()
     return decl;
 }
 
+ast::ASTNodePtr Parser::struct_stmt()
+{
+    eat(TokenKind::KW_STRUCT);
+
+    // struct [[soa]] name { ... };
+    bool soa = false;
+    if (m_ct->getKind() == TokenKind::LSQUARE) {
+        eat();
+        eat(TokenKind::LSQUARE);
+        if (m_ct->getKind() != TokenKind::IDENTIFIER || m_ct->getString() != "soa") error();
+        eat();
+        eat(TokenKind::RSQUARE);
+        eat(TokenKind::RSQUARE);
+        soa = true;
+    }
+
+    if (m_ct->getKind() != TokenKind::IDENTIFIER) error();
+    std::string name = m_ct->getString();
+    Location    l    = m_ct->getLoc();
+    eat();
+
+    // struct definition
+    if (m_ct->getKind() == TokenKind::LBRACE) {
+        eat();
+
+        ast::StructDecl def(name, soa);
+        while (m_ct->getKind() != TokenKind::RBRACE) {
+            TokenKind kind = m_ct->getKind();
+            if (!IS_TYPENAME(kind)) error();
+            eat();
+
+            if (m_ct->getKind() != TokenKind::IDENTIFIER) error();
+            def.addField(TOK_TO_TYPE(kind), m_ct->getString());
+            eat();
+            eat(TokenKind::SEMI);
+        }
+        eat();
+        eat(TokenKind::SEMI);
+
+        ast::ASTNodePtr node = std::make_shared<ast::ASTNode>(def);
+        node->setLocation(l);
+        return node;
+    }
+
+    // attribute belongs to the definition
+    if (soa) error();
+
+    // struct name variable[N];
+    if (m_ct->getKind() != TokenKind::IDENTIFIER) error();
+
+    ast::Identifier id = ast::Identifier(m_ct->getString());
+    id.setType(ts::Type::struct_t);
+
+    ast::ASTNodePtr idNode = std::make_shared<ast::ASTNode>(id);
+    idNode->setLocation(m_ct->getLoc());
+    eat();
+
+    std::uint32_t length = array_length();
+    eat(TokenKind::SEMI);
+
+    ast::ASTNodePtr decl = std::make_shared<ast::ASTNode>(ast::Declaration(ts::Type::struct_t, length, name));
+    decl->addChild(idNode);
+    decl->setLocation(idNode->getLocation());
+
+    return decl;
+}
+
+std::uint32_t Parser::array_length()
+{
+    if (m_ct->getKind() != TokenKind::LSQUARE) {
+        return 0;
+    }
+
+    eat();
+    if (m_ct->getKind() != TokenKind::INTEGER_CONSTANT || m_ct->getInteger() <= 0) error();
+    std::uint32_t length = m_ct->getInteger();
+    eat();
+    eat(TokenKind::RSQUARE);
+
+    return length;
+}
+
 ast::ASTNodePtr Parser::branch_stmt()
 {
     Location l = m_ct->getLoc();
@@ -144,16 +262,16 @@ ast::ASTNodePtr Parser::while_stmt()
 
 ast::ASTNodePtr Parser::assignment_stmt()
 {
-    ast::ASTNodePtr id = std::make_shared<ast::ASTNode>(ast::Identifier(m_ct->getString()));
-    id->setLocation(m_ct->getLoc());
-    eat();
+    Location        l      = m_ct->getLoc();
+    ast::ASTNodePtr target = access_expr(); // variable or element access
     eat(TokenKind::ASSIGN);
     ast::ASTNodePtr ex = expr();
     eat(TokenKind::SEMI);
 
     ast::ASTNodePtr be = std::make_shared<ast::ASTNode>(ast::BinaryExpr("="));
-    be->addChild(id);
+    be->addChild(target);
     be->addChild(ex);
+    be->setLocation(l);
 
     return be;
 }
@@ -174,12 +292,77 @@ ast::ASTNodePtr Parser::expr()
         case TokenKind::LPAREN:
             [[fallthrough]];
         case TokenKind::MINUS:
-            return relation_expr();
+            return logical_or_expr();
         default:
             error(); // noreturn func
     }
 }
 
+ast::ASTNodePtr Parser::logical_or_expr()
+{
+    ast::ASTNodePtr left = logical_and_expr();
+    ast::ASTNodePtr ot   = logical_or_tail(left);
+    return ot ? ot : left;
+}
+
+ast::ASTNodePtr Parser::logical_or_tail(const ast::ASTNodePtr& left)
+{
+    TokenKind kind = m_ct->getKind();
+
+    if (kind == TokenKind::RPAREN || kind == TokenKind::RSQUARE || kind == TokenKind::SEMI) {
+        return nullptr;
+    }
+
+    // logical operators are left-associative: a || b || c is (a || b) || c
+    if (kind != TokenKind::OR) {
+        error();
+    }
+
+    Location l = m_ct->getLoc();
+    eat();
+    ast::ASTNodePtr right = logical_and_expr();
+
+    ast::ASTNodePtr op = std::make_shared<ast::ASTNode>(ast::BinaryExpr("||", ts::Type::bool_t));
+    op->addChild(left);
+    op->addChild(right);
+    op->setLocation(l);
+
+    ast::ASTNodePtr ot = logical_or_tail(op);
+    return ot ? ot : op;
+}
+
+ast::ASTNodePtr Parser::logical_and_expr()
+{
+    ast::ASTNodePtr left = relation_expr();
+    ast::ASTNodePtr at   = logical_and_tail(left);
+    return at ? at : left;
+}
+
+ast::ASTNodePtr Parser::logical_and_tail(const ast::ASTNodePtr& left)
+{
+    TokenKind kind = m_ct->getKind();
+
+    if (kind == TokenKind::OR || kind == TokenKind::RPAREN || kind == TokenKind::RSQUARE || kind == TokenKind::SEMI) {
+        return nullptr;
+    }
+
+    if (kind != TokenKind::AND) {
+        error();
+    }
+
+    Location l = m_ct->getLoc();
+    eat();
+    ast::ASTNodePtr right = relation_expr();
+
+    ast::ASTNodePtr op = std::make_shared<ast::ASTNode>(ast::BinaryExpr("&&", ts::Type::bool_t));
+    op->addChild(left);
+    op->addChild(right);
+    op->setLocation(l);
+
+    ast::ASTNodePtr at = logical_and_tail(op);
+    return at ? at : op;
+}
+
 ast::ASTNodePtr Parser::relation_expr()
 {
     switch (m_ct->getKind()) {
@@ -210,7 +393,7 @@ ast::ASTNodePtr Parser::relation_tail(const ast::ASTNodePtr& left)
 {
     TokenKind kind = m_ct->getKind();
 
-    if (kind == TokenKind::RPAREN || kind == TokenKind::RSQUARE || kind == TokenKind::SEMI) {
+    if (IS_LOGOP(kind) || kind == TokenKind::RPAREN || kind == TokenKind::RSQUARE || kind == TokenKind::SEMI) {
         return nullptr;
     }
 
@@ -327,7 +510,8 @@ ast::ASTNodePtr Parser::additive_expr()
 ast::ASTNodePtr Parser::additive_tail(const ast::ASTNodePtr& left)
 {
     TokenKind kind = m_ct->getKind();
-    if (IS_RELOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN || kind == TokenKind::SEMI) {
+    if (IS_RELOP(kind) || IS_LOGOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN ||
+        kind == TokenKind::SEMI) {
         return nullptr;
     }
 
@@ -393,8 +577,8 @@ ast::ASTNodePtr Parser::multiplicative_tail(const ast::ASTNodePtr& left)
 {
     TokenKind kind = m_ct->getKind();
 
-    if (IS_RELOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN || kind == TokenKind::PLUS ||
-        kind == TokenKind::MINUS || kind == TokenKind::SEMI) {
+    if (IS_RELOP(kind) || IS_LOGOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN ||
+        kind == TokenKind::PLUS || kind == TokenKind::MINUS || kind == TokenKind::SEMI) {
         return nullptr;
     }
 
@@ -500,39 +684,45 @@ ast::ASTNodePtr Parser::access_expr()
 ast::ASTNodePtr Parser::access_tail(const ast::ASTNodePtr& left)
 {
     TokenKind kind = m_ct->getKind();
-    if (IS_RELOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN || kind == TokenKind::PLUS ||
-        kind == TokenKind::MINUS || kind == TokenKind::STAR || kind == TokenKind::SLASH || kind == TokenKind::SEMI) {
+    if (IS_RELOP(kind) || IS_LOGOP(kind) || kind == TokenKind::RSQUARE || kind == TokenKind::RPAREN ||
+        kind == TokenKind::PLUS || kind == TokenKind::MINUS || kind == TokenKind::STAR || kind == TokenKind::SLASH ||
+        kind == TokenKind::SEMI || kind == TokenKind::ASSIGN) {
         return nullptr;
     }
 
+    // access operators are left-associative: a[i].x is (a[i]).x
     switch (kind) {
         case TokenKind::PERIOD:
         {
+            Location l = m_ct->getLoc();
             eat();
+            if (m_ct->getKind() != TokenKind::IDENTIFIER) error();
             ast::ASTNodePtr id = std::make_shared<ast::ASTNode>(ast::Identifier(m_ct->getString()));
-            eat(TokenKind::IDENTIFIER);
-            ast::ASTNodePtr at = access_tail(id);
+            id->setLocation(m_ct->getLoc());
+            eat();
 
             ast::ASTNodePtr op = std::make_shared<ast::ASTNode>(ast::BinaryExpr("."));
             op->addChild(left);
-            op->addChild(at ? at : id);
-            op->setLocation(m_ct->getLoc());
+            op->addChild(id);
+            op->setLocation(l);
 
-            return op;
+            ast::ASTNodePtr at = access_tail(op);
+            return at ? at : op;
         }
         case TokenKind::LSQUARE:
         {
+            Location l = m_ct->getLoc();
             eat();
             ast::ASTNodePtr ex = expr();
             eat(TokenKind::RSQUARE);
-            ast::ASTNodePtr at = access_tail(ex);
 
             ast::ASTNodePtr op = std::make_shared<ast::ASTNode>(ast::BinaryExpr("[]"));
             op->addChild(left);
-            op->addChild(at ? at : ex);
-            op->setLocation(m_ct->getLoc());
+            op->addChild(ex);
+            op->setLocation(l);
 
-            return op;
+            ast::ASTNodePtr at = access_tail(op);
+            return at ? at : op;
         }
         default:
             error();
@@ -10,6 +10,7 @@
 #include <variant>
 
 #include "AST.h"
+#include "Lexer.h"
 #include "SymbolTable.h"
 #include "Token.h"
 
@@ -27,6 +28,15 @@ public:
     // checks whether a given sequence of tokens satisfies a language grammar
     ast::ASTNodePtr parse(const std::list<Token>& tokens);
 
+    // streaming: top-level statements are parsed one at a time from tokens pulled from lexer
+    // tokens of a statement are freed when the next one is parsed, lexer must be started
+    void start(Lexer& lexer);
+    // next top-level statement, nullptr at end of input
+    ast::ASTNodePtr next();
+
+    // tokens pulled from lexer at a time
+    static constexpr std::size_t TOKEN_BATCH = 64;
+
     // private:
     // go to next token
     // calls error() if m_currentToken != token
@@ -40,14 +50,18 @@ public:
     ast::ASTNodePtr program(); // main parsing function
     ast::ASTNodePtr statement();
     ast::ASTNodePtr declaration_stmt();
+    ast::ASTNodePtr struct_stmt(); // struct definition or struct variable declaration
     ast::ASTNodePtr branch_stmt();
     ast::ASTNodePtr while_stmt();
     ast::ASTNodePtr assignment_stmt();
 
-    // arithmetic expressions
-    // TODO logical expressions (and, or)
+    // logical and arithmetic expressions
     // TODO bitwise expressions
     ast::ASTNodePtr expr();
+    ast::ASTNodePtr logical_or_expr();
+    ast::ASTNodePtr logical_or_tail(const ast::ASTNodePtr& left);
+    ast::ASTNodePtr logical_and_expr();
+    ast::ASTNodePtr logical_and_tail(const ast::ASTNodePtr& left);
     ast::ASTNodePtr relation_expr();
     ast::ASTNodePtr relation_tail(const ast::ASTNodePtr& left);
     ast::ASTNodePtr additive_expr();
@@ -68,7 +82,7 @@ public:
         ast::ASTNodePtr body = std::make_shared<ast::ASTNode>(T());
         if (m_ct->getKind() == TokenKind::LBRACE) {
             eat();
-            body->addChild(std::make_shared<ast::ASTNode>(ast::BlockStart()));
+            body->addChild(std::make_shared<ast::ASTNode>(ast::BlockStart(++m_scopes)));
             while (m_ct->getKind() != TokenKind::RBRACE) {
                 body->addChild(statement());
             }
@@ -81,11 +95,18 @@ public:
         return body;
     }
 
+    // optional [N] after declared name, 0 if absent
+    std::uint32_t array_length();
+
     // flow control
 
     // throw exception
     [[noreturn]] void error();
 
 private:
-    std::list<Token>::const_iterator m_ct; // current token
+    std::list<Token>::const_iterator m_ct;         // current token
+    std::size_t                      m_scopes = 0; // blocks so far, ids don't depend on other compilations
+
+    Lexer*           m_lexer = nullptr; // source of tokens when streaming
+    std::list<Token> m_tokens;          // pulled tokens, from the start of the current statement
 };
@@ -0,0 +1,146 @@
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include "PerfCounters.h"
+
+static constexpr std::uint64_t Configs[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+static constexpr const char* Names[] = {
+    "cycles", "instructions", "branches", "branch_misses", "llc_references", "llc_misses",
+};
+
+static_assert(std::size(Configs) == PerfCounters::COUNT && std::size(Names) == PerfCounters::COUNT);
+
+PerfCounters::PerfCounters()
+{
+    m_fds.fill(-1);
+
+    for (std::size_t i = 0; i < COUNT; i++) {
+        perf_event_attr attr{};
+        attr.size           = sizeof(attr);
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = Configs[i];
+        attr.exclude_kernel = 1; // allowed without privileges
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        m_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        if (m_fds[i] < 0 && m_error.empty()) {
+            if (errno == EACCES || errno == EPERM) {
+                m_error = "access denied, see /proc/sys/kernel/perf_event_paranoid";
+            }
+            else if (errno == ENOENT || errno == EOPNOTSUPP) {
+                m_error = "event not supported by this CPU or virtual machine";
+            }
+            else {
+                m_error = std::format("perf_event_open: {}", std::strerror(errno));
+            }
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool PerfCounters::available() const
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PerfCounters::Values PerfCounters::read() const
+{
+    Values values{};
+
+    for (std::size_t i = 0; i < COUNT; i++) {
+        // value, time enabled, time running
+        std::uint64_t data[3];
+
+        if (m_fds[i] < 0 || ::read(m_fds[i], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        values[i] = data[2] ? static_cast<double>(data[0]) * data[1] / data[2] : 0.0;
+    }
+    return values;
+}
+
+PerfCounters::Values PerfCounters::difference(const Values& end, const Values& start)
+{
+    Values values;
+
+    for (std::size_t i = 0; i < COUNT; i++) {
+        values[i] = end[i] - start[i];
+    }
+    return values;
+}
+
+double PerfCounters::ipc(const Values& v) const
+{
+    return ratio(v, INSTRUCTIONS, CYCLES);
+}
+
+double PerfCounters::branchMissRate(const Values& v) const
+{
+    return ratio(v, BRANCH_MISSES, BRANCHES);
+}
+
+double PerfCounters::cacheMissRate(const Values& v) const
+{
+    return ratio(v, CACHE_MISSES, CACHE_REFERENCES);
+}
+
+double PerfCounters::ratio(const Values& v, Counter a, Counter b) const
+{
+    if (!available(a) || !available(b) || v[b] <= 0.0) {
+        return NAN;
+    }
+    return v[a] / v[b];
+}
+
+void PerfCounters::writeFields(std::ostream& out, const Values& v) const
+{
+    for (std::size_t i = 0; i < COUNT; i++) {
+        if (available(static_cast<Counter>(i))) {
+            out << ", \"" << Names[i] << "\": " << static_cast<std::uint64_t>(v[i]);
+        }
+    }
+
+    std::pair<const char*, double> rates[] = {
+        {"ipc",              ipc(v)           },
+        {"branch_miss_rate", branchMissRate(v)},
+        {"llc_miss_rate",    cacheMissRate(v) },
+    };
+
+    std::streamsize precision = out.precision(6);
+    for (const auto& [name, value] : rates) {
+        if (!std::isnan(value)) {
+            out << ", \"" << name << "\": " << value;
+        }
+    }
+    out.precision(precision);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// hardware counters of the calling thread, opened with perf_event_open(2)
+// counters the kernel or the CPU doesn't allow are left closed
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCHES,
+        BRANCH_MISSES,
+        CACHE_REFERENCES, // last level cache
+        CACHE_MISSES,
+        COUNT,
+    };
+
+    // counter values scaled for time the counter wasn't scheduled
+    using Values = std::array<double, COUNT>;
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&)            = delete;
+    PerfCounters(PerfCounters&&)                 = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    PerfCounters& operator=(PerfCounters&&)      = delete;
+
+    bool available(Counter c) const { return m_fds[c] >= 0; }
+    // at least one counter is open
+    bool available() const;
+    // reason of the first failure
+    const std::string& error() const { return m_error; }
+
+    Values read() const;
+
+    static Values difference(const Values& end, const Values& start);
+
+    // instructions per cycle, branch and cache miss rates, NaN if counters are unavailable
+    double ipc(const Values& v) const;
+    double branchMissRate(const Values& v) const;
+    double cacheMissRate(const Values& v) const;
+
+    // JSON members of available counters and rates, each preceded by a comma
+    void writeFields(std::ostream& out, const Values& v) const;
+
+private:
+    double ratio(const Values& v, Counter a, Counter b) const;
+
+private:
+    std::array<int, COUNT> m_fds;
+    std::string            m_error;
+};
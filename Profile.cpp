@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Common.h"
+#include "Profile.h"
+#include "Sha256.h"
+
+std::uint64_t Profile::hash(std::string_view source)
+{
+    Sha256 sha;
+    sha.update(source);
+
+    // first 64 bits of the digest
+    return std::stoull(sha.hex().substr(0, 16), nullptr, 16);
+}
+
+void Profile::load(const std::string& path, std::uint64_t sourceHash)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw InterpretError("can't open profile " + path);
+    }
+
+    std::vector<char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t hash;
+    std::uint64_t counters;
+
+    if (bytes.size() < HEADER_SIZE) {
+        throw InterpretError(path + " is not a profile");
+    }
+
+    std::memcpy(&magic, bytes.data(), 4);
+    std::memcpy(&version, bytes.data() + 4, 4);
+    std::memcpy(&hash, bytes.data() + 8, 8);
+    std::memcpy(&counters, bytes.data() + 16, 8);
+
+    std::size_t size = bytes.size() - HEADER_SIZE;
+
+    if (magic != MAGIC || version != VERSION || size % 8 != 0 || counters != size / 8) {
+        throw InterpretError(path + " is not a profile");
+    }
+    if (hash != sourceHash) {
+        throw InterpretError(path + " is a profile of another source");
+    }
+
+    m_counts.resize(counters);
+    std::memcpy(m_counts.data(), bytes.data() + HEADER_SIZE, counters * 8);
+
+    m_max = m_counts.empty() ? 0 : std::ranges::max(m_counts);
+}
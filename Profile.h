@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// execution counts written by an instrumented program when it exits
+// the file is HEADER_SIZE bytes of magic, version, source hash and number of counters,
+// followed by the 64-bit counters, all little-endian
+// counters are numbered by Interpreter in preorder of the AST, a branch takes two for runs of its then and
+// else arms, a loop one for its iterations
+class Profile
+{
+public:
+    Profile() {}
+    ~Profile() {}
+
+    Profile(const Profile&)            = delete;
+    Profile(Profile&&)                 = delete;
+    Profile& operator=(const Profile&) = delete;
+    Profile& operator=(Profile&&)      = delete;
+
+    static constexpr std::uint32_t MAGIC       = 0x464F5250; // "PROF"
+    static constexpr std::uint32_t VERSION     = 1;
+    static constexpr std::size_t   HEADER_SIZE = 24;
+
+    // identifies the source a profile was collected for
+    static std::uint64_t hash(std::string_view source);
+
+    // throws InterpretError if the file can't be read, isn't a profile or is of another source
+    void load(const std::string& path, std::uint64_t sourceHash);
+
+    // 0 for a counter the profile doesn't have
+    std::uint64_t count(std::size_t counter) const { return counter < m_counts.size() ? m_counts[counter] : 0; }
+
+    std::size_t size() const { return m_counts.size(); }
+
+    // largest loop or arm count, hot code is compared to it
+    std::uint64_t max() const { return m_max; }
+
+private:
+    std::vector<std::uint64_t> m_counts;
+    std::uint64_t              m_max = 0;
+};
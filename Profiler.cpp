@@ -0,0 +1,175 @@
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "Profiler.h"
+
+Profiler::Profiler(bool report, bool perf, std::string tracePath)
+: m_report(report),
+  m_tracePath(std::move(tracePath)),
+  m_perf(perf ? std::make_unique<PerfCounters>() : nullptr),
+  m_start(wallTime())
+{
+    if (m_perf && !m_perf->available()) {
+        std::cerr << "perf counters unavailable: " << m_perf->error() << '\n';
+        m_perf.reset();
+    }
+
+    // events don't reallocate inside measured scopes
+    m_events.reserve(64);
+    s_active = this;
+}
+
+Profiler::~Profiler()
+{
+    s_active = nullptr;
+
+    // scopes left by an exception are closed at the end
+    while (!m_open.empty()) {
+        end();
+    }
+
+    if (m_report) {
+        printReport();
+    }
+    if (!m_tracePath.empty()) {
+        writeTrace();
+    }
+}
+
+void Profiler::begin(std::string_view name)
+{
+    m_open.push_back(m_events.size());
+    m_events.push_back({name, m_open.size() - 1, wallTime() - m_start, 0, cpuTime(), AllocationTracker::stats(),
+                        AllocationTracker::resetPeak()});
+
+    if (m_perf) {
+        m_events.back().perf = m_perf->read();
+    }
+}
+
+void Profiler::end()
+{
+    Event& e = m_events[m_open.back()];
+    m_open.pop_back();
+
+    e.wall = wallTime() - m_start - e.start;
+    e.cpu  = cpuTime() - e.cpu;
+
+    const AllocationStats& now = AllocationTracker::stats();
+
+    e.alloc.count = now.count - e.alloc.count;
+    e.alloc.bytes = now.bytes - e.alloc.bytes;
+    e.alloc.peak  = now.peak - e.alloc.live;
+    e.alloc.live  = now.live - e.alloc.live;
+    AllocationTracker::restorePeak(e.outerPeak);
+
+    if (m_perf) {
+        e.perf = PerfCounters::difference(m_perf->read(), e.perf);
+    }
+}
+
+std::int64_t Profiler::wallTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+std::int64_t Profiler::cpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+void Profiler::printReport()
+{
+    bool allocations = AllocationTracker::enabled();
+
+    Event total{"total", 0, 0, 0, 0, {}, 0};
+
+    std::cerr << "===--- time report ---===\n"
+              << "   wall ms     cpu ms" << (allocations ? "     allocs    alloc KiB     peak KiB" : "")
+              << (m_perf ? "     IPC  br miss %  LLC miss %" : "") << "  phase\n"
+              << std::fixed << std::setprecision(3);
+
+    // unavailable counters are shown as -
+    auto rate = [](double value, int width, double scale)
+    {
+        if (std::isnan(value)) {
+            std::cerr << std::setw(width) << '-';
+        }
+        else {
+            std::cerr << std::setw(width) << value * scale;
+        }
+    };
+
+    auto print = [this, allocations, &rate](const Event& e)
+    {
+        std::cerr << std::setw(10) << e.wall / 1e6 << ' ' << std::setw(10) << e.cpu / 1e6;
+        if (allocations) {
+            std::cerr << ' ' << std::setw(10) << e.alloc.count << ' ' << std::setw(12) << e.alloc.bytes / 1024.0 << ' '
+                      << std::setw(12) << e.alloc.peak / 1024.0;
+        }
+        if (m_perf) {
+            rate(m_perf->ipc(e.perf), 8, 1.0);
+            rate(m_perf->branchMissRate(e.perf), 11, 100.0);
+            rate(m_perf->cacheMissRate(e.perf), 12, 100.0);
+        }
+        std::cerr << "  " << std::string(e.depth * 2, ' ') << e.name << '\n';
+    };
+
+    for (const Event& e : m_events) {
+        print(e);
+
+        if (e.depth == 0) {
+            total.wall += e.wall;
+            total.cpu += e.cpu;
+            total.alloc.count += e.alloc.count;
+            total.alloc.bytes += e.alloc.bytes;
+            total.alloc.peak = std::max(total.alloc.peak, total.alloc.live + e.alloc.peak);
+            total.alloc.live += e.alloc.live;
+
+            for (std::size_t i = 0; i < PerfCounters::COUNT; i++) {
+                total.perf[i] += e.perf[i];
+            }
+        }
+    }
+
+    print(total);
+}
+
+void Profiler::writeTrace()
+{
+    std::ofstream out(m_tracePath);
+
+    if (!out.is_open()) {
+        std::cerr << "can't open " << m_tracePath << '\n';
+        return;
+    }
+
+    // complete events, timestamps are in microseconds
+    out << "{\"traceEvents\": [" << std::fixed << std::setprecision(3);
+
+    for (std::size_t i = 0; i < m_events.size(); i++) {
+        const Event& e = m_events[i];
+
+        out << (i ? ",\n" : "\n") << "  {\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": "
+            << e.start / 1e3 << ", \"dur\": " << e.wall / 1e3 << ", \"args\": {\"cpu_us\": " << e.cpu / 1e3;
+        if (AllocationTracker::enabled()) {
+            out << ", \"allocs\": " << e.alloc.count << ", \"alloc_bytes\": " << e.alloc.bytes
+                << ", \"peak_bytes\": " << e.alloc.peak;
+        }
+        if (m_perf) {
+            m_perf->writeFields(out, e.perf);
+        }
+        out << "}}";
+    }
+
+    out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
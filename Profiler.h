@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "PerfCounters.h"
+
+// records wall and CPU time of nested compiler phases, their allocations when tracking is enabled
+// and hardware counters when they are requested
+// while a profiler exists it is active on its thread, the report and the trace are written when it is destroyed
+class Profiler
+{
+public:
+    // report goes to stderr, trace is written in Chrome trace format if path is not empty
+    Profiler(bool report, bool perf, std::string tracePath);
+    ~Profiler();
+
+    Profiler(const Profiler&)            = delete;
+    Profiler(Profiler&&)                 = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    Profiler& operator=(Profiler&&)      = delete;
+
+    // nullptr when profiling is disabled
+    static Profiler* active() { return s_active; }
+
+    // name must outlive the profiler, scopes use string literals
+    void begin(std::string_view name);
+    void end();
+
+private:
+    struct Event
+    {
+        std::string_view name;
+        std::size_t      depth;
+        std::int64_t     start; // wall time in ns since the profiler was created
+        std::int64_t     wall;  // ns
+        std::int64_t     cpu;   // ns, CPU time at begin until the scope ends
+
+        // allocations inside the scope, peak is above live size at begin
+        // counters at begin until the scope ends
+        AllocationStats alloc;
+        std::int64_t    outerPeak; // peak of enclosing scope
+
+        PerfCounters::Values perf = {}; // values at begin until the scope ends
+    };
+
+    static std::int64_t wallTime();
+    static std::int64_t cpuTime();
+
+    void printReport();
+    void writeTrace();
+
+private:
+    // compilations on other threads aren't measured
+    static inline thread_local Profiler* s_active = nullptr;
+
+    bool                          m_report;
+    std::string                   m_tracePath;
+    std::unique_ptr<PerfCounters> m_perf; // nullptr if not requested
+
+    std::int64_t             m_start;
+    std::vector<Event>       m_events; // in order of begin
+    std::vector<std::size_t> m_open;   // events without end, innermost last
+};
+
+// measures enclosing scope, only checks a pointer when profiling is disabled
+class TimeScope
+{
+public:
+    explicit TimeScope(std::string_view name) : m_profiler(Profiler::active())
+    {
+        if (m_profiler) {
+            m_profiler->begin(name);
+        }
+    }
+    ~TimeScope()
+    {
+        if (m_profiler) {
+            m_profiler->end();
+        }
+    }
+
+    TimeScope(const TimeScope&)            = delete;
+    TimeScope(TimeScope&&)                 = delete;
+    TimeScope& operator=(const TimeScope&) = delete;
+    TimeScope& operator=(TimeScope&&)      = delete;
+
+private:
+    Profiler* m_profiler;
+};
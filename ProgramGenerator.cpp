@@ -0,0 +1,184 @@
+#include "ProgramGenerator.h"
+
+// int and float values mix through implicit casts
+static constexpr std::string_view Types[] = {"int", "float"};
+
+std::string ProgramGenerator::generate(Shape shape, std::size_t size)
+{
+    m_source.clear();
+    m_indent = 0;
+    m_names  = 0;
+    m_blocks.assign(1, {"seed"});
+
+    // uninitialized global, so expressions can't be folded at compile time
+    line("int seed;");
+
+    switch (shape) {
+        case Shape::WIDE:
+            wide(size);
+            break;
+        case Shape::DEEP:
+            for (std::size_t i = 0; i < REPEAT; i++) {
+                nested(size);
+            }
+            break;
+        case Shape::EXPR:
+            for (std::size_t i = 0; i < REPEAT; i++) {
+                declaration(size);
+            }
+            break;
+    }
+
+    return std::move(m_source);
+}
+
+std::string_view ProgramGenerator::shapeName(Shape shape)
+{
+    switch (shape) {
+        case Shape::WIDE:
+            return "wide";
+        case Shape::DEEP:
+            return "deep";
+        case Shape::EXPR:
+            return "expr";
+    }
+    return "unknown";
+}
+
+void ProgramGenerator::wide(std::size_t size)
+{
+    for (std::size_t i = 0; i < size; i++) {
+        const std::vector<std::string>& visible = m_blocks.back();
+
+        if (random(4) == 0) {
+            m_source.append(visible[random(visible.size())]).append(" = ");
+            expression(1 + random(4));
+            m_source.append(";\n");
+        }
+        else {
+            declaration(1 + random(4));
+        }
+    }
+}
+
+void ProgramGenerator::nested(std::size_t levels)
+{
+    if (levels == 0) {
+        return;
+    }
+
+    declaration(1 + random(3));
+    std::string var = m_blocks.back().back();
+
+    if (random(2) == 0) {
+        openBlock("if (" + var + " < " + std::to_string(random(100)) + ") {");
+        nested(levels - 1);
+        closeBlock();
+        openBlock("else {");
+        declaration(2);
+        closeBlock();
+    }
+    else {
+        std::string counter = "i" + std::to_string(m_names++);
+
+        line("int " + counter + " = 0;");
+        openBlock("while (" + counter + " < 4) {");
+        nested(levels - 1);
+        line(counter + " = " + counter + " + 1;");
+        closeBlock();
+    }
+}
+
+void ProgramGenerator::declaration(std::size_t operands)
+{
+    std::string name = "v" + std::to_string(m_names++);
+
+    m_source.append(m_indent * 4, ' ').append(Types[random(2)]).append(" ").append(name).append(" = ");
+    expression(operands);
+    m_source.append(";\n");
+
+    m_blocks.back().push_back(std::move(name));
+}
+
+void ProgramGenerator::expression(std::size_t operands)
+{
+    if (operands == 1) {
+        operand();
+        return;
+    }
+
+    // short tails are left flat, so the parser sees operator chains too
+    if (operands <= 4) {
+        operand();
+        for (std::size_t i = 1; i < operands; i++) {
+            m_source.append(" ").append(1, "+-*"[random(3)]).append(" ");
+            operand();
+        }
+        return;
+    }
+
+    std::size_t left = 1 + random(operands - 1);
+
+    m_source.append("(");
+    expression(left);
+
+    // divisors are nonzero literals, so folding never divides by zero
+    if (operands - left == 1 && random(4) == 0) {
+        m_source.append(" / ").append(std::to_string(1 + random(9)));
+    }
+    else {
+        m_source.append(" ").append(1, "+-*"[random(3)]).append(" ");
+        expression(operands - left);
+    }
+    m_source.append(")");
+}
+
+void ProgramGenerator::operand()
+{
+    std::size_t                     kind  = random(4);
+    std::size_t                     count = 0;
+    const std::vector<std::string>* block = nullptr;
+
+    for (const std::vector<std::string>& b : m_blocks) {
+        count += b.size();
+    }
+
+    if (kind == 0) {
+        m_source.append(std::to_string(random(100)));
+        return;
+    }
+    if (kind == 1) {
+        m_source.append(std::to_string(random(100))).append(".5");
+        return;
+    }
+
+    // variable of any open block, recent ones are as likely as old ones
+    std::size_t index = random(count);
+    for (const std::vector<std::string>& b : m_blocks) {
+        if (index < b.size()) {
+            block = &b;
+            break;
+        }
+        index -= b.size();
+    }
+    m_source.append((*block)[index]);
+}
+
+void ProgramGenerator::line(std::string_view text)
+{
+    m_source.append(m_indent * 4, ' ').append(text).append("\n");
+}
+
+void ProgramGenerator::openBlock(std::string_view header)
+{
+    line(header);
+    m_indent++;
+    m_blocks.emplace_back();
+}
+
+void ProgramGenerator::closeBlock(std::string_view footer)
+{
+    m_blocks.pop_back();
+    m_indent--;
+    line(footer);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// generates valid source programs of a given shape for benchmarks
+// the same seed gives the same program on every platform
+class ProgramGenerator
+{
+public:
+    enum class Shape
+    {
+        WIDE, // size top-level declarations and assignments
+        DEEP, // blocks nested size levels deep
+        EXPR, // expressions of size operands
+    };
+
+    // deep and expression programs repeat their construct, so they are long enough to time
+    static constexpr std::size_t REPEAT = 16;
+
+    ProgramGenerator(std::uint64_t seed) : m_random(seed) {}
+    ~ProgramGenerator() {}
+
+    ProgramGenerator(const ProgramGenerator&)            = delete;
+    ProgramGenerator(ProgramGenerator&&)                 = delete;
+    ProgramGenerator& operator=(const ProgramGenerator&) = delete;
+    ProgramGenerator& operator=(ProgramGenerator&&)      = delete;
+
+    std::string generate(Shape shape, std::size_t size);
+
+    static std::string_view shapeName(Shape shape);
+
+private:
+    void wide(std::size_t size);
+    void nested(std::size_t levels);
+
+    // "type name = expression;" with a new variable visible in the current block
+    void declaration(std::size_t operands);
+    // arithmetic expression, operands are visible variables and literals
+    void expression(std::size_t operands);
+    void operand();
+
+    void line(std::string_view text);
+    void openBlock(std::string_view header);
+    void closeBlock(std::string_view footer = "}");
+
+    // uniform in [0, n), unlike distributions the result doesn't depend on the standard library
+    std::size_t random(std::size_t n) { return m_random() % n; }
+
+private:
+    std::mt19937_64 m_random;
+    std::string     m_source;
+    std::size_t     m_indent = 0;
+    std::size_t     m_names  = 0;
+
+    std::vector<std::vector<std::string>> m_blocks; // visible variables of each open block
+};
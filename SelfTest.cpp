@@ -0,0 +1,468 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <format>
+#include <istream>
+#include <list>
+#include <new>
+#include <streambuf>
+#include <utility>
+
+#include "AllocationTracker.h"
+#include "AsmWriter.h"
+#include "BytecodeCompiler.h"
+#include "CompilerContext.h"
+#include "DataLayout.h"
+#include "FrameAllocator.h"
+#include "Interpreter.h"
+#include "Jit.h"
+#include "Lexer.h"
+#include "LoopAnalyzer.h"
+#include "Parser.h"
+#include "SelfTest.h"
+#include "StreamCompiler.h"
+#include "TreeWalker.h"
+#include "VM.h"
+
+// header followed by count copies of body, generated as it is read
+class RepeatBuffer : public std::streambuf
+{
+public:
+    RepeatBuffer(const std::string& header, const std::string& body, std::size_t count)
+    : m_header(header),
+      m_body(body),
+      m_count(count)
+    {
+        setg(m_header.data(), m_header.data(), m_header.data() + m_header.size());
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if (m_count == 0) {
+            return traits_type::eof();
+        }
+        m_count--;
+        setg(m_body.data(), m_body.data(), m_body.data() + m_body.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    std::string m_header;
+    std::string m_body;
+    std::size_t m_count;
+};
+
+bool SelfTest::run()
+{
+    m_checks = 0;
+    m_failed = 0;
+
+    guard("struct layout", [this] { checkStructLayout(); });
+    guard("data layout", [this] { checkDataLayout(); });
+    guard("fused branches", [this] { checkFusedBranches(); });
+    guard("stream memory", [this] { checkStreamMemory(); });
+    guard("backends", [this] { checkBackends(); });
+    guard("allocation tracking", [this] { checkAllocationTracking(); });
+
+    m_out << m_checks << " checks, " << m_failed << " failed\n";
+    return m_failed == 0;
+}
+
+template <typename Check>
+void SelfTest::guard(std::string_view name, Check&& check)
+{
+    try {
+        check();
+    } catch (const LexicalError& e) {
+        expect(false, std::format("{}: lexical error: {}", name, e.what()));
+    } catch (const SyntaxError& e) {
+        expect(false, std::format("{}: syntax error: {}", name, e.what()));
+    } catch (const SemanticError& e) {
+        expect(false, std::format("{}: semantic error: {}", name, e.what()));
+    } catch (const InterpretError& e) {
+        expect(false, std::format("{}: {}", name, e.what()));
+    }
+}
+
+void SelfTest::checkStructLayout()
+{
+    SemanticAnalyzer sa;
+    analyze("struct M { char a; int b; float c; char d; };\n"
+            "struct [[soa]] S { char a; int b; float c; char d; };\n"
+            "struct M one;\n"
+            "struct M aos[5];\n"
+            "struct S soas[5];\n"
+            "struct S vec[5];\n"
+            "int i;\n"
+            "i = 0;\n"
+            "while (i < 5) { vec[i].b = vec[i].b + 1; i = i + 1; }\n",
+            sa);
+
+    Scope& globals = *sa.getSymbolTable()[0];
+
+    // fields are sorted by decreasing alignment, so the chars share the tail: 10 bytes and 2 of padding
+    const StructType& aos = *globals.get("one")->structType;
+
+    expect(aos.declaredSize == 16, std::format("M in declaration order is {} bytes, expected 16", aos.declaredSize));
+    expect(aos.size == 12, std::format("M is {} bytes, expected 12", aos.size));
+    expect(aos.align == 4, std::format("M is aligned to {}, expected 4", aos.align));
+
+    for (auto [name, offset] : {std::pair{"b", 0u}, {"c", 4u}, {"a", 8u}, {"d", 9u}}) {
+        std::uint32_t actual = aos.getField(name)->offset;
+        expect(actual == offset, std::format("M.{} at offset {}, expected {}", name, actual, offset));
+    }
+
+    std::uint32_t size = globals.get("aos")->size;
+    expect(size == 60, std::format("M[5] is {} bytes, expected 60", size));
+
+    // field arrays are aligned to their element type, so SoA has no padding and is smaller than AoS
+    const StructType& soa = *globals.get("soas")->structType;
+
+    expect(soa.soa, "S isn't stored as SoA");
+    expect(!SYMBOL_GET_FLAG((*globals.get("soas")), SYMBOL_FLAG_VECTOR), "S soas[5] without loops is vector aligned");
+
+    for (auto [name, offset] : {std::pair{"b", 0u}, {"c", 20u}, {"a", 40u}, {"d", 45u}}) {
+        std::uint32_t actual = soa.soaOffset(*soa.getField(name), 5);
+        expect(actual == offset, std::format("S[5].{} at offset {}, expected {}", name, actual, offset));
+    }
+
+    size = globals.get("soas")->size;
+    expect(size == 50, std::format("S[5] is {} bytes, expected 50", size));
+
+    // field arrays of a vectorized loop are aligned to 16, which costs 35 bytes over packed
+    expect(SYMBOL_GET_FLAG((*globals.get("vec")), SYMBOL_FLAG_VECTOR),
+           "S vec[5] of a vectorized loop isn't vector aligned");
+
+    for (auto [name, offset] : {std::pair{"b", 0u}, {"c", 32u}, {"a", 64u}, {"d", 80u}}) {
+        std::uint32_t actual = soa.soaOffset(*soa.getField(name), 5, true);
+        expect(actual == offset, std::format("vector S[5].{} at offset {}, expected {}", name, actual, offset));
+    }
+
+    size = globals.get("vec")->size;
+    expect(size == 85, std::format("vector S[5] is {} bytes, expected 85", size));
+}
+
+void SelfTest::checkDataLayout()
+{
+    const std::string source = "struct P { char a; int b; float c; };\n"
+                               "int k = 1;\n"
+                               "char d = 2;\n"
+                               "struct P p;\n"
+                               "char c;\n"
+                               "char tag[3];\n"
+                               "int i;\n"
+                               "float f;\n"
+                               "int arr[5];\n"
+                               "int big[8];\n"
+                               "while (i < 5) { arr[i] = i; f = f + 1.0; i = i + 1; }\n";
+
+    // .bss: big[8] aligned to 32, then the arrays aligned to 16, arr[5] of the loop first, leaving a gap at 52..64;
+    // f and i of the loop fill the gap next to arr, struct p goes after tag[3] and c takes the rest of the gap
+    const std::pair<std::string_view, std::uint32_t> expected[] = {
+        {"k", 0}, {"d", 4}, {"big", 0}, {"arr", 32}, {"f", 52}, {"i", 56}, {"c", 60}, {"tag", 64}, {"p", 68},
+    };
+
+    std::vector<std::uint32_t> previous;
+
+    for (std::size_t run = 0; run < 2; run++) {
+        SemanticAnalyzer sa;
+        analyze(source, sa);
+
+        SymbolTable&               st = sa.getSymbolTable();
+        std::vector<std::uint32_t> offsets;
+
+        for (auto [name, offset] : expected) {
+            const Symbol& sym = *st[0]->get(std::string(name));
+
+            offsets.push_back(sym.offset);
+            expect(sym.offset % sym.align == 0,
+                   std::format("{} at offset {} isn't aligned to {}", name, sym.offset, sym.align));
+            expect(sym.offset == offset, std::format("{} at offset {}, expected {}", name, sym.offset, offset));
+        }
+
+        const Symbol& arr = *st[0]->get("arr");
+        const Symbol& f   = *st[0]->get("f");
+        const Symbol& i   = *st[0]->get("i");
+
+        expect(arr.offset + arr.size == f.offset && f.offset + f.size == i.offset,
+               "arr, f and i of the loop aren't adjacent");
+        expect(st[0]->get("c")->offset < st[0]->get("tag")->offset, "c doesn't fill the gap before tag");
+        expect(st.getData().size == 5 && st.getData().padding == 0,
+               std::format(".data is {} bytes with {} padding, expected 5 and 0", st.getData().size,
+                           st.getData().padding));
+        expect(st.getBss().size == 80 && st.getBss().padding == 4,
+               std::format(".bss is {} bytes with {} padding, expected 80 and 4", st.getBss().size,
+                           st.getBss().padding));
+
+        if (!previous.empty()) {
+            expect(offsets == previous, "offsets differ between two layouts of the same source");
+        }
+        previous = std::move(offsets);
+    }
+}
+
+void SelfTest::checkFusedBranches()
+{
+    struct Case
+    {
+        std::string_view         name;
+        std::string_view         statement;
+        std::vector<std::string> jumps; // compares and jumps in order
+    };
+
+    // skips of branch bodies jump on the negated condition, NaN skips float ones
+    const Case cases[] = {
+        {"int", "if (i < n) { r = 1; }", {"cmp", "jge"}},
+        {"float", "if (f < g) { r = 1; }", {"ucomiss", "jbe"}},
+        {"&&", "if (i < n && f <= g) { r = 1; }", {"cmp", "jge", "ucomiss", "jb"}},
+        {"||", "if (i == n || g > f) { r = 1; }", {"cmp", "je", "ucomiss", "jbe"}},
+        {"while", "while (i != n) { i = i + 1; }", {"cmp", "je", "cmp", "jne"}},
+    };
+
+    CompilerContext context;
+
+    for (const Case& c : cases) {
+        std::string source = std::format("int i = 0;\nint n = 3;\nfloat f = 1.0;\nfloat g = 2.0;\nint r = 0;\n{}\n",
+                                          c.statement);
+
+        if (!context.compile(source)) {
+            expect(false, std::format("{} condition doesn't compile", c.name));
+            continue;
+        }
+
+        std::vector<std::string> jumps;
+        bool                     materialized = false;
+
+        for (const std::string& m : mnemonics(context.output())) {
+            if (m == "cmp" || m == "ucomiss" || (m.starts_with('j') && m != "jmp")) {
+                jumps.push_back(m);
+            }
+            materialized |= m.starts_with("set") || m == "test";
+        }
+
+        auto join = [](const std::vector<std::string>& v)
+        {
+            std::string s;
+            for (const std::string& m : v) {
+                s += (s.empty() ? "" : " ") + m;
+            }
+            return s;
+        };
+
+        expect(!materialized, std::format("{} condition is computed into a register", c.name));
+        expect(jumps == c.jumps,
+               std::format("{} condition uses {}, expected {}", c.name, join(jumps), join(c.jumps)));
+    }
+}
+
+void SelfTest::checkStreamMemory()
+{
+    std::string header = "int a = 1;\nint b = 2;\nint c = 0;\nint i = 0;\nfloat f = 1.5;\nint arr[64];\n";
+    std::string body   = "i = 0;\n"
+                         "while (i < 64) { int t = i * 3 + a; arr[i] = t - b; c = c + arr[i]; i = i + 1; }\n"
+                         "if (c > 100) { float g = f * 2.0; f = g - 1.0; } else { b = b + 1; }\n";
+
+    std::size_t smallest = 0;
+
+    for (std::size_t count : {STREAM_BLOCKS, STREAM_BLOCKS * 4, STREAM_BLOCKS * 16}) {
+        std::size_t peak = streamPeak(header, body, count);
+
+        if (peak == 0) {
+            expect(false, std::format("streaming {} blocks failed", count));
+            return;
+        }
+        smallest = smallest ? smallest : peak;
+
+        expect(peak <= smallest + STREAM_SLACK,
+               std::format("streaming {} blocks peaks at {} KiB, {} blocks at {} KiB", count, peak, STREAM_BLOCKS,
+                           smallest));
+    }
+}
+
+void SelfTest::checkBackends()
+{
+    struct Case
+    {
+        std::string_view name;
+        std::string_view source;
+    };
+
+    const Case cases[] = {
+        // char arithmetic is done in int and wraps when stored
+        {"char wrap", "char c = 100;\nint x;\nc = c + c;\nx = c;\nchar d = 5;\nd = -d * 30;\nint y = d;\n"},
+        // initialized globals keep their values after an early exit
+        {"bounds exit", "int a[2];\nint i = 5;\nint k = 42;\nfloat f = 2.5;\na[i] = 1;\nk = 0;\n"},
+        // division by zero exits like an index out of range, INT_MIN / -1 wraps
+        {"division", "int m = -2147483647;\nint n = -1;\nint z = 0;\nint q;\nm = m - 1;\nq = m / n;\nq = q / z;\n"},
+        {"constant division", "int a = 7;\nint s = a / -1;\nint q = a / 2;\na = a / 0;\nq = 1;\n"},
+        {"logic", "int a[4];\nint i = 2;\nbool r = false;\na[2] = 5;\nr = a[i] > 0 && i < 3 || false;\n"},
+    };
+
+    for (const Case& c : cases) {
+        SemanticAnalyzer sa;
+        ast::ASTNodePtr  tree = analyze(std::string(c.source), sa);
+
+        TreeWalker walker(sa.getSymbolTable());
+        int        walkCode  = walker.run(tree);
+        auto       walkBytes = globalBytes(sa.getSymbolTable(), walker);
+
+        BytecodeCompiler compiler(sa.getSymbolTable());
+        VM               machine;
+        int              vmCode  = machine.run(compiler.compile(tree));
+        auto             vmBytes = globalBytes(sa.getSymbolTable(), machine);
+
+        // the native backend takes the symbol table
+        SemanticAnalyzer native;
+        ast::ASTNodePtr  nativeTree = analyze(std::string(c.source), native);
+        Interpreter      interpreter(std::move(native.getSymbolTable()), SimdLevel::SSE, true);
+        Jit              runner;
+
+        runner.load(interpreter.interpret(nativeTree));
+        int  jitCode  = runner.run();
+        auto jitBytes = globalBytes(interpreter.getSymbolTable(), runner);
+
+        expect(walkCode == vmCode, std::format("{}: --walk exits with {}, --vm with {}", c.name, walkCode, vmCode));
+        expect(walkCode == jitCode, std::format("{}: --walk exits with {}, --jit with {}", c.name, walkCode, jitCode));
+        expect(walkBytes == vmBytes, std::format("{}: --walk and --vm end with different globals", c.name));
+        expect(walkBytes == jitBytes, std::format("{}: --walk and --jit end with different globals", c.name));
+    }
+}
+
+void SelfTest::checkAllocationTracking()
+{
+    bool tracking = AllocationTracker::enabled();
+    AllocationTracker::enable(true);
+
+    AllocationStats before  = AllocationTracker::stats();
+    void*           aligned = operator new(100, std::align_val_t{64});
+    AllocationStats after   = AllocationTracker::stats();
+
+    expect(reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0, "aligned operator new isn't aligned to 64");
+    expect(after.count == before.count + 1 && after.live >= before.live + 100,
+           "aligned operator new isn't counted");
+
+    operator delete(aligned, std::align_val_t{64});
+    expect(AllocationTracker::stats().live == before.live, "aligned operator delete isn't counted");
+
+    // the handler can't free memory, so it gives up and the nothrow form returns nullptr
+    static bool called;
+    called = false;
+    std::new_handler previous = std::set_new_handler(
+        []
+        {
+            called = true;
+            std::set_new_handler(nullptr);
+        });
+
+    void* huge = operator new(SIZE_MAX / 2, std::nothrow);
+
+    std::set_new_handler(previous);
+    AllocationTracker::enable(tracking);
+
+    expect(!huge, "nothrow operator new of SIZE_MAX / 2 bytes didn't fail");
+    expect(called, "operator new failed without calling the new handler");
+    operator delete(huge);
+}
+
+ast::ASTNodePtr SelfTest::analyze(const std::string& source, SemanticAnalyzer& sa)
+{
+    Lexer  lexer;
+    Parser parser;
+
+    std::list<Token> ts   = lexer.tokenize(source);
+    ast::ASTNodePtr  tree = parser.parse(ts);
+
+    sa.analyze(tree);
+
+    LoopAnalyzer la;
+    la.analyze(tree);
+    FrameAllocator fa(sa.getSymbolTable());
+    fa.allocate(tree);
+    DataLayout dl(sa.getSymbolTable());
+    dl.layout(tree);
+
+    return tree;
+}
+
+template <typename Runner>
+std::vector<std::uint8_t> SelfTest::globalBytes(SymbolTable& st, Runner& runner)
+{
+    std::vector<std::pair<std::string, std::shared_ptr<Symbol>>> globals(st[0]->begin(), st[0]->end());
+    std::ranges::sort(globals, {}, [](const auto& e) { return e.first; });
+
+    std::vector<std::uint8_t> bytes;
+
+    for (const auto& [name, sym] : globals) {
+        const std::uint8_t* p = static_cast<const std::uint8_t*>(runner.address(name));
+        bytes.insert(bytes.end(), p, p + sym->size);
+    }
+    return bytes;
+}
+
+std::vector<std::string> SelfTest::mnemonics(std::string_view text)
+{
+    std::vector<std::string> result;
+
+    text.remove_prefix(std::min(text.size(), text.find("_start:")));
+
+    while (!text.empty()) {
+        std::string_view line = text.substr(0, text.find('\n'));
+        text.remove_prefix(std::min(text.size(), line.size() + 1));
+
+        // instructions are indented by a tab, labels and directives aren't
+        if (line.starts_with('\t')) {
+            line.remove_prefix(1);
+            result.emplace_back(line.substr(0, line.find(' ')));
+        }
+    }
+    return result;
+}
+
+std::size_t SelfTest::streamPeak(const std::string& header, const std::string& body, std::size_t count)
+{
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        return 0;
+    }
+
+    // child doesn't return, buffers of the parent aren't flushed twice
+    if (pid == 0) {
+        int status = 1;
+
+        try {
+            RepeatBuffer   buffer(header, body, count);
+            std::istream   in(&buffer);
+            AsmWriter      out(open("/dev/null", O_WRONLY));
+            StreamCompiler compiler;
+
+            compiler.compile(in, out);
+            out.flush();
+            status = 0;
+        } catch (...) {
+        }
+        _exit(status);
+    }
+
+    int           status;
+    struct rusage usage;
+
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+void SelfTest::expect(bool ok, std::string_view what)
+{
+    m_checks++;
+
+    if (!ok) {
+        m_failed++;
+        m_out << "FAIL: " << what << '\n';
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SemanticAnalyzer.h"
+
+// checks properties of compilation that the output of a program doesn't show:
+// struct and global layout, instruction selection and memory use of streaming,
+// that the execution modes agree on final globals and that allocations are counted,
+// failed checks are written to out
+class SelfTest
+{
+public:
+    SelfTest(std::ostream& out) : m_out(out) {}
+    ~SelfTest() {}
+
+    SelfTest(const SelfTest&)            = delete;
+    SelfTest(SelfTest&&)                 = delete;
+    SelfTest& operator=(const SelfTest&) = delete;
+    SelfTest& operator=(SelfTest&&)      = delete;
+
+    // returns true if every check passed
+    bool run();
+
+    // blocks of statements in the smallest streamed input, the others are 4 and 16 times larger
+    static constexpr std::size_t STREAM_BLOCKS = 2000;
+    // growth of peak RSS allowed from the smallest to the largest input in KiB
+    static constexpr std::size_t STREAM_SLACK = 1024;
+
+private:
+    // field offsets, padding and size of a char/int/float struct, alone and in AoS and SoA arrays
+    void checkStructLayout();
+    // offsets of mixed globals in .data and .bss: aligned, sorted by alignment and size, gaps filled,
+    // globals of one loop adjacent and the same in every run
+    void checkDataLayout();
+    // int, float, && and || conditions of branches and loops jump on flags of cmp or ucomiss,
+    // no setcc and test of the result
+    void checkFusedBranches();
+    // peak RSS of --stream stays flat while the input grows
+    void checkStreamMemory();
+    // programs run natively, on the VM and by the tree walker end with the same exit code and globals
+    void checkBackends();
+    // aligned and nothrow operator new are counted, the new handler is called before failing
+    void checkAllocationTracking();
+
+    // runs check, an error thrown by a phase fails it
+    template <typename Check>
+    void guard(std::string_view name, Check&& check);
+
+    // runs the front end and the layout passes, symbols of source are in the table of sa
+    static ast::ASTNodePtr analyze(const std::string& source, SemanticAnalyzer& sa);
+
+    // bytes of globals in name order after a run
+    template <typename Runner>
+    static std::vector<std::uint8_t> globalBytes(SymbolTable& st, Runner& runner);
+
+    // mnemonics of the instructions after _start in NASM text
+    static std::vector<std::string> mnemonics(std::string_view text);
+
+    // peak RSS in KiB of a child process that streams header and count copies of body to /dev/null
+    static std::size_t streamPeak(const std::string& header, const std::string& body, std::size_t count);
+
+    void expect(bool ok, std::string_view what);
+
+private:
+    std::ostream& m_out;
+    std::size_t   m_checks = 0;
+    std::size_t   m_failed = 0;
+};
@@ -1,4 +1,9 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <optional>
 #include <variant>
 
 #ifdef DEBUG
@@ -6,15 +11,21 @@
 #endif
 
 #include "Common.h"
+#include "Profiler.h"
 #include "SemanticAnalyzer.h"
 
 void SemanticAnalyzer::analyze(ast::ASTNodePtr& node)
 {
+    TimeScope scope("semantic");
+
 #ifdef DEBUG
     std::cout << "SemanticAnalyzer::buildSymbolTable() called\n";
 #endif
 
-    traversalPreorder(node);
+    {
+        TimeScope pass("resolve names");
+        traversalPreorder(node);
+    }
 
 
 #ifdef DEBUG
@@ -22,7 +33,20 @@ void SemanticAnalyzer::analyze(ast::ASTNodePtr& node)
     std::cout << "SemanticAnalyzer::typeCheck() called\n";
 #endif
 
-    traversalPostorder(node);
+    {
+        TimeScope pass("check types");
+        traversalPostorder(node);
+    }
+
+    {
+        TimeScope pass("fold casts");
+        foldCasts(node);
+    }
+
+    {
+        TimeScope pass("simplify");
+        simplify(node);
+    }
 
 #ifdef DEBUG
     std::cout << "SemanticAnalyzer::typeCheck() success\n";
@@ -57,6 +81,24 @@ void SemanticAnalyzer::resolveId(ast::ASTNodePtr& node)
                 }
 
                 Symbol s{type, ts::TypeSize[type], 0, 0, 0};
+                s.align = ts::TypeSize[type];
+
+                if (type == ts::Type::struct_t) {
+                    s.structType = m_symbolTable.findStruct(arg.getTypeName());
+
+                    if (!s.structType) {
+                        throw SemanticError(node->getLocation(), "unknown struct: " + arg.getTypeName());
+                    }
+                    s.size  = s.structType->size;
+                    s.align = s.structType->align;
+                }
+
+                if (arg.isArray()) {
+                    s.length = arg.getLength();
+                    s.size   = s.structType ? s.structType->arraySize(s.length) : ts::TypeSize[type] * s.length;
+                    s.align  = std::max(s.align, ts::arrayAlignment(s.size));
+                    SYMBOL_SET_FLAG(s, SYMBOL_FLAG_ARRAY);
+                }
 
                 // if id is initialized
                 if (node->getChildren().size() == 2) {
@@ -89,12 +131,24 @@ void SemanticAnalyzer::resolveId(ast::ASTNodePtr& node)
 
                 m_symbolTable.insert(id->getName(), s);
             }
+            else if constexpr (std::is_same_v<T, ast::StructDecl>) {
+                resolveStruct(node);
+            }
             else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                // field name is resolved with the type of its struct
+                ast::ASTNodePtr parent = node->getParent().lock();
+                if (isMemberAccess(parent) && parent->getChildren().back() == node) {
+                    return;
+                }
+
                 std::string name = arg.getName();
 
-                if (!m_symbolTable.find(name)) {
+                std::shared_ptr<Symbol> sym = m_symbolTable.find(name);
+
+                if (!sym) {
                     throw SemanticError(node->getLocation(), "unknown identifier: " + name);
                 }
+                arg.setSymbol(sym);
             }
             else if constexpr (std::is_same_v<T, ast::BlockStart>) {
                 m_symbolTable.enterScope(arg.getScopeId());
@@ -124,24 +178,7 @@ void SemanticAnalyzer::traversalPostorder(ast::ASTNodePtr& node)
 
 ts::Type SemanticAnalyzer::getType(const ast::ASTNodePtr& node)
 {
-    return std::visit(
-        [this](auto&& arg) -> ts::Type
-        {
-            using T = std::decay_t<decltype(arg)>;
-
-            if constexpr (std::is_same_v<T, ast::Identifier>) {
-                return m_symbolTable.find(arg.getName())->type;
-            }
-            else if constexpr (std::disjunction_v<std::is_same<T, ast::Integer>,
-                                                  std::is_same<T, ast::Float>,
-                                                  std::is_same<T, ast::Boolean>,
-                                                  std::is_same<T, ast::BinaryExpr>>) {
-                return arg.getType();
-            }
-
-            return ts::Type::unknown_t;
-        },
-        node->getData());
+    return ast::getType(node);
 }
 
 void SemanticAnalyzer::resolveTypes(ast::ASTNodePtr& node)
@@ -152,9 +189,33 @@ void SemanticAnalyzer::resolveTypes(ast::ASTNodePtr& node)
             using T = std::decay_t<decltype(arg)>;
 
             if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                if (arg.getLiteral() == "[]") {
+                    resolveSubscript(node);
+                    return;
+                }
+                if (arg.getLiteral() == "=") {
+                    resolveAssignment(node);
+                    return;
+                }
+                if (arg.getLiteral() == ".") {
+                    resolveMember(node);
+                    return;
+                }
+                if (arg.getLiteral() == "&&" || arg.getLiteral() == "||") {
+                    resolveLogical(node);
+                    return;
+                }
+
                 const ast::ASTNodePtr& left  = node->getChildren().front();
                 const ast::ASTNodePtr& right = node->getChildren().back();
 
+                if (isArray(left) || isArray(right)) {
+                    throw SemanticError(node->getLocation(), "array cannot be used as a value");
+                }
+                if (getType(left) == ts::Type::struct_t || getType(right) == ts::Type::struct_t) {
+                    throw SemanticError(node->getLocation(), "struct cannot be used as a value");
+                }
+
                 // node with highest type priority
                 ast::ASTNodePtr maxPriority = std::ranges::max(left,
                                                                right,
@@ -172,7 +233,10 @@ void SemanticAnalyzer::resolveTypes(ast::ASTNodePtr& node)
                 if ((notEqualTypes = maxType != minType) && !isImplicitlyCastable(minType, maxType)) {
                     throw SemanticError(node->getLocation(), "types do not match");
                 }
-                arg.setType(maxType);
+                // relational operators keep bool_t set by the parser
+                if (arg.getType() == ts::Type::unknown_t) {
+                    arg.setType(maxType);
+                }
 
                 if (notEqualTypes) {
                     ast::ASTNodePtr parent = minPriority->getParent().lock();
@@ -185,6 +249,14 @@ void SemanticAnalyzer::resolveTypes(ast::ASTNodePtr& node)
                     castNode->setLocation(minPriority->getLocation());
                 }
             }
+            else if constexpr (std::is_same_v<T, ast::UnaryExpr>) {
+                const ast::ASTNodePtr& operand = node->getChildren().front();
+
+                if (isArray(operand) || getType(operand) == ts::Type::struct_t) {
+                    throw SemanticError(node->getLocation(), "array cannot be used as a value");
+                }
+                arg.setType(getType(operand));
+            }
             // if statement, while statement conditions
             else if constexpr (std::is_same_v<T, ast::Condition>) {
                 ast::ASTNodePtr expr = node->getChildren().front();
@@ -255,7 +327,9 @@ ast::ASTNodePtr SemanticAnalyzer::evaluate(const ast::ASTNodePtr& node)
             if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
                 std::string op = x.getLiteral();
 
+#ifdef DEBUG
                 std::cout << "Evaluating binary expression: " << op << std::endl;
+#endif
 
                 ast::ASTNodePtr left  = evaluate(node->getChildren().front());
                 ast::ASTNodePtr right = evaluate(node->getChildren().back());
@@ -271,7 +345,9 @@ ast::ASTNodePtr SemanticAnalyzer::evaluate(const ast::ASTNodePtr& node)
                     resultType = x.getType();
                 }
 
+#ifdef DEBUG
                 std::cout << "Result type: " << ts::TypeNames[resultType] << std::endl;
+#endif
 
                 ast::ASTNodePtr res = std::make_shared<ast::ASTNode>(ast::BinaryExpr(op, resultType));
                 res->addChild(left);
@@ -327,3 +403,466 @@ bool SemanticAnalyzer::compiletimeCalculated(const ast::ASTNodePtr& node)
         },
         node->getData());
 }
+
+bool SemanticAnalyzer::isArray(const ast::ASTNodePtr& node)
+{
+    const ast::Identifier* id = std::get_if<ast::Identifier>(&node->getData());
+
+    return id && id->getSymbol() && SYMBOL_GET_FLAG((*id->getSymbol()), SYMBOL_FLAG_ARRAY);
+}
+
+void SemanticAnalyzer::insertCast(ast::ASTNodePtr node, ts::Type to)
+{
+    ts::Type from = getType(node);
+
+    if (from == to) {
+        return;
+    }
+    if (!isImplicitlyCastable(from, to)) {
+        throw SemanticError(node->getLocation(), "types do not match");
+    }
+
+    ast::ASTNodePtr parent   = node->getParent().lock();
+    ast::ASTNodePtr castNode = std::make_shared<ast::ASTNode>(ast::ImplicitTypeCast(from, to));
+
+    parent->replaceChild(node, castNode);
+
+    castNode->addChild(node);
+    castNode->setLocation(node->getLocation());
+}
+
+// constant of type to with the value the cast of node gives at runtime, nullptr if node isn't constant
+static ast::ASTNodePtr foldConstant(const ast::ASTNodePtr& node, ts::Type to)
+{
+    const ast::Float* f     = std::get_if<ast::Float>(&node->getData());
+    std::int32_t      value = 0;
+
+    if (const ast::Integer* i = std::get_if<ast::Integer>(&node->getData())) {
+        value = i->getValue();
+    }
+    else if (const ast::Boolean* b = std::get_if<ast::Boolean>(&node->getData())) {
+        value = b->getValue();
+    }
+    else if (!f) {
+        return nullptr;
+    }
+
+    switch (to) {
+        case ts::Type::float_t:
+            return std::make_shared<ast::ASTNode>(ast::Float(f ? f->getValue() : static_cast<float>(value)));
+        case ts::Type::bool_t:
+            // NaN is true
+            return std::make_shared<ast::ASTNode>(ast::Boolean(f ? f->getValue() != 0.0f : value != 0));
+        case ts::Type::int_t:
+            [[fallthrough]];
+        case ts::Type::char_t:
+            // truncation gives INT_MIN for NaN and values out of range
+            if (f) {
+                bool inRange = f->getValue() >= -0x1p31f && f->getValue() < 0x1p31f;
+                value        = inRange ? static_cast<std::int32_t>(f->getValue()) : std::numeric_limits<std::int32_t>::min();
+            }
+            if (to == ts::Type::char_t) {
+                value = static_cast<std::int8_t>(value);
+            }
+            return std::make_shared<ast::ASTNode>(ast::Integer(value, to));
+        default:
+            return nullptr;
+    }
+}
+
+// (to)(mid)x is (to)x if mid holds every value of from exactly,
+// or if the cast to bool only tests for zero, which survives int to float
+static bool mergeableCasts(ts::Type from, ts::Type mid, ts::Type to)
+{
+    bool exact = (from == ts::Type::bool_t || from == ts::Type::char_t) &&
+                 (mid == ts::Type::int_t || mid == ts::Type::float_t);
+    bool zeroTest = from == ts::Type::int_t && mid == ts::Type::float_t && to == ts::Type::bool_t;
+
+    return (exact || zeroTest) && (from == to || isImplicitlyCastable(from, to));
+}
+
+// constant index of array[index] needs no runtime check, folding may turn an index into a constant
+static void checkConstantIndex(const ast::ASTNodePtr& node)
+{
+    ast::BinaryExpr&    subscript = std::get<ast::BinaryExpr>(node->getData());
+    const ast::Integer* i         = std::get_if<ast::Integer>(&node->getChildren().back()->getData());
+
+    if (!i) {
+        return;
+    }
+
+    const Symbol& sym = *std::get<ast::Identifier>(node->getChildren().front()->getData()).getSymbol();
+
+    if (i->getValue() < 0 || static_cast<std::uint32_t>(i->getValue()) >= sym.length) {
+        throw SemanticError(node->getLocation(), "array index out of range");
+    }
+    subscript.setBoundsChecked(false);
+}
+
+// evaluation may exit on a failed bounds check or a division fault, so it can't be dropped
+static bool canTrap(const ast::ASTNodePtr& node)
+{
+    if (const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&node->getData())) {
+        if ((be->getLiteral() == "[]" && be->isBoundsChecked()) ||
+            (be->getLiteral() == "/" && be->getType() != ts::Type::float_t)) {
+            return true;
+        }
+    }
+    return std::ranges::any_of(node->getChildren(), canTrap);
+}
+
+// a && b or a || b with a constant operand, nullptr if it can't be folded;
+// the left operand is always evaluated, so it is dropped only if it can't trap
+static ast::ASTNodePtr foldLogical(const ast::ASTNodePtr& node)
+{
+    bool                   isAnd = std::get<ast::BinaryExpr>(node->getData()).getLiteral() == "&&";
+    const ast::ASTNodePtr& left  = node->getChildren().front();
+    const ast::ASTNodePtr& right = node->getChildren().back();
+
+    // false && x is false, true || x is true, right operand isn't evaluated
+    // true && x and false || x are x
+    if (const ast::Boolean* b = std::get_if<ast::Boolean>(&left->getData())) {
+        return b->getValue() != isAnd ? left : right;
+    }
+    // x && true and x || false are x
+    // x && false is false and x || true is true if x can't trap
+    if (const ast::Boolean* b = std::get_if<ast::Boolean>(&right->getData())) {
+        if (b->getValue() == isAnd) {
+            return left;
+        }
+        if (!canTrap(left)) {
+            return right;
+        }
+    }
+    return nullptr;
+}
+
+void SemanticAnalyzer::foldCasts(ast::ASTNodePtr& node)
+{
+    for (ast::ASTNodePtr& c : node->getChildren()) {
+        foldCasts(c);
+    }
+
+    if (const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&node->getData())) {
+        if (be->getLiteral() == "[]") {
+            checkConstantIndex(node);
+        }
+        if (be->getLiteral() != "&&" && be->getLiteral() != "||") {
+            return;
+        }
+        if (ast::ASTNodePtr result = foldLogical(node)) {
+            ast::ASTNodePtr old = node;
+            node->getParent().lock()->replaceChild(old, result);
+        }
+        return;
+    }
+
+    const ast::ImplicitTypeCast* cast = std::get_if<ast::ImplicitTypeCast>(&node->getData());
+
+    if (!cast) {
+        return;
+    }
+
+    ts::Type        to      = cast->getToCast();
+    ast::ASTNodePtr operand = node->getChildren().front();
+
+    // inner casts are already folded, so there is at most one
+    if (const ast::ImplicitTypeCast* inner = std::get_if<ast::ImplicitTypeCast>(&operand->getData())) {
+        if (mergeableCasts(inner->getFromCast(), inner->getToCast(), to)) {
+            operand = operand->getChildren().front();
+        }
+    }
+
+    ast::ASTNodePtr result;
+
+    if (getType(operand) == to) {
+        result = operand;
+    }
+    else if ((result = foldConstant(operand, to))) {
+        result->setLocation(operand->getLocation());
+    }
+    else if (operand != node->getChildren().front()) {
+        result = std::make_shared<ast::ASTNode>(ast::ImplicitTypeCast(getType(operand), to));
+        result->addChild(operand);
+        result->setLocation(node->getLocation());
+    }
+    else {
+        return;
+    }
+
+    ast::ASTNodePtr old = node;
+    node->getParent().lock()->replaceChild(old, result);
+}
+
+// value of an int, char or float constant, the sign of a float zero is kept
+static std::optional<double> constantValue(const ast::ASTNodePtr& node)
+{
+    if (const ast::Integer* i = std::get_if<ast::Integer>(&node->getData())) {
+        return i->getValue();
+    }
+    if (const ast::Float* f = std::get_if<ast::Float>(&node->getData())) {
+        return f->getValue();
+    }
+    return std::nullopt;
+}
+
+static bool isSameVariable(const ast::ASTNodePtr& left, const ast::ASTNodePtr& right)
+{
+    const ast::Identifier* l = std::get_if<ast::Identifier>(&left->getData());
+    const ast::Identifier* r = std::get_if<ast::Identifier>(&right->getData());
+
+    return l && r && l->getSymbol() && l->getSymbol() == r->getSymbol();
+}
+
+void SemanticAnalyzer::simplify(ast::ASTNodePtr& node)
+{
+    for (ast::ASTNodePtr& c : node->getChildren()) {
+        simplify(c);
+    }
+
+    // -c is a constant, int negation wraps
+    if (const ast::UnaryExpr* ue = std::get_if<ast::UnaryExpr>(&node->getData())) {
+        const ast::ASTNodePtr& operand = node->getChildren().front();
+        ast::ASTNodePtr        result;
+
+        if (const ast::Integer* i = std::get_if<ast::Integer>(&operand->getData())) {
+            std::int32_t value = static_cast<std::int32_t>(0u - static_cast<std::uint32_t>(i->getValue()));
+            result             = std::make_shared<ast::ASTNode>(ast::Integer(value, ue->getType()));
+        }
+        else if (const ast::Float* f = std::get_if<ast::Float>(&operand->getData())) {
+            result = std::make_shared<ast::ASTNode>(ast::Float(-f->getValue()));
+        }
+        else {
+            return;
+        }
+
+        result->setLocation(node->getLocation());
+
+        ast::ASTNodePtr old = node;
+        node->getParent().lock()->replaceChild(old, result);
+        return;
+    }
+
+    const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&node->getData());
+
+    if (be && be->getLiteral() == "[]") {
+        checkConstantIndex(node);
+        return;
+    }
+    if (!be || !(be->getLiteral() == "+" || be->getLiteral() == "-" || be->getLiteral() == "*" ||
+                 be->getLiteral() == "/")) {
+        return;
+    }
+
+    std::string op       = be->getLiteral();
+    ts::Type    type     = be->getType();
+    auto&       children = node->getChildren();
+
+    // the right operand of the backends can be an immediate
+    if ((op == "+" || op == "*") && constantValue(children.front()) && !constantValue(children.back())) {
+        std::swap(children.front(), children.back());
+    }
+
+    const ast::ASTNodePtr& left  = children.front();
+    const ast::ASTNodePtr& right = children.back();
+    std::optional<double>  c     = constantValue(right);
+
+    if (!c) {
+        if (op != "-" || type == ts::Type::float_t || !isSameVariable(left, right)) {
+            return;
+        }
+
+        // x - x
+        ast::ASTNodePtr result = std::make_shared<ast::ASTNode>(ast::Integer(0, type));
+        result->setLocation(node->getLocation());
+
+        ast::ASTNodePtr old = node;
+        node->getParent().lock()->replaceChild(old, result);
+        return;
+    }
+
+    bool            zero = *c == 0.0;
+    bool            one  = *c == 1.0;
+    ast::ASTNodePtr result;
+
+    if (type != ts::Type::float_t) {
+        if ((zero && (op == "+" || op == "-")) || (one && (op == "*" || op == "/"))) {
+            result = left;
+        }
+        // x * 0 is the constant
+        else if (zero && op == "*" && !canTrap(left)) {
+            result = right;
+        }
+    }
+    // x + -0, x - +0, x * 1 and x / 1 are x, -0 + +0 is +0
+    else if ((zero && op == "+" && std::signbit(*c)) || (zero && op == "-" && !std::signbit(*c)) ||
+             (one && (op == "*" || op == "/"))) {
+        result = left;
+    }
+    // a power of two has an exact reciprocal, so x / c rounds the same as x * (1 / c)
+    else if (op == "/" && !zero && std::isfinite(*c)) {
+        int    exponent = 0;
+        double mantissa = std::frexp(*c, &exponent);
+        double inverse  = 1.0 / *c;
+
+        if (std::abs(mantissa) != 0.5 || std::abs(inverse) < std::numeric_limits<float>::min() ||
+            std::abs(inverse) > std::numeric_limits<float>::max()) {
+            return;
+        }
+
+        ast::ASTNodePtr reciprocal = std::make_shared<ast::ASTNode>(ast::Float(static_cast<float>(inverse)));
+        reciprocal->setLocation(right->getLocation());
+
+        result = std::make_shared<ast::ASTNode>(ast::BinaryExpr("*", type));
+        result->setLocation(node->getLocation());
+        result->addChild(left);
+        result->addChild(reciprocal);
+    }
+
+    if (!result) {
+        return;
+    }
+
+    ast::ASTNodePtr old = node;
+    node->getParent().lock()->replaceChild(old, result);
+}
+
+// left && right, left || right, operands are converted to bool
+void SemanticAnalyzer::resolveLogical(ast::ASTNodePtr& node)
+{
+    // insertCast replaces children
+    ast::ASTNodePtr left  = node->getChildren().front();
+    ast::ASTNodePtr right = node->getChildren().back();
+
+    for (const ast::ASTNodePtr& operand : {left, right}) {
+        if (isArray(operand)) {
+            throw SemanticError(node->getLocation(), "array cannot be used as a value");
+        }
+        if (getType(operand) == ts::Type::struct_t) {
+            throw SemanticError(node->getLocation(), "struct cannot be used as a value");
+        }
+        insertCast(operand, ts::Type::bool_t);
+    }
+}
+
+// array[index]
+void SemanticAnalyzer::resolveSubscript(ast::ASTNodePtr& node)
+{
+    ast::BinaryExpr&       subscript = std::get<ast::BinaryExpr>(node->getData());
+    const ast::ASTNodePtr& array     = node->getChildren().front();
+    const ast::ASTNodePtr& index     = node->getChildren().back();
+
+    if (!isArray(array)) {
+        throw SemanticError(node->getLocation(), "subscripted value is not an array");
+    }
+    if (isArray(index)) {
+        throw SemanticError(index->getLocation(), "array cannot be used as a value");
+    }
+
+    const Symbol& sym = *std::get<ast::Identifier>(array->getData()).getSymbol();
+
+    subscript.setType(sym.type);
+
+    if (getType(index) == ts::Type::float_t) {
+        throw SemanticError(index->getLocation(), "array index must be integer");
+    }
+    insertCast(index, ts::Type::int_t);
+    checkConstantIndex(node);
+}
+
+// target = value, value is converted to type of target
+void SemanticAnalyzer::resolveAssignment(ast::ASTNodePtr& node)
+{
+    ast::BinaryExpr&       assignment = std::get<ast::BinaryExpr>(node->getData());
+    const ast::ASTNodePtr& target     = node->getChildren().front();
+    const ast::ASTNodePtr& value      = node->getChildren().back();
+
+    if (isArray(target) || isArray(value)) {
+        throw SemanticError(node->getLocation(), "array cannot be assigned");
+    }
+
+    ts::Type type = getType(target);
+
+    if (type == ts::Type::struct_t) {
+        throw SemanticError(node->getLocation(), "struct cannot be assigned, assign its fields");
+    }
+
+    assignment.setType(type);
+    insertCast(value, type);
+}
+
+bool SemanticAnalyzer::isMemberAccess(const ast::ASTNodePtr& node)
+{
+    const ast::BinaryExpr* be = node ? std::get_if<ast::BinaryExpr>(&node->getData()) : nullptr;
+
+    return be && be->getLiteral() == ".";
+}
+
+// struct definition
+void SemanticAnalyzer::resolveStruct(ast::ASTNodePtr& node)
+{
+    const ast::StructDecl& def = std::get<ast::StructDecl>(node->getData());
+
+    if (!std::holds_alternative<ast::Root>(node->getParent().lock()->getData())) {
+        throw SemanticError(node->getLocation(), "struct must be defined at global scope");
+    }
+    if (m_symbolTable.findStruct(def.getName())) {
+        throw SemanticError(node->getLocation(), "struct already defined: " + def.getName());
+    }
+    if (def.getFields().empty()) {
+        throw SemanticError(node->getLocation(), "struct has no fields");
+    }
+
+    std::shared_ptr<StructType> type = std::make_shared<StructType>();
+    type->name                       = def.getName();
+    type->soa                        = def.isSoA();
+
+    for (const auto& [fieldType, name] : def.getFields()) {
+        if (type->getField(name)) {
+            throw SemanticError(node->getLocation(), "field already declared: " + name);
+        }
+
+        Symbol field{fieldType, ts::TypeSize[fieldType], 0, 0, 0};
+        field.align = ts::TypeSize[fieldType];
+        SYMBOL_SET_FLAG(field, SYMBOL_FLAG_FIELD);
+
+        type->fields.emplace_back(name, std::make_shared<Symbol>(field));
+    }
+
+    type->layout();
+    m_symbolTable.insertStruct(type);
+}
+
+// value.field, offset of field is known at compile time
+void SemanticAnalyzer::resolveMember(ast::ASTNodePtr& node)
+{
+    ast::BinaryExpr&       member = std::get<ast::BinaryExpr>(node->getData());
+    const ast::ASTNodePtr& value  = node->getChildren().front();
+    ast::Identifier&       field  = std::get<ast::Identifier>(node->getChildren().back()->getData());
+
+    std::shared_ptr<StructType> type;
+
+    if (const ast::Identifier* id = std::get_if<ast::Identifier>(&value->getData())) {
+        if (!isArray(value)) {
+            type = id->getSymbol()->structType;
+        }
+    }
+    else if (const ast::BinaryExpr* be = std::get_if<ast::BinaryExpr>(&value->getData());
+             be && be->getLiteral() == "[]") {
+        type = std::get<ast::Identifier>(value->getChildren().front()->getData()).getSymbol()->structType;
+    }
+
+    if (!type) {
+        throw SemanticError(node->getLocation(), "member access of non-struct value");
+    }
+
+    std::shared_ptr<Symbol> sym = type->getField(field.getName());
+
+    if (!sym) {
+        throw SemanticError(node->getChildren().back()->getLocation(),
+                            std::format("struct {} has no field {}", type->name, field.getName()));
+    }
+
+    field.setSymbol(sym);
+    member.setType(sym->type);
+}
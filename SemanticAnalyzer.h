@@ -38,6 +38,33 @@ private:
 
     ts::Type getType(const ast::ASTNodePtr& node);
 
+    // checks that identifier refers to an array
+    bool isArray(const ast::ASTNodePtr& node);
+
+    // wraps node in ImplicitTypeCast to a given type if needed
+    void insertCast(ast::ASTNodePtr node, ts::Type to);
+
+    // replaces casts of constants by constants of the target type, merges chains of casts
+    // and removes casts to the type the operand already has
+    // logical operators with a constant operand are replaced by the operand that decides them
+    // unless that drops an operand that can trap,
+    // array indices that became constant are range-checked again
+    void foldCasts(ast::ASTNodePtr& node);
+
+    // folds negated constants and reduces algebraic identities of arithmetic: x + 0, x * 1, x * 0, x - x and the like,
+    // constants of + and * are moved to the right, float division by a power of two becomes multiplication;
+    // float rules hold for NaN, infinities and signed zeros, array indices that became constant are range-checked again
+    void simplify(ast::ASTNodePtr& node);
+
+    // checks that node is struct member access
+    bool isMemberAccess(const ast::ASTNodePtr& node);
+
+    void resolveStruct(ast::ASTNodePtr& node);
+    void resolveSubscript(ast::ASTNodePtr& node);
+    void resolveAssignment(ast::ASTNodePtr& node);
+    void resolveMember(ast::ASTNodePtr& node);
+    void resolveLogical(ast::ASTNodePtr& node);
+
     template <typename T>
     T calculate(const ast::ASTNodePtr& node)
     {
@@ -74,6 +101,12 @@ private:
         else if (op == "!=") {
             return getValue<T>(node->getChildren().front()) != getValue<T>(node->getChildren().back());
         }
+        else if (op == "&&") {
+            return getValue<T>(node->getChildren().front()) != 0 && getValue<T>(node->getChildren().back()) != 0;
+        }
+        else if (op == "||") {
+            return getValue<T>(node->getChildren().front()) != 0 || getValue<T>(node->getChildren().back()) != 0;
+        }
 
         return 0;
     }
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// SHA-256 digest (FIPS 180-4) of data given in any number of pieces
+class Sha256
+{
+public:
+    Sha256();
+    ~Sha256() {}
+
+    Sha256(const Sha256&)            = delete;
+    Sha256(Sha256&&)                 = delete;
+    Sha256& operator=(const Sha256&) = delete;
+    Sha256& operator=(Sha256&&)      = delete;
+
+    void update(const void* data, std::size_t size);
+    void update(std::string_view s) { update(s.data(), s.size()); }
+
+    // digest as 64 lowercase hex digits, no more data can be added
+    std::string hex();
+
+private:
+    // compresses one 64-byte block into the state
+    void block(const std::uint8_t* p);
+
+private:
+    std::array<std::uint32_t, 8> m_state;
+    std::array<std::uint8_t, 64> m_buffer;
+    std::size_t                  m_buffered = 0;
+    std::uint64_t                m_length   = 0; // in bytes
+};
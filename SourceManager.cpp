@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+#include "SourceManager.h"
+
+const SourceManager::Buffer& SourceManager::add(std::string name, std::string text)
+{
+    auto buffer   = std::make_unique<Buffer>();
+    buffer->name  = std::move(name);
+    buffer->owned = std::move(text);
+    buffer->text  = buffer->owned;
+
+    return index(std::move(buffer));
+}
+
+const SourceManager::Buffer& SourceManager::addView(std::string name, std::string_view text)
+{
+    auto buffer  = std::make_unique<Buffer>();
+    buffer->name = std::move(name);
+    buffer->text = text;
+
+    return index(std::move(buffer));
+}
+
+void SourceManager::clear()
+{
+    m_buffers.clear();
+    m_end = 0;
+}
+
+const SourceManager::Buffer& SourceManager::index(std::unique_ptr<Buffer> buffer)
+{
+    // one past the end is the location of end of input, Location::NONE stays free
+    if (buffer->text.size() >= Location::NONE - m_end) {
+        throw InterpretError(std::format("{}: sources larger than 4 GiB are not supported", buffer->name));
+    }
+
+    buffer->base = m_end;
+    m_end += buffer->text.size() + 1;
+
+    // memchr scans many bytes at a time
+    const char* begin = buffer->text.data();
+    const char* end   = begin + buffer->text.size();
+
+    buffer->lineStarts.push_back(0);
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); p++) {
+        buffer->lineStarts.push_back(p + 1 - begin);
+    }
+
+    m_buffers.push_back(std::move(buffer));
+    return *m_buffers.back();
+}
+
+SourceManager::Position SourceManager::decode(const Location& loc) const
+{
+    auto buffer = std::ranges::upper_bound(m_buffers, loc.offset, {}, [](const auto& b) { return b->base; });
+
+    if (loc.offset == Location::NONE || buffer == m_buffers.begin()) {
+        return {};
+    }
+
+    const Buffer& b      = **std::prev(buffer);
+    std::uint32_t offset = loc.offset - b.base;
+
+    auto          start = std::ranges::upper_bound(b.lineStarts, offset) - 1;
+    std::uint32_t line  = start - b.lineStarts.begin() + 1;
+
+    std::string_view text = b.text.substr(*start);
+    text                  = text.substr(0, text.find('\n'));
+
+    return {b.name, line, offset - *start + 1, text};
+}
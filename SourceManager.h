@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Common.h"
+
+// owns source buffers and maps offsets of locations back to lines and columns
+// offsets of a buffer start after the end of the previous one, so one 32-bit offset names a character in any of them
+class SourceManager
+{
+public:
+    SourceManager() {}
+    ~SourceManager() {}
+
+    SourceManager(const SourceManager&)            = delete;
+    SourceManager(SourceManager&&)                 = delete;
+    SourceManager& operator=(const SourceManager&) = delete;
+    SourceManager& operator=(SourceManager&&)      = delete;
+
+    struct Buffer
+    {
+        std::string                name;
+        std::string                owned; // empty if text is borrowed
+        std::string_view           text;
+        std::uint32_t              base;       // offset of the first character
+        std::vector<std::uint32_t> lineStarts; // offsets in text, the first is 0
+    };
+
+    // throws InterpretError if the buffers don't fit into 32-bit offsets
+    const Buffer& add(std::string name, std::string text);
+
+    // text isn't copied, it must outlive the manager
+    const Buffer& addView(std::string name, std::string_view text);
+
+    void clear();
+
+    struct Position
+    {
+        std::string_view name;
+        std::uint32_t    line   = 0; // from 1, 0 for a location without offset
+        std::uint32_t    column = 0; // from 1
+        std::string_view lineText;   // without line break
+    };
+
+    // binary searches the buffer and its line
+    Position decode(const Location& loc) const;
+
+private:
+    // sets base and finds line starts
+    const Buffer& index(std::unique_ptr<Buffer> buffer);
+
+private:
+    std::vector<std::unique_ptr<Buffer>> m_buffers; // text of moved buffer would move with small string
+    std::uint32_t                        m_end = 0; // base of next buffer
+};
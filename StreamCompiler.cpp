@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "DataLayout.h"
+#include "FrameAllocator.h"
+#include "Lexer.h"
+#include "LoopAnalyzer.h"
+#include "Parser.h"
+#include "Profiler.h"
+#include "SemanticAnalyzer.h"
+#include "StreamCompiler.h"
+
+void StreamCompiler::compile(std::istream& in, AsmWriter& out)
+{
+    TimeScope scope("stream");
+
+    Lexer            lexer;
+    Parser           parser;
+    SemanticAnalyzer sa;
+    LoopAnalyzer     la(true);
+    FrameAllocator   fa(sa.getSymbolTable());
+    DataLayout       dl(sa.getSymbolTable());
+
+    // gets the symbol table at the end, statements only refer to their symbols
+    Interpreter interpreter(SymbolTable(), m_simd, false, m_unroll);
+
+    lexer.start(in);
+    parser.start(lexer);
+
+    const x86::Program& program = interpreter.interpretBegin();
+    x86::printTextHeader(program, out);
+    x86::printText(program, out);
+
+    // statements are children of root, the previous one is kept for loops that look at it
+    ast::ASTNodePtr root  = std::make_shared<ast::ASTNode>(ast::Root());
+    std::size_t     frame = 0;
+
+    while (ast::ASTNodePtr statement = parser.next()) {
+        ast::ASTNodePtr& s = root->addChild(statement);
+
+        sa.analyze(s);
+        la.analyze(s);
+
+        // locals don't outlive their statement, so the frame fits the largest one
+        fa.allocate(s);
+        frame = std::max(frame, sa.getSymbolTable().getFrameSize());
+
+        dl.record(s);
+
+        x86::printText(interpreter.interpretStatement(s), out);
+
+        if (root->getChildren().size() > 1) {
+            root->getChildren().pop_front();
+        }
+        sa.getSymbolTable().clearLocalScopes();
+    }
+
+    sa.getSymbolTable().setFrameSize(frame);
+    dl.layoutGlobals();
+
+    interpreter.interpretEnd(std::move(sa.getSymbolTable()));
+    x86::printText(program, out);
+
+    out.print<"\n{} equ {}\n">(Interpreter::FRAME_LABEL, interpreter.frameSize());
+    x86::printGlobals(program, out);
+}
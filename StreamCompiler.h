@@ -0,0 +1,35 @@
+#pragma once
+
+#include <istream>
+
+#include "AsmWriter.h"
+#include "Interpreter.h"
+
+// compiles one top-level statement at a time and prints its code right away,
+// memory holds the tokens and AST of at most two statements and the global scope
+// output is NASM source that assembles to the same program as printNASM,
+// with text first and the frame size as a constant after it,
+// except that field arrays of every global SoA array are aligned for vector access
+class StreamCompiler
+{
+public:
+    StreamCompiler(SimdLevel simd = SimdLevel::SSE, std::size_t unroll = Interpreter::DEFAULT_UNROLL)
+    : m_simd(simd),
+      m_unroll(unroll)
+    {
+    }
+    ~StreamCompiler() {}
+
+    StreamCompiler(const StreamCompiler&)            = delete;
+    StreamCompiler(StreamCompiler&&)                 = delete;
+    StreamCompiler& operator=(const StreamCompiler&) = delete;
+    StreamCompiler& operator=(StreamCompiler&&)      = delete;
+
+    // reads in by chunks, throws the errors of the phases
+    // text of statements before an error has already been written to out
+    void compile(std::istream& in, AsmWriter& out);
+
+private:
+    SimdLevel   m_simd;
+    std::size_t m_unroll;
+};
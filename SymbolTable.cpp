@@ -1,14 +1,80 @@
+#include <algorithm>
+
 #include "SymbolTable.h"
 #include <iostream>
 
+//=====----- StructType class -----=====//
+void StructType::layout()
+{
+    declaredSize = 0;
+    for (const auto& [name, field] : fields) {
+        declaredSize = alignTo(declaredSize, field->align) + field->size;
+        align        = std::max(align, field->align);
+    }
+    declaredSize = alignTo(declaredSize, align);
+
+    // stable, so fields of equal alignment keep declaration order
+    std::ranges::stable_sort(fields, [](const auto& a, const auto& b) { return a.second->align > b.second->align; });
+
+    size = 0;
+    for (const auto& [name, field] : fields) {
+        size          = alignTo(size, field->align);
+        field->offset = size;
+        size += field->size;
+    }
+    size = alignTo(size, align);
+}
+
+std::shared_ptr<Symbol> StructType::getField(const std::string& name) const
+{
+    auto it = std::ranges::find(fields, name, &std::pair<std::string, std::shared_ptr<Symbol>>::first);
+
+    return it != fields.end() ? it->second : nullptr;
+}
+
+// alignment of the field array of field in SoA array of length elements
+static std::uint32_t fieldArrayAlignment(const Symbol& field, std::uint32_t length, bool vector)
+{
+    return vector ? ts::arrayAlignment(field.size * length) : field.align;
+}
+
+std::uint32_t StructType::arraySize(std::uint32_t length, bool vector) const
+{
+    if (!soa) {
+        return size * length;
+    }
+
+    std::uint32_t total = 0;
+    for (const auto& [name, field] : fields) {
+        total = alignTo(total, fieldArrayAlignment(*field, length, vector)) + field->size * length;
+    }
+    return total;
+}
+
+std::uint32_t StructType::soaOffset(const Symbol& field, std::uint32_t length, bool vector) const
+{
+    std::uint32_t offset = 0;
+    for (const auto& [name, f] : fields) {
+        offset = alignTo(offset, fieldArrayAlignment(*f, length, vector));
+        if (f.get() == &field) {
+            break;
+        }
+        offset += f->size * length;
+    }
+    return offset;
+}
+
 //=====----- Scope class -----=====//
 void Scope::insert(const std::string& name, const Symbol& sym)
 {
     m_symbols[name] = std::make_shared<Symbol>(sym);
     if (!m_global) {
-        m_currentOffset += sym.size;
+        m_currentOffset         = alignTo(m_currentOffset + sym.size, sym.align);
         m_symbols[name]->offset = m_currentOffset;
     }
+    else {
+        SYMBOL_SET_FLAG((*m_symbols[name]), SYMBOL_FLAG_GLOBAL);
+    }
 }
 
 std::shared_ptr<Symbol> Scope::get(const std::string& name)
@@ -34,6 +100,11 @@ void SymbolTable::exitScope()
     m_currentScope = m_currentScope->getParent();
 }
 
+void SymbolTable::clearLocalScopes()
+{
+    std::erase_if(m_scopes, [](const auto& e) { return e.first != 0; });
+}
+
 void SymbolTable::insert(const std::string& name, const Symbol& sym)
 {
     if (!m_currentScope->get(name)) {
@@ -56,3 +127,15 @@ bool SymbolTable::inThisScope(const std::string& name)
 {
     return m_currentScope->get(name) != nullptr;
 }
+
+void SymbolTable::insertStruct(const std::shared_ptr<StructType>& type)
+{
+    m_structs[type->name] = type;
+}
+
+std::shared_ptr<StructType> SymbolTable::findStruct(const std::string& name) const
+{
+    auto it = m_structs.find(name);
+
+    return it != m_structs.end() ? it->second : nullptr;
+}
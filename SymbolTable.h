@@ -6,6 +6,8 @@
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #ifdef DEBUG
 #include <iostream>
@@ -17,23 +19,71 @@
 #define SYMBOL_FLAG_CONST       (1 << 1)
 #define SYMBOL_FLAG_COMPILETIME (1 << 2)
 #define SYMBOL_FLAG_USED        (1 << 3)
+#define SYMBOL_FLAG_ARRAY       (1 << 4)
+#define SYMBOL_FLAG_GLOBAL      (1 << 5)
+#define SYMBOL_FLAG_FIELD       (1 << 6)
+#define SYMBOL_FLAG_VECTOR      (1 << 7)
 
 #define SYMBOL_SET_FLAG(s, f) (s.flags |= (f))
 #define SYMBOL_GET_FLAG(s, f) (s.flags & (f))
 
+struct StructType;
+
 struct Symbol
 {
-    ts::Type     type;
-    std::uint8_t size; // size in bytes
+    ts::Type      type; // element type for arrays
+    std::uint32_t size; // size in bytes
     //
     // 000000001 - initialized
     // 000000010 - const
     // 000000100 - compile-time - can be calculated in compile time
     // 000001000 - used in expressions
+    // 000010000 - array of length elements
+    // 000100000 - global, stored in .data/.bss instead of stack frame
+    // 001000000 - struct field, offset is relative to the start of struct
+    // 010000000 - SoA array accessed by a vectorized loop
     //
     std::uint8_t  flags  = 0;
-    std::size_t   offset = 0; // offset in bytes from base of stack frame
+    std::size_t   offset = 0; // offset from base of stack frame (FrameAllocator) or section (DataLayout)
     std::uint32_t value  = 0;
+    std::uint32_t align  = 1; // required alignment in bytes
+    std::uint32_t length = 0; // number of elements for arrays
+
+    std::shared_ptr<StructType> structType = nullptr; // layout of struct_t values
+};
+
+// user defined aggregate type
+// fields are reordered by decreasing alignment, so padding is minimal
+struct StructType
+{
+    std::string name;
+    bool        soa = false; // arrays of this type are stored as one array per field
+
+    std::vector<std::pair<std::string, std::shared_ptr<Symbol>>> fields; // in memory order
+
+    std::uint32_t size         = 0; // size with tail padding
+    std::uint32_t align        = 1;
+    std::uint32_t declaredSize = 0; // size if fields were laid out in declaration order
+
+    // computes field offsets, fields are given in declaration order
+    void layout();
+
+    std::shared_ptr<Symbol> getField(const std::string& name) const;
+
+    // size of an array of length elements, field arrays of SoA arrays are aligned
+    // to their element type, or for vector access if vector is set
+    std::uint32_t arraySize(std::uint32_t length, bool vector = false) const;
+    // offset of the field array inside SoA array of length elements
+    std::uint32_t soaOffset(const Symbol& field, std::uint32_t length, bool vector = false) const;
+};
+
+// global variables of one section in memory order
+struct GlobalSection
+{
+    std::vector<std::pair<std::string, std::shared_ptr<Symbol>>> symbols;
+
+    std::uint32_t size    = 0;
+    std::uint32_t padding = 0; // bytes skipped to align variables
 };
 
 class Scope
@@ -54,6 +104,7 @@ public:
 
     std::shared_ptr<Symbol> get(const std::string& name);
     std::shared_ptr<Scope>  getParent() const { return m_parent; }
+    // end of scoped layout, final offsets are assigned by FrameAllocator
     std::size_t             getOffset() const { return m_currentOffset; }
     std::size_t             getSize() const { return m_symbols.size(); }
 
@@ -74,18 +125,41 @@ class SymbolTable
 {
 public:
     SymbolTable() { m_currentScope = nullptr; }
-    SymbolTable(SymbolTable&& o) : m_scopes(std::move(o.m_scopes)), m_currentScope(std::move(o.m_currentScope)){};
+    SymbolTable(SymbolTable&& o)
+    : m_scopes(std::move(o.m_scopes)),
+      m_currentScope(std::move(o.m_currentScope)),
+      m_structs(std::move(o.m_structs)),
+      m_frameSize(o.m_frameSize),
+      m_data(std::move(o.m_data)),
+      m_bss(std::move(o.m_bss)){};
+    SymbolTable& operator=(SymbolTable&&) = default;
     ~SymbolTable() {}
 
     std::shared_ptr<Scope>& operator[](std::size_t id) { return m_scopes[id]; }
 
     void enterScope(std::size_t id);
     void exitScope();
+    // drops scopes of blocks, their symbols live as long as AST refers to them
+    void clearLocalScopes();
     void insert(const std::string& name, const Symbol& sym);
 
     std::shared_ptr<Symbol> find(const std::string& name);
     bool                    inThisScope(const std::string& name);
 
+    // struct types share one global namespace
+    void                        insertStruct(const std::shared_ptr<StructType>& type);
+    std::shared_ptr<StructType> findStruct(const std::string& name) const;
+
+    const std::map<std::string, std::shared_ptr<StructType>>& getStructs() const { return m_structs; }
+
+    // bytes used by local variables, set by frame allocation
+    void        setFrameSize(std::size_t size) { m_frameSize = size; }
+    std::size_t getFrameSize() const { return m_frameSize; }
+
+    // globals in .data and .bss, set by data layout
+    GlobalSection& getData() { return m_data; }
+    GlobalSection& getBss() { return m_bss; }
+
     std::unordered_map<std::size_t, std::shared_ptr<Scope>>::iterator       begin() { return m_scopes.begin(); }
     std::unordered_map<std::size_t, std::shared_ptr<Scope>>::iterator       end() { return m_scopes.end(); }
     std::unordered_map<std::size_t, std::shared_ptr<Scope>>::const_iterator begin() const { return m_scopes.begin(); }
@@ -94,4 +168,8 @@ public:
 private:
     std::unordered_map<std::size_t, std::shared_ptr<Scope>> m_scopes;
     std::shared_ptr<Scope>                                  m_currentScope;
+    std::map<std::string, std::shared_ptr<StructType>>      m_structs;
+    std::size_t                                             m_frameSize = 0;
+    GlobalSection                                           m_data;
+    GlobalSection                                           m_bss;
 };
@@ -25,6 +25,6 @@ public:
 
 private:
     TokenKind m_kind;
+    Location  m_loc; // fills padding after kind
     std::any  m_data;
-    Location  m_loc;
 };
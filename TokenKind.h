@@ -2,6 +2,7 @@
 
 #define IS_TYPENAME(x) ((x) >= TokenKind::KW_INT && (x) <= TokenKind::KW_CHAR)
 #define IS_RELOP(x)    ((x) >= TokenKind::GREATER && (x) <= TokenKind::NE)
+#define IS_LOGOP(x)    ((x) == TokenKind::AND || (x) == TokenKind::OR)
 
 enum TokenKind
 {
@@ -42,6 +43,7 @@ enum TokenKind
     KW_CHAR,
 
     // keyword
+    KW_STRUCT,
     KW_CONST,
     KW_TRUE,
     KW_FALSE,
@@ -86,6 +88,7 @@ static const char* const TokNames[] =
      "KW_FLOAT",
      "KW_BOOL",
      "KW_CHAR",
+     "KW_STRUCT",
      "KW_CONST",
      "KW_TRUE",
      "KW_FALSE",
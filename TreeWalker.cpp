@@ -0,0 +1,381 @@
+#include <cstring>
+#include <format>
+
+#include "Profiler.h"
+#include "TreeWalker.h"
+
+// thrown on index out of range or division by zero, the program exits with code 1
+struct FaultExit
+{
+};
+
+int TreeWalker::run(const ast::ASTNodePtr& ast)
+{
+    TimeScope scope("walk");
+
+    m_storage.clear();
+
+    // compile-time values are set before the program runs, as in .data
+    for (const auto& [name, sym] : *m_symbolTable[0]) {
+        if (SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_COMPILETIME)) {
+            std::memcpy(variable(*sym), &sym->value, sym->size);
+        }
+    }
+
+    try {
+        execNode(ast);
+    } catch (const FaultExit&) {
+        return 1;
+    }
+    return 0;
+}
+
+const void* TreeWalker::address(const std::string& name)
+{
+    std::shared_ptr<Symbol> sym = m_symbolTable[0]->get(name);
+
+    if (!sym) {
+        throw InterpretError(std::format("undefined symbol {}", name));
+    }
+    return variable(*sym);
+}
+
+void TreeWalker::execNode(const ast::ASTNodePtr& node)
+{
+    std::visit(
+        [&node, this](auto&& arg) -> void
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            if constexpr (std::disjunction_v<std::is_same<T, ast::Root>,
+                                             std::is_same<T, ast::BodyThen>,
+                                             std::is_same<T, ast::BodyElse>>) {
+                for (const ast::ASTNodePtr& c : node->getChildren()) {
+                    execNode(c);
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::Declaration>) {
+                if (node->getChildren().size() == 2) {
+                    store(node->getChildren().front(), evalExpr(node->getChildren().back()));
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                if (arg.getLiteral() != "=") {
+                    error("expression statement is not an assignment");
+                }
+                store(node->getChildren().front(), evalExpr(node->getChildren().back()));
+            }
+            else if constexpr (std::is_same_v<T, ast::Branch>) {
+                auto it = node->getChildren().begin();
+
+                const ast::ASTNodePtr& cond     = *it++;
+                const ast::ASTNodePtr& bodyThen = *it++;
+
+                if (execCondition(cond)) {
+                    execNode(bodyThen);
+                }
+                else if (it != node->getChildren().end()) {
+                    execNode(*it);
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::WhileLoop>) {
+                while (execCondition(node->getChildren().front())) {
+                    execNode(node->getChildren().back());
+                }
+            }
+        },
+        node->getData());
+}
+
+bool TreeWalker::execCondition(const ast::ASTNodePtr& cond)
+{
+    const ast::ASTNodePtr& expr  = cond->getChildren().front();
+    bc::Value              value = evalExpr(expr);
+
+    if (ast::getType(expr) == ts::Type::float_t) {
+        return value.f != 0.0f;
+    }
+    return value.i != 0;
+}
+
+bc::Value TreeWalker::evalExpr(const ast::ASTNodePtr& node)
+{
+    return std::visit(
+        [&node, this](auto&& arg) -> bc::Value
+        {
+            using T = std::decay_t<decltype(arg)>;
+
+            bc::Value value;
+
+            if constexpr (std::is_same_v<T, ast::Integer>) {
+                value.i = arg.getValue();
+            }
+            else if constexpr (std::is_same_v<T, ast::Boolean>) {
+                value.i = arg.getValue();
+            }
+            else if constexpr (std::is_same_v<T, ast::Float>) {
+                value.f = arg.getValue();
+            }
+            else if constexpr (std::is_same_v<T, ast::Identifier>) {
+                const Symbol&       sym = *arg.getSymbol();
+                const std::uint8_t* p   = variable(sym);
+
+                switch (sym.type) {
+                    case ts::Type::int_t:
+                        std::memcpy(&value.i, p, 4);
+                        break;
+                    case ts::Type::float_t:
+                        std::memcpy(&value.f, p, 4);
+                        break;
+                    case ts::Type::bool_t:
+                        value.i = *p;
+                        break;
+                    case ts::Type::char_t:
+                        value.i = static_cast<std::int8_t>(*p);
+                        break;
+                    default:
+                        error("array cannot be used as a value");
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::UnaryExpr>) {
+                value = evalExpr(node->getChildren().front());
+
+                if (arg.getType() == ts::Type::float_t) {
+                    value.f = -value.f;
+                }
+                else {
+                    value.i = bc::wrap(-static_cast<std::int64_t>(value.i));
+                }
+            }
+            else if constexpr (std::is_same_v<T, ast::ImplicitTypeCast>) {
+                value = evalCast(evalExpr(node->getChildren().front()), arg.getFromCast(), arg.getToCast());
+            }
+            else if constexpr (std::is_same_v<T, ast::BinaryExpr>) {
+                value = evalBinary(node);
+            }
+            else {
+                error("node is not an expression");
+            }
+
+            return value;
+        },
+        node->getData());
+}
+
+bc::Value TreeWalker::evalBinary(const ast::ASTNodePtr& node)
+{
+    const ast::BinaryExpr& be = std::get<ast::BinaryExpr>(node->getData());
+    std::string            op = be.getLiteral();
+
+    bc::Value value;
+
+    if (op == "[]" || op == ".") {
+        const std::uint8_t* p = element(node);
+
+        switch (be.getType()) {
+            case ts::Type::int_t:
+                std::memcpy(&value.i, p, 4);
+                break;
+            case ts::Type::float_t:
+                std::memcpy(&value.f, p, 4);
+                break;
+            case ts::Type::bool_t:
+                value.i = *p;
+                break;
+            case ts::Type::char_t:
+                value.i = static_cast<std::int8_t>(*p);
+                break;
+            default:
+                error("cannot evaluate unknown type");
+        }
+        return value;
+    }
+
+    const ast::ASTNodePtr& left  = node->getChildren().front();
+    const ast::ASTNodePtr& right = node->getChildren().back();
+
+    // operands are bool, the right one is only evaluated if the left one doesn't decide
+    if (op == "&&") {
+        value.i = evalExpr(left).i != 0 && evalExpr(right).i != 0;
+        return value;
+    }
+    if (op == "||") {
+        value.i = evalExpr(left).i != 0 || evalExpr(right).i != 0;
+        return value;
+    }
+
+    bc::Value lhs = evalExpr(left);
+    bc::Value rhs = evalExpr(right);
+
+    // both operands have the same type after semantic analysis
+    if (ast::getType(left) == ts::Type::float_t) {
+        if (op == "+") {
+            value.f = lhs.f + rhs.f;
+        }
+        else if (op == "-") {
+            value.f = lhs.f - rhs.f;
+        }
+        else if (op == "*") {
+            value.f = lhs.f * rhs.f;
+        }
+        else if (op == "/") {
+            value.f = lhs.f / rhs.f;
+        }
+        else if (op == "<") {
+            value.i = lhs.f < rhs.f;
+        }
+        else if (op == "<=") {
+            value.i = lhs.f <= rhs.f;
+        }
+        else if (op == ">") {
+            value.i = lhs.f > rhs.f;
+        }
+        else if (op == ">=") {
+            value.i = lhs.f >= rhs.f;
+        }
+        else if (op == "==") {
+            value.i = lhs.f == rhs.f;
+        }
+        else if (op == "!=") {
+            value.i = lhs.f != rhs.f;
+        }
+        else {
+            error(std::format("unknown operator {}", op));
+        }
+        return value;
+    }
+
+    if (op == "+") {
+        value.i = bc::wrap(static_cast<std::int64_t>(lhs.i) + rhs.i);
+    }
+    else if (op == "-") {
+        value.i = bc::wrap(static_cast<std::int64_t>(lhs.i) - rhs.i);
+    }
+    else if (op == "*") {
+        value.i = bc::wrap(static_cast<std::int64_t>(lhs.i) * rhs.i);
+    }
+    else if (op == "/") {
+        if (rhs.i == 0) {
+            throw FaultExit();
+        }
+        value.i = rhs.i == -1 ? bc::wrap(-static_cast<std::int64_t>(lhs.i)) : lhs.i / rhs.i;
+    }
+    else if (op == "<") {
+        value.i = lhs.i < rhs.i;
+    }
+    else if (op == "<=") {
+        value.i = lhs.i <= rhs.i;
+    }
+    else if (op == ">") {
+        value.i = lhs.i > rhs.i;
+    }
+    else if (op == ">=") {
+        value.i = lhs.i >= rhs.i;
+    }
+    else if (op == "==") {
+        value.i = lhs.i == rhs.i;
+    }
+    else if (op == "!=") {
+        value.i = lhs.i != rhs.i;
+    }
+    else {
+        error(std::format("unknown operator {}", op));
+    }
+    return value;
+}
+
+bc::Value TreeWalker::evalCast(bc::Value value, ts::Type from, ts::Type to)
+{
+    bc::Value result = value;
+
+    if (from == to) {
+        return result;
+    }
+
+    if (to == ts::Type::float_t) {
+        result.f = static_cast<float>(value.i);
+    }
+    else if (from == ts::Type::float_t && to == ts::Type::bool_t) {
+        result.i = value.f != 0.0f; // NaN is true
+    }
+    else if (from == ts::Type::float_t) {
+        result.i = bc::truncate(value.f);
+        if (to == ts::Type::char_t) {
+            result.i = static_cast<std::int8_t>(result.i);
+        }
+    }
+    else if (to == ts::Type::bool_t) {
+        result.i = value.i != 0;
+    }
+    else if (to == ts::Type::char_t) {
+        result.i = static_cast<std::int8_t>(value.i);
+    }
+    // bool and char values are already extended to int
+    return result;
+}
+
+void TreeWalker::store(const ast::ASTNodePtr& target, bc::Value value)
+{
+    std::uint8_t* p;
+
+    if (const ast::Identifier* id = std::get_if<ast::Identifier>(&target->getData())) {
+        p = variable(*id->getSymbol());
+    }
+    else {
+        p = element(target);
+    }
+
+    switch (ast::getType(target)) {
+        case ts::Type::int_t:
+            std::memcpy(p, &value.i, 4);
+            break;
+        case ts::Type::float_t:
+            std::memcpy(p, &value.f, 4);
+            break;
+        case ts::Type::bool_t:
+            [[fallthrough]];
+        case ts::Type::char_t:
+            *p = static_cast<std::uint8_t>(value.i);
+            break;
+        default:
+            error("cannot evaluate unknown type");
+    }
+}
+
+std::uint8_t* TreeWalker::variable(const Symbol& sym)
+{
+    std::vector<std::uint8_t>& storage = m_storage[&sym];
+
+    if (storage.empty()) {
+        storage.resize(std::max<std::size_t>(sym.size, 1));
+    }
+    return storage.data();
+}
+
+std::uint8_t* TreeWalker::element(const ast::ASTNodePtr& node)
+{
+    ast::ElementLocation loc = ast::elementLocation(node);
+    const Symbol&        sym = *loc.variable->getSymbol();
+
+    std::int64_t offset = loc.disp;
+
+    if (loc.subscript) {
+        std::int32_t index = evalExpr((*loc.subscript)->getChildren().back()).i;
+
+        // unchecked accesses are proven to be in range
+        if (static_cast<std::uint32_t>(index) >= sym.length) {
+            if (std::get<ast::BinaryExpr>((*loc.subscript)->getData()).isBoundsChecked()) {
+                throw FaultExit();
+            }
+            error("index out of range in unchecked access");
+        }
+        offset += index * loc.stride;
+    }
+
+    return variable(sym) + offset;
+}
+
+void TreeWalker::error(std::string_view msg)
+{
+    throw InterpretError(msg);
+}
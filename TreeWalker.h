@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AST.h"
+#include "Bytecode.h"
+#include "SymbolTable.h"
+
+// evaluates AST directly, node by node
+// baseline for the VM, every variable access is a hash table lookup
+class TreeWalker
+{
+public:
+    TreeWalker(SymbolTable& st) : m_symbolTable(st) {}
+    ~TreeWalker() {}
+
+    TreeWalker(const TreeWalker&)            = delete;
+    TreeWalker(TreeWalker&&)                 = delete;
+    TreeWalker& operator=(const TreeWalker&) = delete;
+    TreeWalker& operator=(TreeWalker&&)      = delete;
+
+    // returns exit code of the program
+    int run(const ast::ASTNodePtr& ast);
+
+    // address of global variable after run
+    const void* address(const std::string& name);
+
+private:
+    void execNode(const ast::ASTNodePtr& node);
+    bool execCondition(const ast::ASTNodePtr& cond);
+
+    bc::Value evalExpr(const ast::ASTNodePtr& node);
+    bc::Value evalBinary(const ast::ASTNodePtr& node);
+    bc::Value evalCast(bc::Value value, ts::Type from, ts::Type to);
+
+    void store(const ast::ASTNodePtr& target, bc::Value value);
+
+    // storage of variable, zeroed on first use
+    std::uint8_t* variable(const Symbol& sym);
+    // address of array element or struct member, index is checked if needed
+    std::uint8_t* element(const ast::ASTNodePtr& node);
+
+    [[noreturn]] void error(std::string_view msg);
+
+private:
+    SymbolTable& m_symbolTable;
+
+    std::unordered_map<const Symbol*, std::vector<std::uint8_t>> m_storage;
+};
@@ -0,0 +1,262 @@
+#include <cstring>
+#include <format>
+#include <iterator>
+
+#include "Profiler.h"
+#include "VM.h"
+
+// VM_SWITCH forces the switch loop
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define VM_THREADED
+#endif
+
+int VM::run(const bc::Program& program)
+{
+    TimeScope scope("vm run");
+
+    m_program   = &program;
+    m_registers = program.registers;
+    m_memory    = program.memory;
+
+    int code = execute(program.code.data());
+
+    // scalar globals are copied to their memory
+    for (const bc::Writeback& w : program.writeback) {
+        std::memcpy(m_memory.data() + w.address, &m_registers[w.reg], ts::TypeSize[w.type]);
+    }
+
+    return code;
+}
+
+const void* VM::address(const std::string& name) const
+{
+    if (!m_program || !m_program->globals.contains(name)) {
+        throw InterpretError(std::format("undefined symbol {}", name));
+    }
+    return m_memory.data() + m_program->globals.at(name);
+}
+
+// labels as values are a GNU extension
+#ifdef VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+int VM::execute(const bc::Instruction* code)
+{
+    bc::Value*             r      = m_registers.data();
+    std::uint8_t*          mem    = m_memory.data();
+    const bc::Instruction* ip     = code;
+    int                    status = 0;
+
+#define RA r[ip->a]
+#define RB r[ip->b]
+#define RC r[ip->c]
+#define ELEMENT(size) (mem + ip->c + static_cast<std::ptrdiff_t>(RB.i) * (size))
+
+#ifdef VM_THREADED
+    // indexed by Opcode
+    static const void* const labels[] = {
+        &&L_MOV,       &&L_ADD_I,      &&L_SUB_I,      &&L_MUL_I,      &&L_DIV_I,       &&L_ADD_F,      &&L_SUB_F,
+        &&L_MUL_F,     &&L_DIV_F,      &&L_NEG_I,      &&L_NEG_F,      &&L_LT_I,        &&L_LE_I,       &&L_EQ_I,
+        &&L_NE_I,      &&L_LT_F,       &&L_LE_F,       &&L_EQ_F,       &&L_NE_F,        &&L_I2F,        &&L_F2I,
+        &&L_F2B,       &&L_F2C,        &&L_I2B,        &&L_I2C,        &&L_LOAD_INT,    &&L_LOAD_FLOAT, &&L_LOAD_BOOL,
+        &&L_LOAD_CHAR, &&L_STORE_INT,  &&L_STORE_FLOAT, &&L_STORE_BOOL, &&L_STORE_CHAR, &&L_CHECK,      &&L_JMP,
+        &&L_JZ,        &&L_JNZ,        &&L_JLT_I,      &&L_JLE_I,      &&L_JEQ_I,       &&L_JNE_I,      &&L_JLT_F,
+        &&L_JLE_F,     &&L_JEQ_F,      &&L_JNE_F,      &&L_JNLT_F,     &&L_JNLE_F,      &&L_HALT,
+    };
+    static_assert(std::size(labels) == static_cast<std::size_t>(bc::Opcode::HALT) + 1);
+
+#define VM_CASE(name) L_##name:
+#define VM_DISPATCH() goto* labels[static_cast<std::size_t>(ip->op)]
+
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case bc::Opcode::name:
+#define VM_DISPATCH() continue
+
+    for (;;) {
+        switch (ip->op) {
+#endif
+
+#define VM_NEXT()  \
+    ip++;          \
+    VM_DISPATCH()
+#define VM_JUMP()       \
+    ip = code + ip->c; \
+    VM_DISPATCH()
+#define VM_BRANCH(cond) \
+    if (cond) {         \
+        VM_JUMP();      \
+    }                   \
+    VM_NEXT()
+
+    VM_CASE(MOV)
+    RA = RB;
+    VM_NEXT();
+
+    VM_CASE(ADD_I)
+    RA.i = bc::wrap(static_cast<std::int64_t>(RB.i) + RC.i);
+    VM_NEXT();
+    VM_CASE(SUB_I)
+    RA.i = bc::wrap(static_cast<std::int64_t>(RB.i) - RC.i);
+    VM_NEXT();
+    VM_CASE(MUL_I)
+    RA.i = bc::wrap(static_cast<std::int64_t>(RB.i) * RC.i);
+    VM_NEXT();
+    VM_CASE(DIV_I)
+    if (RC.i == 0) {
+        status = 1;
+        goto halt;
+    }
+    RA.i = RC.i == -1 ? bc::wrap(-static_cast<std::int64_t>(RB.i)) : RB.i / RC.i;
+    VM_NEXT();
+    VM_CASE(ADD_F)
+    RA.f = RB.f + RC.f;
+    VM_NEXT();
+    VM_CASE(SUB_F)
+    RA.f = RB.f - RC.f;
+    VM_NEXT();
+    VM_CASE(MUL_F)
+    RA.f = RB.f * RC.f;
+    VM_NEXT();
+    VM_CASE(DIV_F)
+    RA.f = RB.f / RC.f;
+    VM_NEXT();
+    VM_CASE(NEG_I)
+    RA.i = bc::wrap(-static_cast<std::int64_t>(RB.i));
+    VM_NEXT();
+    VM_CASE(NEG_F)
+    RA.f = -RB.f;
+    VM_NEXT();
+
+    VM_CASE(LT_I)
+    RA.i = RB.i < RC.i;
+    VM_NEXT();
+    VM_CASE(LE_I)
+    RA.i = RB.i <= RC.i;
+    VM_NEXT();
+    VM_CASE(EQ_I)
+    RA.i = RB.i == RC.i;
+    VM_NEXT();
+    VM_CASE(NE_I)
+    RA.i = RB.i != RC.i;
+    VM_NEXT();
+    VM_CASE(LT_F)
+    RA.i = RB.f < RC.f;
+    VM_NEXT();
+    VM_CASE(LE_F)
+    RA.i = RB.f <= RC.f;
+    VM_NEXT();
+    VM_CASE(EQ_F)
+    RA.i = RB.f == RC.f;
+    VM_NEXT();
+    VM_CASE(NE_F)
+    RA.i = RB.f != RC.f;
+    VM_NEXT();
+
+    VM_CASE(I2F)
+    RA.f = static_cast<float>(RB.i);
+    VM_NEXT();
+    VM_CASE(F2I)
+    RA.i = bc::truncate(RB.f);
+    VM_NEXT();
+    VM_CASE(F2B)
+    RA.i = RB.f != 0.0f; // NaN is true
+    VM_NEXT();
+    VM_CASE(F2C)
+    RA.i = static_cast<std::int8_t>(bc::truncate(RB.f));
+    VM_NEXT();
+    VM_CASE(I2B)
+    RA.i = RB.i != 0;
+    VM_NEXT();
+    VM_CASE(I2C)
+    RA.i = static_cast<std::int8_t>(RB.i);
+    VM_NEXT();
+
+    VM_CASE(LOAD_INT)
+    std::memcpy(&RA.i, ELEMENT(4), 4);
+    VM_NEXT();
+    VM_CASE(LOAD_FLOAT)
+    std::memcpy(&RA.f, ELEMENT(4), 4);
+    VM_NEXT();
+    VM_CASE(LOAD_BOOL)
+    RA.i = *ELEMENT(1);
+    VM_NEXT();
+    VM_CASE(LOAD_CHAR)
+    RA.i = static_cast<std::int8_t>(*ELEMENT(1));
+    VM_NEXT();
+    VM_CASE(STORE_INT)
+    std::memcpy(ELEMENT(4), &RA.i, 4);
+    VM_NEXT();
+    VM_CASE(STORE_FLOAT)
+    std::memcpy(ELEMENT(4), &RA.f, 4);
+    VM_NEXT();
+    VM_CASE(STORE_BOOL)
+    *ELEMENT(1) = static_cast<std::uint8_t>(RA.i);
+    VM_NEXT();
+    VM_CASE(STORE_CHAR)
+    *ELEMENT(1) = static_cast<std::uint8_t>(RA.i);
+    VM_NEXT();
+
+    VM_CASE(CHECK)
+    // negative index is a huge unsigned value
+    if (static_cast<std::uint32_t>(RA.i) >= static_cast<std::uint32_t>(ip->c)) {
+        status = 1;
+        goto halt;
+    }
+    VM_NEXT();
+
+    VM_CASE(JMP)
+    VM_JUMP();
+    VM_CASE(JZ)
+    VM_BRANCH(RA.i == 0);
+    VM_CASE(JNZ)
+    VM_BRANCH(RA.i != 0);
+    VM_CASE(JLT_I)
+    VM_BRANCH(RA.i < RB.i);
+    VM_CASE(JLE_I)
+    VM_BRANCH(RA.i <= RB.i);
+    VM_CASE(JEQ_I)
+    VM_BRANCH(RA.i == RB.i);
+    VM_CASE(JNE_I)
+    VM_BRANCH(RA.i != RB.i);
+    VM_CASE(JLT_F)
+    VM_BRANCH(RA.f < RB.f);
+    VM_CASE(JLE_F)
+    VM_BRANCH(RA.f <= RB.f);
+    VM_CASE(JEQ_F)
+    VM_BRANCH(RA.f == RB.f);
+    VM_CASE(JNE_F)
+    VM_BRANCH(RA.f != RB.f);
+    VM_CASE(JNLT_F)
+    VM_BRANCH(!(RA.f < RB.f));
+    VM_CASE(JNLE_F)
+    VM_BRANCH(!(RA.f <= RB.f));
+
+    VM_CASE(HALT)
+    status = ip->c;
+    goto halt;
+
+#ifndef VM_THREADED
+        }
+    }
+#endif
+
+#undef VM_BRANCH
+#undef VM_JUMP
+#undef VM_NEXT
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef ELEMENT
+#undef RC
+#undef RB
+#undef RA
+
+halt:
+    return status;
+}
+
+#ifdef VM_THREADED
+#pragma GCC diagnostic pop
+#endif
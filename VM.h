@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bytecode.h"
+
+// executes bytecode
+// dispatch is threaded through computed goto with GCC and Clang, a switch loop otherwise
+class VM
+{
+public:
+    VM() {}
+    ~VM() {}
+
+    VM(const VM&)            = delete;
+    VM(VM&&)                 = delete;
+    VM& operator=(const VM&) = delete;
+    VM& operator=(VM&&)      = delete;
+
+    // returns exit code of the program
+    int run(const bc::Program& program);
+
+    // address of global variable after run
+    const void* address(const std::string& name) const;
+
+private:
+    int execute(const bc::Instruction* code);
+
+private:
+    const bc::Program*        m_program = nullptr;
+    std::vector<bc::Value>    m_registers;
+    std::vector<std::uint8_t> m_memory;
+};
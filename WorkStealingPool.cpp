@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <thread>
+
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) : m_threads(threads)
+{
+    if (m_threads == 0) {
+        m_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (std::size_t i = 0; i < m_threads; i++) {
+        m_blocks.push_back(std::make_unique<Block>());
+    }
+}
+
+void WorkStealingPool::run(std::size_t count, const std::function<void(std::size_t, std::size_t)>& fn)
+{
+    // no thread has started yet, blocks aren't locked
+    for (std::size_t i = 0; i < m_threads; i++) {
+        m_blocks[i]->begin = count * i / m_threads;
+        m_blocks[i]->end   = count * (i + 1) / m_threads;
+    }
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < std::min(m_threads, count); i++) {
+        workers.emplace_back(&WorkStealingPool::work, this, i, std::cref(fn));
+    }
+    work(0, fn);
+
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::work(std::size_t worker, const std::function<void(std::size_t, std::size_t)>& fn)
+{
+    std::size_t task;
+
+    // a block is only taken by one thief at a time, so nothing is left when all steals fail
+    while (pop(worker, task) || steal(worker, task)) {
+        fn(task, worker);
+    }
+}
+
+bool WorkStealingPool::pop(std::size_t worker, std::size_t& task)
+{
+    Block&                      block = *m_blocks[worker];
+    std::lock_guard<std::mutex> lock(block.mutex);
+
+    if (block.begin == block.end) {
+        return false;
+    }
+    task = block.begin++;
+
+    return true;
+}
+
+bool WorkStealingPool::steal(std::size_t worker, std::size_t& task)
+{
+    for (std::size_t i = 1; i < m_threads; i++) {
+        Block& victim = *m_blocks[(worker + i) % m_threads];
+
+        std::size_t begin;
+        std::size_t end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if (victim.begin == victim.end) {
+                continue;
+            }
+
+            // owner keeps the lower half, the tasks it would take next
+            begin      = victim.begin + (victim.end - victim.begin) / 2;
+            end        = victim.end;
+            victim.end = begin;
+        }
+
+        Block&                      own = *m_blocks[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        task      = begin;
+        own.begin = begin + 1;
+        own.end   = end;
+
+        return true;
+    }
+    return false;
+}
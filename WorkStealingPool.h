@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// runs numbered tasks on worker threads
+// every worker starts with a contiguous block of tasks and takes them in order, a worker without tasks
+// steals the upper half of the remaining block of another worker
+class WorkStealingPool
+{
+public:
+    // threads == 0 uses one per CPU
+    explicit WorkStealingPool(std::size_t threads = 0);
+    ~WorkStealingPool() {}
+
+    WorkStealingPool(const WorkStealingPool&)            = delete;
+    WorkStealingPool(WorkStealingPool&&)                 = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(WorkStealingPool&&)      = delete;
+
+    std::size_t threads() const { return m_threads; }
+
+    // calls fn(task, worker) for every task in [0, count) and returns when all are done
+    // the calling thread is worker 0, fn must not throw
+    void run(std::size_t count, const std::function<void(std::size_t, std::size_t)>& fn);
+
+private:
+    // tasks [begin, end) not taken yet
+    struct alignas(64) Block
+    {
+        std::mutex  mutex;
+        std::size_t begin = 0;
+        std::size_t end   = 0;
+    };
+
+    void work(std::size_t worker, const std::function<void(std::size_t, std::size_t)>& fn);
+
+    // next task of worker's own block
+    bool pop(std::size_t worker, std::size_t& task);
+
+    // moves upper half of another block to worker's block, task is the first of them
+    bool steal(std::size_t worker, std::size_t& task);
+
+private:
+    std::size_t                         m_threads;
+    std::vector<std::unique_ptr<Block>> m_blocks; // one per worker
+};
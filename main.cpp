@@ -1,59 +1,544 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <format>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
 
+#include "AllocationTracker.h"
+#include "BatchCompiler.h"
+#include "Benchmark.h"
+#include "BytecodeCompiler.h"
+#include "CompileCache.h"
+#include "CompileServer.h"
+#include "DataLayout.h"
+#include "ElfWriter.h"
+#include "FrameAllocator.h"
 #include "Interpreter.h"
+#include "Jit.h"
 #include "Lexer.h"
+#include "LoopAnalyzer.h"
 #include "Parser.h"
+#include "Profile.h"
+#include "Profiler.h"
+#include "SelfTest.h"
 #include "SemanticAnalyzer.h"
+#include "SourceManager.h"
+#include "StreamCompiler.h"
+#include "TreeWalker.h"
+#include "VM.h"
 
 // prints a line of code with a caret indicating the error location
-void printCodeLine(const Location& loc, const std::string& buf)
+void printCodeLine(const Location& loc, const SourceManager& sources)
 {
-    std::stringstream ss(buf);
-    std::string       tmp;
+    SourceManager::Position pos = sources.decode(loc);
 
-    std::size_t i = 0;
+    std::cout << pos.lineText << '\n';
 
-    while (i != loc.line && std::getline(ss, tmp)) {
-        i++;
+    for (std::size_t i = 1; i < pos.column; i++) {
+        std::cout << ' ';
     }
+    std::cout << "^\n";
+}
 
-    std::cout << tmp << '\n';
+// prints struct layouts, memory used by struct arrays, global sections and stack frame size
+void printLayoutReport(SymbolTable& st)
+{
+    for (const auto& [sectionName, section] : {std::pair{".data", &st.getData()}, std::pair{".bss", &st.getBss()}}) {
+        std::cerr << "section " << sectionName << ": " << section->size << " bytes, " << section->padding << " padding\n";
 
-    for (std::size_t i = 1; i < loc.col; i++) {
-        std::cout << ' ';
+        for (const auto& [name, sym] : section->symbols) {
+            std::string type   = sym->structType ? "struct " + sym->structType->name : ts::TypeNames[sym->type];
+            std::string length = SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_ARRAY) ? std::format("[{}]", sym->length) : "";
+
+            std::cerr << "    " << type << ' ' << name << length << " +" << sym->offset << '\n';
+        }
+    }
+
+
+    std::size_t scoped = 0;
+    for (const auto& [id, scope] : st) {
+        scoped = std::max(scoped, scope->getOffset());
+    }
+    std::cerr << "frame: " << st.getFrameSize() << " bytes (scoped layout " << scoped << ")\n";
+
+    for (const auto& [name, type] : st.getStructs()) {
+        std::cerr << "struct " << name << (type->soa ? " [[soa]]" : "") << ": " << type->size << " bytes (declared order "
+                  << type->declaredSize << "), align " << type->align << '\n';
+
+        for (const auto& [fieldName, field] : type->fields) {
+            std::cerr << "    " << ts::TypeNames[field->type] << ' ' << fieldName << " +" << field->offset << '\n';
+        }
+    }
+
+    for (const auto& [id, scope] : st) {
+        for (const auto& [name, sym] : *scope) {
+            if (sym->type != ts::Type::struct_t || !SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_ARRAY)) {
+                continue;
+            }
+
+            const StructType& type = *sym->structType;
+
+            std::cerr << name << '[' << sym->length << "]: " << sym->size << " bytes (declared order AoS "
+                      << type.declaredSize * sym->length << ", AoS " << type.size * sym->length;
+            // field arrays of vectorized loops are aligned for vector access
+            if (SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_VECTOR)) {
+                std::cerr << ", " << sym->size - type.arraySize(sym->length) << " bytes vector alignment";
+            }
+            std::cerr << ")\n";
+        }
+    }
+}
+
+// prints value of type at p
+void printValue(ts::Type type, const std::uint8_t* p)
+{
+    std::uint32_t raw = 0;
+    std::memcpy(&raw, p, ts::TypeSize[type]);
+
+    switch (type) {
+    case ts::Type::int_t:
+        std::cout << static_cast<std::int32_t>(raw);
+        break;
+    case ts::Type::float_t:
+        std::cout << std::bit_cast<float>(raw);
+        break;
+    case ts::Type::bool_t:
+        std::cout << (raw ? "true" : "false");
+        break;
+    case ts::Type::char_t:
+        // char is signed
+        if (std::isprint(static_cast<int>(raw))) {
+            std::cout << '\'' << static_cast<char>(raw) << '\'';
+        }
+        else {
+            std::cout << static_cast<int>(static_cast<std::int8_t>(raw));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// prints final values of globals after run, one per line in name order
+template <typename Runner>
+void printGlobals(SymbolTable& st, Runner& runner)
+{
+    std::vector<std::pair<std::string, std::shared_ptr<Symbol>>> globals(st[0]->begin(), st[0]->end());
+    std::ranges::sort(globals, {}, [](const auto& e) { return e.first; });
+
+    for (const auto& [name, sym] : globals) {
+        const std::uint8_t* base   = static_cast<const std::uint8_t*>(runner.address(name));
+        bool                array  = SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_ARRAY);
+        bool                vector = SYMBOL_GET_FLAG((*sym), SYMBOL_FLAG_VECTOR);
+        std::uint32_t       length = array ? sym->length : 1;
+
+        for (std::uint32_t i = 0; i < length; i++) {
+            std::string element = array ? std::format("{}[{}]", name, i) : name;
+
+            if (sym->type != ts::Type::struct_t) {
+                std::cout << element << " = ";
+                printValue(sym->type, base + i * ts::TypeSize[sym->type]);
+                std::cout << '\n';
+                continue;
+            }
+
+            const StructType& type = *sym->structType;
+
+            for (const auto& [fieldName, field] : type.fields) {
+                std::size_t offset = array && type.soa
+                                         ? type.soaOffset(*field, length, vector) + i * ts::TypeSize[field->type]
+                                         : i * type.size + field->offset;
+
+                std::cout << element << '.' << fieldName << " = ";
+                printValue(field->type, base + offset);
+                std::cout << '\n';
+            }
+        }
     }
-    std::cout << "^\n";
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc < 2) {
-        std::cerr << "usage: " << argv[0] << " <filename>\n";
+    SimdLevel   simd         = SimdLevel::SSE;
+    std::size_t unroll       = Interpreter::DEFAULT_UNROLL; // copies of small counted loop bodies, 1 to disable
+    bool        layoutReport = false;
+    bool        emitAssembly = false; // NASM text to stdout instead of object file
+    bool        jit          = false; // run in process and print globals instead of object file
+    bool        vm           = false; // run as bytecode, -S prints bytecode
+    bool        walk         = false; // run by walking AST
+    bool        bench        = false; // time phases on generated programs, JSON to output or stdout
+    bool        selfTest     = false; // check layout and code properties, failures to stderr
+    bool        timeReport   = false; // wall and CPU time of phases to stderr
+    bool        allocReport  = false; // time report with allocations of phases
+    bool        perfCounters = false; // time report with hardware counters of phases
+    bool        batch        = false; // compile all inputs on worker threads
+    bool        stream       = false; // -S one statement at a time in bounded memory
+    bool        lineInfo     = false; // source lines of instructions as %line or DWARF
+    std::string instrument;           // profile the compiled program writes when it exits
+    const char* profilePath  = nullptr; // profile of an instrumented run to lay out code by
+    std::string tracePath;            // Chrome trace of phases
+    const char* manifest     = nullptr; // batch inputs, one per line
+    const char* serverPath   = nullptr; // socket to serve compilations on
+    const char* clientPath   = nullptr; // socket of server to compile with
+    std::size_t jobs         = 0;       // worker threads of server and batch, one per CPU if 0
+    const char* cacheDir     = nullptr; // outputs of earlier compilations
+    std::size_t cacheSize    = CompileCache::DEFAULT_CAPACITY;
+    bool        cacheStats   = false;   // hits and misses of the cache to stderr
+    std::string benchCases   = std::string(Benchmark::DEFAULT_CASES);
+    std::size_t benchRuns    = 5;
+    std::size_t seed         = 1;
+    const char* output       = nullptr; // a.o for object file, output directory of batch
+    const char* filename     = nullptr; // last input
+
+    std::vector<const char*> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg(argv[i]);
+
+        if (arg == "-S") {
+            emitAssembly = true;
+        }
+        else if (arg == "-g") {
+            lineInfo = true;
+        }
+        else if (arg == "--jit") {
+            jit = true;
+        }
+        else if (arg == "--vm") {
+            vm = true;
+        }
+        else if (arg == "--walk") {
+            walk = true;
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (arg == "--no-vectorize") {
+            simd = SimdLevel::NONE;
+        }
+        else if (arg == "--avx2") {
+            simd = SimdLevel::AVX2;
+        }
+        else if (arg == "--unroll" && i + 1 < argc) {
+            unroll = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--layout-report") {
+            layoutReport = true;
+        }
+        else if (arg == "--time-report") {
+            timeReport = true;
+        }
+        else if (arg == "--alloc-report") {
+            allocReport = true;
+        }
+        else if (arg == "--perf-counters") {
+            perfCounters = true;
+        }
+        else if (arg.starts_with("--trace=")) {
+            tracePath = arg.substr(std::strlen("--trace="));
+        }
+        else if (arg == "--instrument") {
+            instrument = "a.prof";
+        }
+        else if (arg.starts_with("--instrument=")) {
+            instrument = arg.substr(std::strlen("--instrument="));
+        }
+        else if (arg.starts_with("--profile-use=")) {
+            profilePath = argv[i] + std::strlen("--profile-use=");
+        }
+        else if (arg == "--stream") {
+            stream = true;
+        }
+        else if (arg == "--batch") {
+            batch = true;
+        }
+        else if (arg == "--manifest" && i + 1 < argc) {
+            manifest = argv[++i];
+        }
+        else if (arg == "--server" && i + 1 < argc) {
+            serverPath = argv[++i];
+        }
+        else if (arg == "--client" && i + 1 < argc) {
+            clientPath = argv[++i];
+        }
+        else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--cache-dir" && i + 1 < argc) {
+            cacheDir = argv[++i];
+        }
+        else if (arg == "--cache-size" && i + 1 < argc) {
+            cacheSize = std::strtoull(argv[++i], nullptr, 10) << 20;
+        }
+        else if (arg == "--cache-stats") {
+            cacheStats = true;
+        }
+        else if (arg == "--bench") {
+            bench = true;
+        }
+        else if (arg == "--self-test") {
+            selfTest = true;
+        }
+        else if (arg == "--bench-cases" && i + 1 < argc) {
+            benchCases = argv[++i];
+        }
+        else if (arg == "--bench-runs" && i + 1 < argc) {
+            benchRuns = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else {
+            filename = argv[i];
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (batch) {
+        try {
+            BatchCompiler compiler({simd, emitAssembly ? OutputKind::ASSEMBLY : OutputKind::OBJECT, unroll}, jobs);
+
+            for (const char* input : inputs) {
+                compiler.addInput(input);
+            }
+            if (manifest) {
+                compiler.addManifest(manifest);
+            }
+
+            if (bench) {
+                compiler.benchmark(benchRuns, std::cout);
+                return 0;
+            }
+
+            // output is a directory here
+            return compiler.run(output, std::cerr) ? 1 : 0;
+        } catch (const InterpretError& e) {
+            std::cerr << "Batch error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    if (serverPath) {
+        try {
+            CompileServer server(serverPath, jobs);
+            server.run();
+        } catch (const InterpretError& e) {
+            std::cerr << "Server error: " << e.what() << '\n';
+        }
         return 1;
     }
 
-    std::ifstream ifile(argv[1]);
+    if (clientPath && filename) {
+        try {
+            if (bench) {
+                CompileServer::benchmark(clientPath, filename, simd, benchRuns, std::cout);
+                return 0;
+            }
+
+            std::ifstream ifile(filename);
+
+            if (!ifile.is_open()) {
+                std::cerr << "can't open " << filename << '\n';
+                return 1;
+            }
+
+            std::stringstream ss;
+            ss << ifile.rdbuf();
+
+            std::string reply;
+            bool        ok = CompileServer::request(clientPath, ss.str(), simd, reply);
+
+            (ok ? std::cout : std::cerr) << reply;
+            return ok ? 0 : 1;
+        } catch (const InterpretError& e) {
+            std::cerr << "Client error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    if (bench) {
+        try {
+            Benchmark benchmark(seed, benchRuns, perfCounters);
+            benchmark.addCases(benchCases);
+
+            if (!output) {
+                benchmark.run(std::cout);
+                return 0;
+            }
+
+            std::ofstream ofile(output);
+
+            if (!ofile.is_open()) {
+                std::cerr << "can't open " << output << '\n';
+                return 1;
+            }
+            benchmark.run(ofile);
+        } catch (const InterpretError& e) {
+            std::cerr << "Benchmark error: " << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (selfTest) {
+        return SelfTest(std::cerr).run() ? 0 : 1;
+    }
+
+    if (cacheDir && cacheStats && !filename) {
+        try {
+            CompileCache(cacheDir, cacheSize).printStats(std::cerr);
+        } catch (const InterpretError& e) {
+            std::cerr << "Cache error: " << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!filename) {
+        std::cerr << "usage: " << argv[0] << " [-S [--stream] | -o <output> | --jit | --vm [-S] | --walk] [-g] [--no-vectorize | --avx2] [--unroll <n>]\n"
+                  << "           [--instrument[=<file>] | --profile-use=<file>] [--layout-report] [--time-report | --alloc-report] [--perf-counters] [--trace=<file>]\n"
+                  << "           [--cache-dir <dir> [--cache-size <MiB>] [--cache-stats]] <filename>\n";
+        std::cerr << "       " << argv[0] << " --bench [--bench-cases <shape:size,...>] [--bench-runs <n>] [--seed <n>] [--perf-counters] [-o <json>]\n";
+        std::cerr << "       " << argv[0] << " --self-test\n";
+        std::cerr << "       " << argv[0] << " --batch [-S] [-o <dir>] [--jobs <n>] [--manifest <file>] [--bench [--bench-runs <n>]] <filename>...\n";
+        std::cerr << "       " << argv[0] << " --cache-dir <dir> --cache-stats\n";
+        std::cerr << "       " << argv[0] << " --server <socket> [--jobs <n>]\n";
+        std::cerr << "       " << argv[0] << " --client <socket> [--bench [--bench-runs <n>]] [--no-vectorize | --avx2] <filename>\n";
+        return 1;
+    }
+
+    if (stream && (!emitAssembly || jit || vm || walk || layoutReport || cacheDir)) {
+        std::cerr << "--stream only works with -S\n";
+        return 1;
+    }
+
+    if (lineInfo && (stream || jit || vm || walk)) {
+        std::cerr << "-g only works with -S and object files\n";
+        return 1;
+    }
+
+    if ((!instrument.empty() || profilePath) && (stream || vm || walk)) {
+        std::cerr << "--instrument and --profile-use only work with native code\n";
+        return 1;
+    }
+
+    std::ifstream ifile(filename);
 
     if (!ifile.is_open()) {
-        std::cerr << "can't open " << argv[1] << '\n';
+        std::cerr << "can't open " << filename << '\n';
         return 1;
     }
 
-    std::stringstream ss;
-    ss << ifile.rdbuf();
+    SourceManager    sources;
+    std::string_view buf;
+
+    // streamed source is read again only for the line of an error
+    auto load = [&]
+    {
+        ifile.clear();
+        ifile.seekg(0);
+
+        std::stringstream ss;
+        ss << ifile.rdbuf();
+
+        buf = sources.add(filename, std::move(ss).str()).text;
+    };
+
+    try {
+        if (!stream) {
+            load();
+        }
+    } catch (const InterpretError& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    auto printErrorLine = [&](const Location& loc)
+    {
+        if (stream) {
+            try {
+                load();
+            } catch (const InterpretError&) {
+                return;
+            }
+        }
+        printCodeLine(loc, sources);
+    };
+
+    if (!emitAssembly && !output) {
+        output = "a.o";
+    }
+
+    // the source hash ties a profile to the source it was collected for
+    Profile profile;
+    if (profilePath) {
+        try {
+            profile.load(profilePath, Profile::hash(buf));
+        } catch (const InterpretError& e) {
+            std::cerr << "Profile error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // only emitted files are cached, a hit skips every phase
+    // the key doesn't cover profiles, so profiled compilations aren't cached
+    std::optional<CompileCache> cache;
+    std::string                 cacheKey;
 
-    std::string buf(ss.str());
+    if (cacheDir && !jit && !vm && !walk && !layoutReport && instrument.empty() && !profilePath) {
+        try {
+            cache.emplace(cacheDir, cacheSize);
+            cacheKey = CompileCache::key(
+                buf,
+                std::format("{} simd={} unroll={} g={}",
+                            emitAssembly ? "-S" : "-c",
+                            static_cast<int>(simd),
+                            unroll,
+                            lineInfo ? filename : ""));
+
+            if (cache->load(cacheKey, emitAssembly ? nullptr : output)) {
+                if (cacheStats) {
+                    cache->printStats(std::cerr);
+                }
+                return 0;
+            }
+        } catch (const InterpretError& e) {
+            std::cerr << "Cache error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // reports are written when main returns
+    std::optional<Profiler> profiler;
+    if (timeReport || allocReport || perfCounters || !tracePath.empty()) {
+        AllocationTracker::enable(allocReport);
+        profiler.emplace(timeReport || allocReport || perfCounters, perfCounters, tracePath);
+    }
 
     try {
+        if (stream) {
+            AsmWriter      out(STDOUT_FILENO);
+            StreamCompiler compiler(simd, unroll);
+
+            compiler.compile(ifile, out);
+            out.flush();
+
+            return 0;
+        }
+
         Lexer            lexer;
         std::list<Token> tokens = lexer.tokenize(buf);
 
 #ifdef DEBUG
         std::cout << "Tokens:\n";
         for (const Token& t : tokens) {
-            std::cout << TokNames[t.getKind()] << '{' << t.getLoc().line << ' ' << t.getLoc().col << '}' << ' ';
+            std::cout << TokNames[t.getKind()] << '{' << t.getLoc().offset << '}' << ' ';
         }
         std::cout << '\n';
 #endif
@@ -64,23 +549,126 @@ int main(int argc, char* argv[])
         SemanticAnalyzer sa;
         sa.analyze(tree);
 
+        LoopAnalyzer la;
+        {
+            TimeScope scope("loop analysis");
+            la.analyze(tree);
+        }
+
+        FrameAllocator fa(sa.getSymbolTable());
+        fa.allocate(tree);
+
+        DataLayout dl(sa.getSymbolTable());
+        dl.layout(tree);
+
+        if (layoutReport) {
+            printLayoutReport(sa.getSymbolTable());
+        }
+
 #ifdef DEBUG
         std::cout << "\nAST:\n";
         PrintAST(tree);
         std::cout << "\nInterpreter:\n\n";
 #endif
-        Interpreter interpreter(std::move(sa.getSymbolTable()));
-        interpreter.interpret(tree);
+        if (walk) {
+            TreeWalker walker(sa.getSymbolTable());
+
+            int code = walker.run(tree);
+            printGlobals(sa.getSymbolTable(), walker);
+
+            return code;
+        }
+
+        if (vm) {
+            BytecodeCompiler   compiler(sa.getSymbolTable());
+            const bc::Program& bytecode = compiler.compile(tree);
+
+            if (emitAssembly) {
+                bc::printBytecode(bytecode, std::cout);
+                return 0;
+            }
+
+            VM  machine;
+            int code = machine.run(bytecode);
+            printGlobals(sa.getSymbolTable(), machine);
+
+            return code;
+        }
+
+        Interpreter interpreter(std::move(sa.getSymbolTable()), simd, jit, unroll);
+
+        if (!instrument.empty()) {
+            interpreter.instrument(instrument, Profile::hash(buf));
+        }
+        if (profilePath) {
+            interpreter.useProfile(&profile);
+        }
+        if (lineInfo) {
+            interpreter.emitLineInfo(&sources);
+        }
+
+        const x86::Program& program = interpreter.interpret(tree);
+
+        if (jit) {
+            Jit runner;
+            runner.load(program);
+
+            int code = runner.run();
+            printGlobals(interpreter.getSymbolTable(), runner);
+
+            return code;
+        }
+        else if (emitAssembly) {
+            // kept in memory for the cache
+            AsmWriter out(cache ? -1 : STDOUT_FILENO);
+            x86::printNASM(program, out);
+
+            if (cache) {
+                cache->store(cacheKey, out.view());
+
+                AsmWriter stdoutWriter(STDOUT_FILENO, 0);
+                stdoutWriter.write(out.view());
+                stdoutWriter.flush();
+            }
+            out.flush();
+        }
+        else {
+            std::ofstream ofile(output, std::ios::binary);
+
+            if (!ofile.is_open()) {
+                std::cerr << "can't open " << output << '\n';
+                return 1;
+            }
+
+            ElfWriter writer;
+
+            if (cache) {
+                std::ostringstream object;
+                writer.write(program, object);
+                cache->store(cacheKey, object.view());
+                ofile << object.view();
+            }
+            else {
+                writer.write(program, ofile);
+            }
+        }
 
     } catch (const LexicalError& e) {
         std::cerr << "Lexical error: " << e.what() << '\n';
-        printCodeLine(e.getLocation(), buf);
+        printErrorLine(e.getLocation());
     } catch (const SyntaxError& e) {
         std::cerr << "Syntax error: " << e.what() << '\n';
-        printCodeLine(e.getLocation(), buf);
+        printErrorLine(e.getLocation());
     } catch (const SemanticError& e) {
         std::cerr << "Semantic error: " << e.what() << '\n';
-        printCodeLine(e.getLocation(), buf);
+        printErrorLine(e.getLocation());
+    } catch (const InterpretError& e) {
+        std::cerr << "Code generation error: " << e.what() << '\n';
+        return 1;
+    }
+
+    if (cache && cacheStats) {
+        cache->printStats(std::cerr);
     }
 
     return 0;